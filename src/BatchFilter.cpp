@@ -0,0 +1,177 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "BatchFilter.hpp"
+#include "ProgramCache.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+
+BatchFilter::BatchFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue) :
+	context(context),
+	device(device),
+	queue(queue),
+	source_capacity(0),
+	destination_capacity(0),
+	sizes_capacity(0),
+	launches(0),
+	kernel_time(0.0)
+{
+	cl_int err_msg;
+	kernel = cl::Kernel(ProgramCache::get(context, device, std::vector<std::string>(1, "bilateralFilter_basic.cl")),
+		"bilateralFilter_batch", &err_msg);
+	clPrintErrorExit(err_msg, "bilateralFilter_batch");
+}
+
+
+void BatchFilter::reserve(cl::Buffer &buffer, size_t &capacity, size_t size, cl_mem_flags flags)
+{
+	if (size > capacity)
+	{
+		cl_int err_msg;
+		buffer = cl::Buffer(context, flags, size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: batch");
+		capacity = size;
+	}
+}
+
+
+int BatchFilter::batchSize(cl::Device &device, int slot_width, int slot_height, int radius)
+{
+	const size_t source_slot = sizeof(cl_float3) * (slot_width + radius * 2) * (slot_height + radius * 2);
+	const size_t destination_slot = sizeof(cl_float3) * slot_width * slot_height;
+
+	const size_t global_memory = (size_t)device.getInfo<CL_DEVICE_GLOBAL_MEM_SIZE>();
+	const size_t max_alloc = (size_t)device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>();
+
+	size_t count = std::min(global_memory / 4 / (source_slot + destination_slot), max_alloc / source_slot);
+	return (int)std::max((size_t)1, std::min(count, (size_t)MAX_BATCH_SIZE));
+}
+
+
+std::vector<BatchFilter::Batch> BatchFilter::pack(const std::vector<cv::Size> &sizes, int batch_size)
+{
+	std::vector<int> order(sizes.size());
+	for (size_t i = 0; i < order.size(); i++)
+	{
+		order[i] = (int)i;
+	}
+
+	// largest first - neighbours in the order have similar sizes, a batch wastes little of its slot
+	std::stable_sort(order.begin(), order.end(), [&sizes](int a, int b)
+	{
+		return sizes[a].height != sizes[b].height ? sizes[a].height > sizes[b].height : sizes[a].width > sizes[b].width;
+	});
+
+	std::vector<Batch> batches;
+	for (size_t first = 0; first < order.size(); first += batch_size)
+	{
+		Batch batch;
+		batch.slot_width = 0;
+		batch.slot_height = 0;
+
+		for (size_t i = first; i < std::min(order.size(), first + batch_size); i++)
+		{
+			batch.images.push_back(order[i]);
+			batch.slot_width = std::max(batch.slot_width, sizes[order[i]].width);
+			batch.slot_height = std::max(batch.slot_height, sizes[order[i]].height);
+		}
+
+		batches.push_back(batch);
+	}
+
+	return batches;
+}
+
+
+std::vector<cv::Mat> BatchFilter::run(const std::vector<cv::Mat> &images, int radius, float range_param, int batch_size)
+{
+	std::vector<cv::Size> image_sizes;
+	int max_width = 1, max_height = 1;
+	for (size_t i = 0; i < images.size(); i++)
+	{
+		image_sizes.push_back(images[i].size());
+		max_width = std::max(max_width, images[i].cols);
+		max_height = std::max(max_height, images[i].rows);
+	}
+
+	if (batch_size <= 0)
+	{
+		batch_size = batchSize(device, max_width, max_height, radius);
+	}
+
+	auto bilateralFilter_batch = cl::make_kernel<
+		cl::Buffer&,
+		cl::Buffer&,
+		cl::Buffer&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_float&
+	>(kernel);
+
+	std::vector<cv::Mat> results(images.size());
+	std::vector<Batch> batches = pack(image_sizes, batch_size);
+	launches = 0;
+	kernel_time = 0.0;
+
+	for (size_t b = 0; b < batches.size(); b++)
+	{
+		const Batch &batch = batches[b];
+		const int count = (int)batch.images.size();
+		const int src_width = batch.slot_width + radius * 2;
+		const int src_height = batch.slot_height + radius * 2;
+
+		// packed input - slots one under another, halo zones by replicating the borders
+		cv::Mat packed(count * src_height, src_width, CV_32FC4, cv::Scalar(0));
+		std::vector<cl_int2> batch_sizes;
+		for (int i = 0; i < count; i++)
+		{
+			const cv::Mat &image = images[batch.images[i]];
+			cv::Mat padded;
+			cv::copyMakeBorder(image, padded, radius, radius, radius, radius, cv::BORDER_REPLICATE);
+			cv::Mat slot = packed(cv::Rect(0, i * src_height, padded.cols, padded.rows));
+			cv::cvtColor(padded, slot, cv::COLOR_BGR2BGRA);
+
+			cl_int2 size = { { image.cols, image.rows } };
+			batch_sizes.push_back(size);
+		}
+
+		const size_t source_size = sizeof(cl_float3) * count * src_width * src_height;
+		const size_t destination_size = sizeof(cl_float3) * count * batch.slot_width * batch.slot_height;
+		reserve(source, source_capacity, source_size, CL_MEM_READ_ONLY);
+		reserve(destination, destination_capacity, destination_size, CL_MEM_WRITE_ONLY);
+		reserve(sizes, sizes_capacity, sizeof(cl_int2) * count, CL_MEM_READ_ONLY);
+
+		clPrintErrorExit(queue.enqueueWriteBuffer(source, CL_FALSE, 0, source_size, packed.data), "clEnqueueWriteBuffer: batch");
+		clPrintErrorExit(queue.enqueueWriteBuffer(sizes, CL_FALSE, 0, sizeof(cl_int2) * count, batch_sizes.data()),
+			"clEnqueueWriteBuffer: batch sizes");
+
+		cl::NDRange local(16, 16, 1);
+		cl::NDRange global(alignTo(batch.slot_width, local[0]), alignTo(batch.slot_height, local[1]), count);
+		cl::Event event = bilateralFilter_batch(cl::EnqueueArgs(queue, global, local),
+			source, destination, sizes, batch.slot_width, batch.slot_height, radius, range_param);
+		Trace::addEvent("bilateralFilter_batch", event);
+
+		cv::Mat output(count * batch.slot_height, batch.slot_width, CV_32FC4);
+		clPrintErrorExit(queue.enqueueReadBuffer(destination, CL_TRUE, 0, destination_size, output.data), "clEnqueueReadBuffer: batch");
+
+		for (int i = 0; i < count; i++)
+		{
+			const cv::Mat &image = images[batch.images[i]];
+			cv::cvtColor(output(cv::Rect(0, i * batch.slot_height, image.cols, image.rows)), results[batch.images[i]], cv::COLOR_BGRA2BGR);
+		}
+
+		launches++;
+		kernel_time += getEventTime(event);
+	}
+
+	return results;
+}
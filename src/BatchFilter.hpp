@@ -0,0 +1,90 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+/**
+ * Bilaterální filtr hrubou silou pro mnoho malých obrázků (náhledy) - jedno spuštění
+ * bilateralFilter_batch na dávku, get_global_id(2) je index obrázku v dávce.
+ *
+ * Obrázky se seřadí podle velikosti a po sobě jdoucí obrázky tvoří dávku se slotem podle
+ * největšího z nich (obrázky podobné velikosti, málo nevyužitého místa). Velikost dávky se
+ * odvodí od paměti zařízení (batchSize). Halo zóny se doplní opakováním okrajů, výstup má
+ * velikost vstupu.
+ */
+class BatchFilter
+{
+public:
+	/**
+	 * Rozmístění dávky v bufferu - slot a obrázky v něm (indexy do vstupu run).
+	 */
+	struct Batch
+	{
+		int slot_width, slot_height;
+		std::vector<int> images;
+	};
+
+protected:
+	cl::Context context;
+	cl::Device device;
+	cl::CommandQueue queue;
+	cl::Kernel kernel;
+
+	// buffery se zvětšují podle potřeby a zůstávají pro další dávky
+	cl::Buffer source, destination, sizes;
+	size_t source_capacity, destination_capacity, sizes_capacity;
+
+	int launches;
+	double kernel_time;
+
+private:
+	/**
+	 * Zajistí buffer alespoň size bajtů.
+	 */
+	void reserve(cl::Buffer &buffer, size_t &capacity, size_t size, cl_mem_flags flags);
+
+public:
+	// nejvíce obrázků v jedné dávce
+	static const int MAX_BATCH_SIZE = 1024;
+
+	BatchFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue);
+
+	/**
+	 * Počet obrázků s daným slotem, které se vejdou do dávky: vstup i výstup dávky dohromady
+	 * nejvýše čtvrtina globální paměti, každý z nich v jedné alokaci (CL_DEVICE_MAX_MEM_ALLOC_SIZE).
+	 */
+	static int batchSize(cl::Device &device, int slot_width, int slot_height, int radius);
+
+	/**
+	 * Rozdělí obrázky daných rozměrů do dávek (viz popis třídy). Slot je bez halo zón,
+	 * ty jsou pro všechny sloty stejné (2x radius) a přidávají se až při plnění dávky.
+	 */
+	static std::vector<Batch> pack(const std::vector<cv::Size> &sizes, int batch_size);
+
+	/**
+	 * Filtr všech obrázků (Lab CV_32FC3), výsledky ve stejném pořadí a stejné velikosti.
+	 * batch_size = 0 podle zařízení.
+	 */
+	std::vector<cv::Mat> run(const std::vector<cv::Mat> &images, int radius, float range_param, int batch_size = 0);
+
+	/**
+	 * Počet spuštění kernelu a součet jejich doby posledního run (v sekundách).
+	 */
+	int getLaunches(void) const
+	{
+		return launches;
+	}
+
+	double getKernelTime(void) const
+	{
+		return kernel_time;
+	}
+};
@@ -0,0 +1,181 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "BatchPipeline.hpp"
+#include "SpscQueue.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdio.h>
+#include <thread>
+
+
+BatchPipeline::BatchPipeline(int threads, size_t queue_depth) :
+	threads(std::max(1, threads)),
+	queue_depth(std::max((size_t)1, queue_depth)),
+	images(0),
+	failed(0),
+	total_time(0.0),
+	decode_busy(0.0),
+	filter_busy(0.0),
+	encode_busy(0.0),
+	decode_stall(0.0),
+	filter_input_stall(0.0),
+	filter_output_stall(0.0),
+	encode_stall(0.0),
+	decoded_occupancy(0.0),
+	encoded_occupancy(0.0)
+{
+}
+
+
+std::vector<std::string> BatchPipeline::readList(const std::string &file)
+{
+	std::vector<std::string> list;
+	std::ifstream stream(file.c_str());
+	std::string line;
+
+	while (std::getline(stream, line))
+	{
+		line.erase(line.find_last_not_of(" \r\t") + 1);
+		if (!line.empty())
+		{
+			list.push_back(line);
+		}
+	}
+
+	return list;
+}
+
+
+int BatchPipeline::run(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, int pad, const Stage &stage)
+{
+	const int count = (int)inputs.size();
+
+	std::vector<std::unique_ptr<SpscQueue<cv::Mat> > > decoded, encoded;
+	std::vector<double> decode_times(threads, 0.0), encode_times(threads, 0.0);
+	std::vector<int> written(threads, 0);
+	for (int w = 0; w < threads; w++)
+	{
+		decoded.push_back(std::unique_ptr<SpscQueue<cv::Mat> >(new SpscQueue<cv::Mat>(queue_depth)));
+		encoded.push_back(std::unique_ptr<SpscQueue<cv::Mat> >(new SpscQueue<cv::Mat>(queue_depth)));
+	}
+
+	double begin = getTime();
+	std::vector<std::thread> workers;
+
+	for (int w = 0; w < threads; w++)
+	{
+		// decoder w - images w, w + threads, ...; an empty Mat marks an image that could not be read
+		workers.push_back(std::thread([&, w]
+		{
+			for (int i = w; i < count; i += threads)
+			{
+				double start = getTime();
+				cv::Mat lab;
+				{
+					TRACE_SCOPE("decode image");
+					cv::Mat bgr = cv::imread(inputs[i]);
+					if (!bgr.empty())
+					{
+						cv::Mat lab_uint8, lab_float;
+						cv::cvtColor(bgr, lab_uint8, cv::COLOR_BGR2Lab);
+						lab_uint8.convertTo(lab_float, CV_32FC3, 1.0 / 255);
+						cv::copyMakeBorder(lab_float, lab, pad, pad, pad, pad, cv::BORDER_REPLICATE);
+					}
+				}
+				decode_times[w] += getTime() - start;
+				decoded[w]->push(lab);
+			}
+		}));
+
+		// encoder w - results of the same images
+		workers.push_back(std::thread([&, w]
+		{
+			for (int i = w; i < count; i += threads)
+			{
+				cv::Mat lab = encoded[w]->pop();
+				if (lab.empty())
+				{
+					std::cerr << "Input image could not be loaded: " << inputs[i] << std::endl;
+					continue;
+				}
+
+				double start = getTime();
+				{
+					TRACE_SCOPE("encode image");
+					cv::Mat lab_uint8, bgr;
+					lab.convertTo(lab_uint8, CV_8UC3, 255.0);
+					cv::cvtColor(lab_uint8, bgr, cv::COLOR_Lab2BGR);
+					cv::imwrite(outputs[i], bgr);
+				}
+				encode_times[w] += getTime() - start;
+				written[w]++;
+			}
+		}));
+	}
+
+	// device stage in the input order
+	filter_busy = 0.0;
+	for (int i = 0; i < count; i++)
+	{
+		cv::Mat lab = decoded[i % threads]->pop();
+
+		double start = getTime();
+		cv::Mat result = lab.empty() ? cv::Mat() : stage(lab);
+		filter_busy += getTime() - start;
+
+		encoded[i % threads]->push(result);
+	}
+
+	for (size_t i = 0; i < workers.size(); i++)
+	{
+		workers[i].join();
+	}
+	total_time = getTime() - begin;
+
+	images = 0;
+	decode_busy = encode_busy = 0.0;
+	decode_stall = filter_input_stall = filter_output_stall = encode_stall = 0.0;
+	decoded_occupancy = encoded_occupancy = 0.0;
+	for (int w = 0; w < threads; w++)
+	{
+		images += written[w];
+		decode_busy += decode_times[w];
+		encode_busy += encode_times[w];
+		decode_stall += decoded[w]->getPushStall();
+		filter_input_stall += decoded[w]->getPopStall();
+		filter_output_stall += encoded[w]->getPushStall();
+		encode_stall += encoded[w]->getPopStall();
+		decoded_occupancy += decoded[w]->getAverageOccupancy() / threads;
+		encoded_occupancy += encoded[w]->getAverageOccupancy() / threads;
+	}
+	failed = count - images;
+
+	return images;
+}
+
+
+void BatchPipeline::printStats(void)
+{
+	const double time = std::max(total_time, 1e-9);
+
+	printf("\nBatch: %d images (%d failed), %d decode + %d encode threads, queue depth %u, %.3fs, %.1f images/s\n",
+		images, failed, threads, threads, (unsigned int)queue_depth, total_time, images / time);
+	printf("Stage busy: decode %.1f%%, filter %.1f%%, encode %.1f%% (decode and encode per thread)\n",
+		100.0 * decode_busy / threads / time, 100.0 * filter_busy / time, 100.0 * encode_busy / threads / time);
+	printf("Stalls: decode blocked %.3fs, filter starved %.3fs, filter blocked %.3fs, encode starved %.3fs\n",
+		decode_stall, filter_input_stall, filter_output_stall, encode_stall);
+	printf("Queue occupancy: decoded %.2f / %u, encoded %.2f / %u\n",
+		decoded_occupancy, (unsigned int)queue_depth, encoded_occupancy, (unsigned int)queue_depth);
+}
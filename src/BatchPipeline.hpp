@@ -0,0 +1,66 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+/**
+ * Dávkové zpracování souborů - dekódování a kódování v omezeném počtu vláken kolem fáze
+ * na zařízení (volající vlákno).
+ *
+ * Dekodér w čte obrázky i = w, w + threads, ... (cv::imread, převod do Lab float, rozšíření
+ * o halo zóny) a předává je frontou SpscQueue fázi na zařízení, ta je bere ve vstupním pořadí
+ * a výsledek předá frontou kodéru w. Každá fronta má jednoho producenta a jednoho konzumenta.
+ * Kapacita front omezuje počet obrázků v paměti (zpětný tlak), doba čekání na plnou a prázdnou
+ * frontu a obsazenost front se vypíší v printStats.
+ */
+class BatchPipeline
+{
+public:
+	/**
+	 * Fáze na zařízení - vstup je Lab CV_32FC3 rozšířený o pad na každé straně,
+	 * výstup Lab CV_32FC3 velikosti původního obrázku.
+	 */
+	typedef std::function<cv::Mat(const cv::Mat &lab)> Stage;
+
+protected:
+	int threads;
+	size_t queue_depth;
+
+	// statistika posledního run
+	int images, failed;
+	double total_time;
+	double decode_busy, filter_busy, encode_busy;   // součet přes vlákna fáze
+	double decode_stall, filter_input_stall, filter_output_stall, encode_stall;
+	double decoded_occupancy, encoded_occupancy;    // průměr přes fronty
+
+public:
+	/**
+	 * threads dekodérů a stejně kodérů, queue_depth obrázků v každé frontě.
+	 */
+	BatchPipeline(int threads, size_t queue_depth = 4);
+
+	/**
+	 * Zpracuje inputs[i] -> outputs[i]. Nenačtené obrázky se přeskočí (chyba na stderr).
+	 * Vrátí počet zapsaných obrázků.
+	 */
+	int run(const std::vector<std::string> &inputs, const std::vector<std::string> &outputs, int pad, const Stage &stage);
+
+	/**
+	 * Vypíše propustnost, vytížení fází, čekání a obsazenost front.
+	 */
+	void printStats(void);
+
+	/**
+	 * Seznam souborů - jedna cesta na řádek, prázdné řádky se přeskočí.
+	 */
+	static std::vector<std::string> readList(const std::string &file);
+};
@@ -0,0 +1,337 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "BilateralFilterCL.hpp"
+#include "ProgramCache.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+
+BilateralFilterCL::BilateralFilterCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool specialise) :
+	context(context),
+	device(device),
+	queue(queue),
+	specialise(specialise),
+	channels(3),
+	tap_count(0),
+	taps_radius(0)
+{
+	defaultBlock(device, block_x, block_y);
+}
+
+
+void BilateralFilterCL::defaultBlock(cl::Device &device, int &block_x, int &block_y)
+{
+	if (device.getInfo<CL_DEVICE_TYPE>() & CL_DEVICE_TYPE_CPU)
+	{
+		block_x = 4;
+		block_y = 1;
+	}
+	else if (device.getInfo<CL_DEVICE_VENDOR>().find("Intel") != std::string::npos)
+	{
+		block_x = 2;
+		block_y = 1;
+	}
+	else
+	{
+		block_x = 2;
+		block_y = 2;
+	}
+}
+
+
+void BilateralFilterCL::setBlock(int block_x, int block_y)
+{
+	this->block_x = block_x;
+	this->block_y = block_y;
+}
+
+
+bool BilateralFilterCL::isSpecialised(int radius) const
+{
+	return specialise && radius > 0 && radius <= MAX_SPECIALISED_RADIUS;
+}
+
+
+std::string BilateralFilterCL::getKernelName(int radius) const
+{
+	if (isBlocked())
+	{
+		return "bilateralFilter_blocked";
+	}
+	if (isSpecialised(radius))
+	{
+		return "bilateralFilter_radius";
+	}
+	return (channels == 1) ? "bilateralFilter_lightness" : "bilateralFilter_basic";
+}
+
+
+std::string BilateralFilterCL::getOptions(int radius) const
+{
+	std::stringstream options;
+
+	if (isSpecialised(radius))
+	{
+		options << "-D RADIUS=" << radius << " -D CHANNELS=" << channels;
+	}
+	if (isBlocked())
+	{
+		options << (isSpecialised(radius) ? " " : "") << "-D BLOCK_X=" << block_x << " -D BLOCK_Y=" << block_y;
+	}
+
+	return options.str();
+}
+
+
+void BilateralFilterCL::setGraph(const std::string &header)
+{
+	if (header != graph_header)
+	{
+		graph_header = header;
+		kernels.clear();
+	}
+}
+
+
+cl::Kernel &BilateralFilterCL::getKernel(int radius)
+{
+	return getKernel(getKernelName(radius), getOptions(radius));
+}
+
+
+cl::Kernel &BilateralFilterCL::getKernel(const std::string &name, const std::string &options)
+{
+	std::string key = name + " " + options;
+
+	std::map<std::string, cl::Kernel>::iterator it = kernels.find(key);
+	if (it != kernels.end())
+	{
+		return it->second;
+	}
+
+	cl_int err_msg;
+	std::vector<std::string> files;
+	if (!graph_header.empty())
+	{
+		// labToBGR and the other helpers of the generated operations
+		files.push_back("filterGraph.cl");
+	}
+	files.push_back("bilateralFilter_basic.cl");
+
+	kernels[key] = cl::Kernel(ProgramCache::get(context, device, files, options, graph_header), name.c_str(), &err_msg);
+	clPrintErrorExit(err_msg, name.c_str());
+
+	return kernels[key];
+}
+
+
+cl::Event BilateralFilterCL::enqueue(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, int radius, float range_param)
+{
+	return enqueueRegion(source, destination, dst_width, dst_height, radius, range_param, 0, 0, dst_width, dst_height);
+}
+
+
+cl::Event BilateralFilterCL::enqueueRegion(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, int radius, float range_param,
+	int x, int y, int width, int height)
+{
+	cl::NDRange local(16, 16);
+	std::string name = getKernelName(radius);
+
+	if (name == "bilateralFilter_radius")
+	{
+		auto bilateralFilter_radius = cl::make_kernel<
+			cl::Buffer&,
+			cl::Buffer&,
+			const cl_int&,
+			const cl_int&,
+			const cl_float&
+		>(getKernel(radius));
+
+		// the work-items past the region (alignment) compute valid pixels too, the kernel checks dst_width/height
+		cl::NDRange offset(x, y);
+		cl::NDRange global(alignTo(width, local[0]), alignTo(height, local[1]));
+		cl::Event event = bilateralFilter_radius(cl::EnqueueArgs(queue, offset, global, local),
+			source, destination, dst_width, dst_height, range_param);
+		Trace::addEvent(name, event);
+		return event;
+	}
+
+	// bilateralFilter_basic, _lightness and _blocked share the arguments
+	auto bilateralFilter_basic = cl::make_kernel<
+		cl::Buffer&,
+		cl::Buffer&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_float&
+	>(getKernel(radius));
+
+	// global ids of the blocked kernel are block indices
+	const int step_x = isBlocked() ? block_x : 1;
+	const int step_y = isBlocked() ? block_y : 1;
+	const int first_x = x / step_x, first_y = y / step_y;
+	const int blocks_x = (x + width + step_x - 1) / step_x - first_x;
+	const int blocks_y = (y + height + step_y - 1) / step_y - first_y;
+	cl::NDRange offset(first_x, first_y);
+	cl::NDRange global(alignTo(blocks_x, local[0]), alignTo(blocks_y, local[1]));
+
+	cl::Event event = bilateralFilter_basic(cl::EnqueueArgs(queue, offset, global, local),
+		source, destination, dst_width, dst_height, radius, range_param);
+	Trace::addEvent(name, event);
+	return event;
+}
+
+
+cl::Event BilateralFilterCL::enqueueSweep(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, int radius, const std::vector<float> &range_params)
+{
+	cl_int err_msg;
+	sweep_params = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * range_params.size(),
+		(void *)range_params.data(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: sweep params");
+
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(dst_width, local[0]), alignTo(dst_height, local[1]));
+	cl::Event event;
+
+	for (int first = 0; first < (int)range_params.size(); first += MAX_SWEEP_COUNT)
+	{
+		const int count = std::min(MAX_SWEEP_COUNT, (int)range_params.size() - first);
+
+		std::stringstream options;
+		if (isSpecialised(radius))
+		{
+			options << "-D RADIUS=" << radius << " ";
+		}
+		options << "-D SWEEP_COUNT=" << count;
+
+		auto bilateralFilter_sweep = cl::make_kernel<
+			cl::Buffer&,
+			cl::Buffer&,
+			const cl_int&,
+			const cl_int&,
+			const cl_int&,
+			cl::Buffer&,
+			const cl_int&
+		>(getKernel("bilateralFilter_sweep", options.str()));
+
+		event = bilateralFilter_sweep(cl::EnqueueArgs(queue, global, local),
+			source, destination, dst_width, dst_height, radius, sweep_params, first);
+		Trace::addEvent("bilateralFilter_sweep", event);
+	}
+
+	return event;
+}
+
+
+cl::Event BilateralFilterCL::enqueuePad(cl::Buffer &source, cl::Buffer &destination, int width, int height, int radius)
+{
+	auto bilateralFilter_pad = cl::make_kernel<
+		cl::Buffer&,
+		cl::Buffer&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&
+	>(getKernel("bilateralFilter_pad", ""));
+
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(width + radius * 2, local[0]), alignTo(height + radius * 2, local[1]));
+
+	cl::Event event = bilateralFilter_pad(cl::EnqueueArgs(queue, global, local),
+		source, destination, width, height, radius);
+	Trace::addEvent("bilateralFilter_pad", event);
+	return event;
+}
+
+
+cl::Event BilateralFilterCL::enqueueIterations(cl::Buffer &image, cl::Buffer &padded,
+	int width, int height, int radius, float range_param, int iterations)
+{
+	cl::Event event;
+
+	// in-order queue - every kernel waits for the previous one, nothing is read back in between
+	for (int i = 0; i < iterations; i++)
+	{
+		enqueuePad(image, padded, width, height, radius);
+		event = enqueue(padded, image, width, height, radius, range_param);
+	}
+
+	return event;
+}
+
+
+int BilateralFilterCL::setTaps(int radius, float epsilon, bool circular)
+{
+	std::vector<cl_float4> list;
+
+	for (int y = -radius; y <= radius; y++)
+	{
+		for (int x = -radius; x <= radius; x++)
+		{
+			// same spatial weight as bilateralFilter_basic
+			float weight = std::exp(-0.5f * (x * x + y * y) / radius);
+
+			if (circular ? (x * x + y * y <= radius * radius) : (weight >= epsilon))
+			{
+				cl_float4 tap = { { (float)x, (float)y, weight, 0.0f } };
+				list.push_back(tap);
+			}
+		}
+	}
+
+	if (sizeof(cl_float4) * list.size() > device.getInfo<CL_DEVICE_MAX_CONSTANT_BUFFER_SIZE>())
+	{
+		clPrintErrorExit(CL_INVALID_BUFFER_SIZE, "tap list exceeds constant memory");
+	}
+
+	cl_int err_msg;
+	taps = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float4) * list.size(), list.data(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: taps");
+
+	tap_count = (int)list.size();
+	taps_radius = radius;
+	return tap_count;
+}
+
+
+cl::Event BilateralFilterCL::enqueueTaps(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, float range_param)
+{
+	cl_int err_msg;
+	std::string key = "bilateralFilter_taps";
+
+	if (kernels.find(key) == kernels.end())
+	{
+		kernels[key] = cl::Kernel(ProgramCache::get(context, device, std::vector<std::string>(1, "bilateralFilter_basic.cl")), key.c_str(), &err_msg);
+		clPrintErrorExit(err_msg, "_taps");
+	}
+
+	auto bilateralFilter_taps = cl::make_kernel<
+		cl::Buffer&,
+		cl::Buffer&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_float&,
+		cl::Buffer&,
+		const cl_int&
+	>(kernels[key]);
+
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(dst_width, local[0]), alignTo(dst_height, local[1]));
+
+	cl::Event event = bilateralFilter_taps(cl::EnqueueArgs(queue, global, local),
+		source, destination, dst_width, dst_height, taps_radius, range_param, taps, tap_count);
+	Trace::addEvent(key, event);
+	return event;
+}
@@ -0,0 +1,168 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <map>
+#include <string>
+#include <vector>
+
+/**
+ * Bilaterální filtr hrubou silou (bilateralFilter_basic.cl).
+ *
+ * Pro radius do MAX_SPECIALISED_RADIUS se použije varianta programu sestavená
+ * s -D RADIUS=<r> (rozvinuté smyčky, konstantní prostorové váhy). Varianty se sestavují
+ * líně a drží se v ProgramCache, pro ostatní radiusy zůstává kernel s radiusem za běhu.
+ *
+ * S blokem větším než 1x1 se použije bilateralFilter_blocked - pracovní položka počítá
+ * blok výstupů a každý bod okna načte jen jednou. Výchozí tvar bloku se volí podle zařízení.
+ */
+class BilateralFilterCL
+{
+protected:
+	cl::Context context;
+	cl::Device device;
+	cl::CommandQueue queue;
+	bool specialise;
+	int block_x, block_y;
+	int channels;
+
+	// kernely podle voleb sestavení
+	std::map<std::string, cl::Kernel> kernels;
+
+	// hlavička s operacemi FilterGraph na výstupu kernelů (prázdná = bez operací)
+	std::string graph_header;
+
+	// řídký seznam vah pro bilateralFilter_taps
+	cl::Buffer taps;
+	int tap_count, taps_radius;
+
+	// parametry barev pro bilateralFilter_sweep
+	cl::Buffer sweep_params;
+
+private:
+	cl::Kernel &getKernel(int radius);
+
+	/**
+	 * Kernel daného názvu z programu sestaveného s options (sestaví se jednou, pak se bere z mapy).
+	 */
+	cl::Kernel &getKernel(const std::string &name, const std::string &options);
+
+	/**
+	 * Volby sestavení programu pro daný radius a aktuální blok.
+	 */
+	std::string getOptions(int radius) const;
+
+	bool isBlocked(void) const
+	{
+		return channels == 3 && block_x * block_y > 1;
+	}
+
+public:
+	static const int MAX_SPECIALISED_RADIUS = 16;
+
+	// nejvíce parametrů jednoho spuštění bilateralFilter_sweep (součty v registrech)
+	static const int MAX_SWEEP_COUNT = 8;
+
+	BilateralFilterCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool specialise = true);
+
+	/**
+	 * Zda se pro daný radius použije varianta sestavená pro tento radius.
+	 */
+	bool isSpecialised(int radius) const;
+
+	/**
+	 * Tvar bloku výstupů na pracovní položku (1x1 = bez blokování).
+	 */
+	void setBlock(int block_x, int block_y);
+
+	int getBlockX(void) const
+	{
+		return block_x;
+	}
+
+	int getBlockY(void) const
+	{
+		return block_y;
+	}
+
+	/**
+	 * Počet kanálů dat: 3 (Lab, cl_float3) nebo 1 (jen L, float). Blokování je jen pro 3 kanály.
+	 */
+	void setChannels(int channels)
+	{
+		this->channels = channels;
+	}
+
+	/**
+	 * Bodové operace FilterGraph na výstupu kernelů basic, _radius, _blocked a _lightness - program
+	 * se sestaví s vygenerovanou hlavičkou (GRAPH_OPS, GRAPH_OPS_L, GRAPH_STORE) a filterGraph.cl.
+	 * Výstup Lab má pak typ podle grafu (float4 nebo uchar3). Prázdná hlavička operace zruší.
+	 */
+	void setGraph(const std::string &header);
+
+	/**
+	 * Výchozí blok pro zařízení: CPU 4x1 (souvislé výstupy v řádku pro vektorizaci),
+	 * GPU Intel 2x1 (menší registrový soubor), ostatní GPU 2x2.
+	 */
+	static void defaultBlock(cl::Device &device, int &block_x, int &block_y);
+
+	/**
+	 * Název kernelu, který se pro daný radius použije.
+	 */
+	std::string getKernelName(int radius) const;
+
+	/**
+	 * Sestaví řídký seznam vah okna pro enqueueTaps: body uvnitř kruhu o poloměru radius
+	 * (circular), jinak body s prostorovou vahou alespoň epsilon. Vrátí počet vah.
+	 */
+	int setTaps(int radius, float epsilon, bool circular);
+
+	/**
+	 * Zařadí bilateralFilter_taps se seznamem z posledního setTaps.
+	 */
+	cl::Event enqueueTaps(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, float range_param);
+
+	/**
+	 * Zařadí filtr do fronty. Výstup je menší o 2x radius (halo zóny).
+	 */
+	cl::Event enqueue(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, int radius, float range_param);
+
+	/**
+	 * Sweep parametru barev - filtr pro všechny range_params s jedním čtením okna.
+	 * destination obsahuje range_params.size() výstupů dst_width x dst_height (cl_float3) za sebou.
+	 * Parametry se zpracují po dávkách MAX_SWEEP_COUNT. Vrátí událost posledního kernelu.
+	 */
+	cl::Event enqueueSweep(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, int radius, const std::vector<float> &range_params);
+
+	/**
+	 * Doplní halo zóny - zkopíruje obrázek width x height do destination (větší o 2x radius)
+	 * s opakováním okrajových bodů. Jen pro 3 kanály.
+	 */
+	cl::Event enqueuePad(cl::Buffer &source, cl::Buffer &destination, int width, int height, int radius);
+
+	/**
+	 * Opakované filtrování bez přenosů na hostitele. image obsahuje vstup width x height a po
+	 * dokončení i výsledek stejné velikosti, padded (větší o 2x radius) je pomocný buffer.
+	 * V každé iteraci se doplní halo zóny (image -> padded) a filtruje se zpět (padded -> image).
+	 * Vrátí událost posledního kernelu.
+	 */
+	cl::Event enqueueIterations(cl::Buffer &image, cl::Buffer &padded,
+		int width, int height, int radius, float range_param, int iterations);
+
+	/**
+	 * Jako enqueue, ale spočítá jen obdélník výstupu (x, y, width, height) - NDRange s posunem.
+	 * Zbytek výstupu zůstane beze změny.
+	 */
+	cl::Event enqueueRegion(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, int radius, float range_param,
+		int x, int y, int width, int height);
+};
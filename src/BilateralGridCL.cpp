@@ -0,0 +1,611 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "BilateralGridCL.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+#include "cv_extend.hpp"
+
+#include <algorithm>
+
+
+static bool hasImageFormat(const std::vector<cl::ImageFormat> &formats, cl_channel_order order, cl_channel_type type)
+{
+	for (size_t i = 0; i < formats.size(); i++)
+	{
+		if (formats[i].image_channel_order == order && formats[i].image_channel_data_type == type)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+static std::string gridProgramOptions(cl::Device &device, bool use_image)
+{
+	std::string options;
+	if (use_image && device.getInfo<CL_DEVICE_IMAGE_SUPPORT>())
+	{
+		options += "-D GRID_IMAGES";
+		if (device.getInfo<CL_DEVICE_EXTENSIONS>().find("cl_khr_3d_image_writes") != std::string::npos)
+		{
+			options += " -D GRID_IMAGE_WRITES";
+		}
+	}
+	return options;
+}
+
+
+BilateralGridCL::BilateralGridCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool use_image) :
+	context(context),
+	queue(queue),
+	program(buildProgram(context, device, std::vector<std::string>(1, "bilateralGrid.cl"), gridProgramOptions(device, use_image))),
+	splat(program, "bilateralGrid_splat"),
+	splatLocal(program, "bilateralGrid_splatLocal"),
+	cellKeys(program, "bilateralGrid_cellKeys"),
+	bitonicStep(program, "bilateralGrid_bitonicStep"),
+	reduceSorted(program, "bilateralGrid_reduceSorted"),
+	blurDepth(program, "bilateralGrid_blurDepth"),
+	blurStrided(program, "bilateralGrid_blurStrided"),
+	blurWide(program, "bilateralGrid_blurWide"),
+	splatDelta(program, "bilateralGrid_splatDelta"),
+	normalise(program, "bilateralGrid_normalise"),
+	slice(program, "bilateralGrid_slice"),
+	grid_capacity(0),
+	small_height(0),
+	small_width(0),
+	small_depth(0),
+	local_mem_size((size_t)device.getInfo<CL_DEVICE_LOCAL_MEM_SIZE>()),
+	splat_mode(SPLAT_LOCAL),
+	splat_path(SPLAT_LOCAL),
+	keys_capacity(0),
+	splat_begin(0),
+	splat_end(0),
+	temporal_cells(0),
+	temporal_width(0),
+	temporal_height(0),
+	tiles_capacity(0),
+	image_support(false),
+	image_writes(false),
+	slice_path(SLICE_BUFFER)
+{
+	image_size[0] = image_size[1] = image_size[2] = 0;
+	slice_region[0] = slice_region[1] = slice_region[2] = slice_region[3] = 0;
+
+	std::string options = gridProgramOptions(device, use_image);
+	if (options.empty())
+	{
+		return;
+	}
+
+	std::vector<cl::ImageFormat> formats;
+	clPrintErrorExit(context.getSupportedImageFormats(CL_MEM_READ_WRITE, CL_MEM_OBJECT_IMAGE3D, &formats), "getSupportedImageFormats");
+
+	image_writes = options.find("GRID_IMAGE_WRITES") != std::string::npos;
+
+	// the copy path needs the layout of the float2 buffer, the write path converts
+	if (hasImageFormat(formats, CL_RG, CL_FLOAT))
+	{
+		image_format = cl::ImageFormat(CL_RG, CL_FLOAT);
+		image_support = true;
+	}
+	else if (image_writes && hasImageFormat(formats, CL_RGBA, CL_FLOAT))
+	{
+		image_format = cl::ImageFormat(CL_RGBA, CL_FLOAT);
+		image_support = true;
+	}
+
+	if (!image_support)
+	{
+		return;
+	}
+
+	cl_int err_msg;
+	sliceImage = cl::Kernel(program, "bilateralGrid_sliceImage", &err_msg);
+	clPrintErrorExit(err_msg, "bilateralGrid_sliceImage");
+	if (image_writes)
+	{
+		normaliseImage = cl::Kernel(program, "bilateralGrid_normaliseImage", &err_msg);
+		clPrintErrorExit(err_msg, "bilateralGrid_normaliseImage");
+	}
+
+	image_max_size[0] = device.getInfo<CL_DEVICE_IMAGE3D_MAX_WIDTH>();
+	image_max_size[1] = device.getInfo<CL_DEVICE_IMAGE3D_MAX_HEIGHT>();
+	image_max_size[2] = device.getInfo<CL_DEVICE_IMAGE3D_MAX_DEPTH>();
+}
+
+
+const char *BilateralGridCL::splatModeName(SplatMode mode)
+{
+	switch (mode)
+	{
+	case SPLAT_GLOBAL:
+		return "global atomics";
+	case SPLAT_LOCAL:
+		return "local sub-grid";
+	default:
+		return "sorted";
+	}
+}
+
+
+const char *BilateralGridCL::slicePathName(SlicePath path)
+{
+	switch (path)
+	{
+	case SLICE_IMAGE_COPY:
+		return "image3d (copy)";
+	case SLICE_IMAGE_WRITE:
+		return "image3d (write_imagef)";
+	default:
+		return "buffer";
+	}
+}
+
+
+void BilateralGridCL::allocate(size_t cells)
+{
+	if (cells <= grid_capacity)
+	{
+		return;
+	}
+
+	cl_int err_msg;
+	size_t grid_size = sizeof(cl_float2) * cells;
+
+	grid = cl::Buffer(context, CL_MEM_READ_WRITE, grid_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: grid");
+	buffer = cl::Buffer(context, CL_MEM_READ_WRITE, grid_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: grid buffer");
+
+	grid_capacity = cells;
+}
+
+
+BilateralGridCL::SlicePath BilateralGridCL::selectSlicePath(void) const
+{
+	if (!image_support ||
+		(size_t)small_depth > image_max_size[0] ||
+		(size_t)small_width > image_max_size[1] ||
+		(size_t)small_height > image_max_size[2])
+	{
+		return SLICE_BUFFER;
+	}
+
+	return image_writes ? SLICE_IMAGE_WRITE : SLICE_IMAGE_COPY;
+}
+
+
+void BilateralGridCL::allocateImage(void)
+{
+	if (image_size[0] == small_depth && image_size[1] == small_width && image_size[2] == small_height)
+	{
+		return;
+	}
+
+	cl_int err_msg;
+	image = cl::Image3D(context, CL_MEM_READ_WRITE, image_format, small_depth, small_width, small_height, 0, 0, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateImage3D: grid");
+
+	image_size[0] = small_depth;
+	image_size[1] = small_width;
+	image_size[2] = small_height;
+}
+
+
+void BilateralGridCL::enqueueSplat(cl::Buffer &source, int width, int height, float source_min, float sampling_space, float sampling_color)
+{
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(width, local[0]), alignTo(height, local[1]));
+
+	// grid columns touched by one work-group along each axis
+	const int span = (int)((local[0] - 1) / sampling_space) + 2;
+	const size_t sub_grid_size = sizeof(cl_float2) * span * span * small_depth;
+
+	splat_path = splat_mode;
+	if (splat_path == SPLAT_LOCAL && sub_grid_size > local_mem_size / 2)
+	{
+		splat_path = SPLAT_GLOBAL;
+	}
+
+	if (splat_path == SPLAT_GLOBAL)
+	{
+		kernel_names.push_back("bilateralGrid_splat");
+		kernel_events.push_back(splat(cl::EnqueueArgs(queue, global, local),
+			source, grid, width, height, small_width, small_depth, source_min, sampling_space, sampling_color));
+		return;
+	}
+
+	if (splat_path == SPLAT_LOCAL)
+	{
+		kernel_names.push_back("bilateralGrid_splatLocal");
+		kernel_events.push_back(splatLocal(cl::EnqueueArgs(queue, global, local),
+			source, grid, width, height, small_width, small_depth, source_min, sampling_space, sampling_color,
+			span, cl::Local(sub_grid_size)));
+		return;
+	}
+
+	// SPLAT_SORTED
+	const int pixels = width * height;
+	int key_count = 1;
+	while (key_count < pixels)
+	{
+		key_count *= 2;
+	}
+
+	if ((size_t)key_count > keys_capacity)
+	{
+		cl_int err_msg;
+		keys = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(cl_ulong) * key_count, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: grid keys");
+		keys_capacity = key_count;
+	}
+
+	cl::NDRange linear_local(256);
+	cl::NDRange linear_global(alignTo(key_count, 256));
+
+	kernel_names.push_back("bilateralGrid_cellKeys");
+	kernel_events.push_back(cellKeys(cl::EnqueueArgs(queue, linear_global, linear_local),
+		source, keys, width, height, key_count, small_width, small_depth, source_min, sampling_space, sampling_color));
+
+	for (int k = 2; k <= key_count; k *= 2)
+	{
+		for (int j = k / 2; j > 0; j /= 2)
+		{
+			kernel_names.push_back("bilateralGrid_bitonicStep");
+			kernel_events.push_back(bitonicStep(cl::EnqueueArgs(queue, cl::NDRange(key_count)), keys, j, k));
+		}
+	}
+
+	kernel_names.push_back("bilateralGrid_reduceSorted");
+	kernel_events.push_back(reduceSorted(cl::EnqueueArgs(queue, cl::NDRange(alignTo(pixels, 256)), linear_local),
+		keys, source, grid, pixels));
+}
+
+
+void BilateralGridCL::enqueueBlur(int axis, double sigma_cells, cl::Buffer &source, cl::Buffer &destination)
+{
+	const int plane = small_width * small_depth;
+	cl::NDRange blur_local(BLUR_TILE, BLUR_TILE, 1);
+
+	if (std::abs(sigma_cells - 1.0) < 1e-6)
+	{
+		if (axis == 0)
+		{
+			kernel_names.push_back("bilateralGrid_blurStrided");
+			kernel_events.push_back(blurStrided(
+				cl::EnqueueArgs(queue, cl::NDRange(alignTo(small_depth, BLUR_TILE), alignTo(small_height, BLUR_TILE), small_width), blur_local),
+				source, destination, small_depth, small_height, plane, small_depth));
+		}
+		else if (axis == 1)
+		{
+			kernel_names.push_back("bilateralGrid_blurStrided");
+			kernel_events.push_back(blurStrided(
+				cl::EnqueueArgs(queue, cl::NDRange(alignTo(small_depth, BLUR_TILE), alignTo(small_width, BLUR_TILE), small_height), blur_local),
+				source, destination, small_depth, small_width, small_depth, plane));
+		}
+		else
+		{
+			kernel_names.push_back("bilateralGrid_blurDepth");
+			kernel_events.push_back(blurDepth(
+				cl::EnqueueArgs(queue, cl::NDRange(alignTo(small_depth, BLUR_TILE), alignTo(small_height * small_width, BLUR_TILE)), cl::NDRange(BLUR_TILE, BLUR_TILE)),
+				source, destination, small_height * small_width, small_depth));
+		}
+		return;
+	}
+
+	// the generic kernel reads the strided axis directly, the work-group size is left to the runtime
+	const std::vector<float> weights = cv_extend::gridBlurWeights(sigma_cells);
+	const int blur_radius = (int)weights.size() / 2;
+
+	cl_int err_msg;
+	blur_weights[axis] = cl::Buffer(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * weights.size(), (void *)weights.data(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: blur weights");
+
+	// (inner, length, outer) and strides of the axis, the same cell layout as gridIndex
+	int inner, length, outer, axis_stride, outer_stride;
+	if (axis == 0)
+	{
+		inner = plane, length = small_height, outer = 1, axis_stride = plane, outer_stride = 0;
+	}
+	else if (axis == 1)
+	{
+		inner = small_depth, length = small_width, outer = small_height, axis_stride = small_depth, outer_stride = plane;
+	}
+	else
+	{
+		inner = 1, length = small_depth, outer = small_height * small_width, axis_stride = 1, outer_stride = small_depth;
+	}
+
+	kernel_names.push_back("bilateralGrid_blurWide");
+	kernel_events.push_back(blurWide(
+		cl::EnqueueArgs(queue, cl::NDRange(inner, length, outer)),
+		source, destination, blur_weights[axis], blur_radius, inner, length, axis_stride, outer_stride));
+}
+
+
+int BilateralGridCL::resize(int width, int height, float source_min, float source_max, float sampling_space, float sampling_color)
+{
+	const int padding = 2;
+	small_height = (int)((height - 1) / sampling_space) + 1 + 2 * padding;
+	small_width = (int)((width - 1) / sampling_space) + 1 + 2 * padding;
+	small_depth = (int)((source_max - source_min) / sampling_color) + 1 + 2 * padding;
+	const int cells = small_height * small_width * small_depth;
+
+	allocate(cells);
+	kernel_events.clear();
+	kernel_names.clear();
+	return cells;
+}
+
+
+void BilateralGridCL::enqueueFullSplat(cl::Buffer &source, int width, int height, int cells, float source_min, float sampling_space, float sampling_color)
+{
+	cl::Event fill_event;
+	clPrintErrorExit(queue.enqueueFillBuffer(grid, (cl_float)0.0f, 0, sizeof(cl_float2) * cells, NULL, &fill_event),
+		"clEnqueueFillBuffer: grid");
+	kernel_names.push_back("fill grid");
+	kernel_events.push_back(fill_event);
+
+	splat_begin = kernel_events.size();
+	enqueueSplat(source, width, height, source_min, sampling_space, sampling_color);
+	splat_end = kernel_events.size();
+}
+
+
+cl::Event BilateralGridCL::enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	float source_min, float source_max, float sigma_space, float sigma_color,
+	float sampling_space, float sampling_color)
+{
+	if (sampling_space <= 0.0f)
+	{
+		sampling_space = sigma_space;
+	}
+	if (sampling_color <= 0.0f)
+	{
+		sampling_color = sigma_color;
+	}
+
+	const int cells = resize(width, height, source_min, source_max, sampling_space, sampling_color);
+	enqueueFullSplat(source, width, height, cells, source_min, sampling_space, sampling_color);
+
+	return enqueueBlurSlice(source, destination, width, height, source_min, sigma_space, sigma_color, sampling_space, sampling_color);
+}
+
+
+cl::Event BilateralGridCL::enqueueTemporal(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	float source_min, float source_max, float sigma_space, float sigma_color,
+	const std::vector<cl_int2> &dirty_tiles, bool reset)
+{
+	const int cells = resize(width, height, source_min, source_max, sigma_space, sigma_color);
+	const size_t grid_size = sizeof(cl_float2) * cells;
+	cl_int err_msg;
+
+	if (reset || temporal_cells != cells || temporal_width != width || temporal_height != height)
+	{
+		enqueueFullSplat(source, width, height, cells, source_min, sigma_space, sigma_color);
+
+		if (temporal_cells != cells || temporal_width != width || temporal_height != height)
+		{
+			splat_grid = cl::Buffer(context, CL_MEM_READ_WRITE, grid_size, NULL, &err_msg);
+			clPrintErrorExit(err_msg, "clCreateBuffer: splat grid");
+			splatted = cl::Buffer(context, CL_MEM_READ_WRITE, sizeof(float) * width * height, NULL, &err_msg);
+			clPrintErrorExit(err_msg, "clCreateBuffer: splatted source");
+			temporal_cells = cells;
+			temporal_width = width;
+			temporal_height = height;
+		}
+
+		// keep the splat and the input it was made from for the next frames
+		cl::Event grid_event, source_event;
+		clPrintErrorExit(queue.enqueueCopyBuffer(grid, splat_grid, 0, 0, grid_size, NULL, &grid_event), "clEnqueueCopyBuffer: splat grid");
+		clPrintErrorExit(queue.enqueueCopyBuffer(source, splatted, 0, 0, sizeof(float) * width * height, NULL, &source_event),
+			"clEnqueueCopyBuffer: splatted source");
+		kernel_names.push_back("copy splat grid");
+		kernel_events.push_back(grid_event);
+		kernel_names.push_back("copy splatted source");
+		kernel_events.push_back(source_event);
+	}
+	else
+	{
+		splat_begin = kernel_events.size();
+		if (!dirty_tiles.empty())
+		{
+			if (dirty_tiles.size() > tiles_capacity)
+			{
+				tiles = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_int2) * dirty_tiles.size(), NULL, &err_msg);
+				clPrintErrorExit(err_msg, "clCreateBuffer: dirty tiles");
+				tiles_capacity = dirty_tiles.size();
+			}
+			clPrintErrorExit(queue.enqueueWriteBuffer(tiles, CL_FALSE, 0, sizeof(cl_int2) * dirty_tiles.size(), dirty_tiles.data()),
+				"clEnqueueWriteBuffer: dirty tiles");
+
+			kernel_names.push_back("bilateralGrid_splatDelta");
+			kernel_events.push_back(splatDelta(
+				cl::EnqueueArgs(queue, cl::NDRange(TEMPORAL_TILE, TEMPORAL_TILE, dirty_tiles.size()), cl::NDRange(TEMPORAL_TILE, TEMPORAL_TILE, 1)),
+				source, splatted, splat_grid, tiles, width, height, small_width, small_depth, source_min, sigma_space, sigma_color));
+		}
+		splat_end = kernel_events.size();
+
+		cl::Event copy_event;
+		clPrintErrorExit(queue.enqueueCopyBuffer(splat_grid, grid, 0, 0, grid_size, NULL, &copy_event), "clEnqueueCopyBuffer: grid");
+		kernel_names.push_back("copy splat grid");
+		kernel_events.push_back(copy_event);
+	}
+
+	return enqueueBlurSlice(source, destination, width, height, source_min, sigma_space, sigma_color, sigma_space, sigma_color);
+}
+
+
+cl::Event BilateralGridCL::enqueueBlurSlice(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	float source_min, float sigma_space, float sigma_color, float sampling_space, float sampling_color)
+{
+	// same axis order as the host: y, x, depth
+	enqueueBlur(0, sigma_space / sampling_space, grid, buffer);
+	enqueueBlur(1, sigma_space / sampling_space, buffer, grid);
+	enqueueBlur(2, sigma_color / sampling_color, grid, buffer);
+
+	enqueueSlice(source, destination, width, height, source_min, sampling_space, sampling_color);
+
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		Trace::addEvent(kernel_names[i], kernel_events[i]);
+	}
+
+	return kernel_events.back();
+}
+
+
+void BilateralGridCL::enqueueSlice(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	float source_min, float sampling_space, float sampling_color)
+{
+	const int cells = small_height * small_width * small_depth;
+
+	cl::NDRange local(16, 16);
+	// only the slice region is written (whole image by default)
+	const bool region = slice_region[2] > 0;
+	cl::NDRange slice_offset(region ? slice_region[0] : 0, region ? slice_region[1] : 0);
+	cl::NDRange global(alignTo(region ? slice_region[2] : width, local[0]), alignTo(region ? slice_region[3] : height, local[1]));
+
+	slice_path = selectSlicePath();
+
+	if (slice_path == SLICE_BUFFER)
+	{
+		kernel_names.push_back("bilateralGrid_normalise");
+		kernel_events.push_back(normalise(cl::EnqueueArgs(queue, cl::NDRange(alignTo(cells, 256)), cl::NDRange(256)), buffer, cells));
+
+		kernel_names.push_back("bilateralGrid_slice");
+		kernel_events.push_back(slice(cl::EnqueueArgs(queue, slice_offset, global, local),
+			source, destination, buffer, width, height, small_height, small_width, small_depth, source_min, sampling_space, sampling_color));
+	}
+	else
+	{
+		allocateImage();
+
+		if (slice_path == SLICE_IMAGE_WRITE)
+		{
+			auto bilateralGrid_normaliseImage = cl::make_kernel<
+				cl::Buffer&,
+				cl::Image3D&,
+				const cl_int&,
+				const cl_int&,
+				const cl_int&
+			>(normaliseImage);
+
+			kernel_names.push_back("bilateralGrid_normaliseImage");
+			kernel_events.push_back(bilateralGrid_normaliseImage(
+				cl::EnqueueArgs(queue, cl::NDRange(alignTo(small_depth, 16), alignTo(small_width, 16), small_height), cl::NDRange(16, 16, 1)),
+				buffer, image, small_height, small_width, small_depth));
+		}
+		else
+		{
+			kernel_names.push_back("bilateralGrid_normalise");
+			kernel_events.push_back(normalise(cl::EnqueueArgs(queue, cl::NDRange(alignTo(cells, 256)), cl::NDRange(256)), buffer, cells));
+
+			cl::size_t<3> origin, region;
+			origin[0] = origin[1] = origin[2] = 0;
+			region[0] = small_depth;
+			region[1] = small_width;
+			region[2] = small_height;
+
+			cl::Event copy_event;
+			clPrintErrorExit(queue.enqueueCopyBufferToImage(buffer, image, 0, origin, region, NULL, &copy_event),
+				"clEnqueueCopyBufferToImage: grid");
+			kernel_names.push_back("copy grid to image");
+			kernel_events.push_back(copy_event);
+		}
+
+		auto bilateralGrid_sliceImage = cl::make_kernel<
+			cl::Buffer&,
+			cl::Buffer&,
+			cl::Image3D&,
+			const cl_int&,
+			const cl_int&,
+			const cl_float&,
+			const cl_float&,
+			const cl_float&
+		>(sliceImage);
+
+		kernel_names.push_back("bilateralGrid_sliceImage");
+		kernel_events.push_back(bilateralGrid_sliceImage(cl::EnqueueArgs(queue, slice_offset, global, local),
+			source, destination, image, width, height, source_min, sampling_space, sampling_color));
+	}
+}
+
+
+std::vector<cl::Event> BilateralGridCL::enqueueSweep(cl::Buffer &source, std::vector<cl::Buffer> &destinations, int width, int height,
+	float source_min, float source_max, float sigma_space, const std::vector<float> &sigma_colors)
+{
+	// the finest range sampling of the sweep, every sigma_color blurs at least one cell
+	const float sampling_color = *std::min_element(sigma_colors.begin(), sigma_colors.end());
+
+	const int cells = resize(width, height, source_min, source_max, sigma_space, sampling_color);
+	enqueueFullSplat(source, width, height, cells, source_min, sigma_space, sampling_color);
+
+	// the spatial blur does not depend on sigma_color - once, the result stays in grid
+	enqueueBlur(0, 1.0, grid, buffer);
+	enqueueBlur(1, 1.0, buffer, grid);
+
+	std::vector<cl::Event> events;
+	for (size_t i = 0; i < sigma_colors.size(); i++)
+	{
+		enqueueBlur(2, sigma_colors[i] / sampling_color, grid, buffer);
+		enqueueSlice(source, destinations[i], width, height, source_min, sigma_space, sampling_color);
+		events.push_back(kernel_events.back());
+	}
+
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		Trace::addEvent(kernel_names[i], kernel_events[i]);
+	}
+
+	return events;
+}
+
+
+cl::Event BilateralGridCL::enqueueNormalised(cl::Buffer &source, int width, int height,
+	float source_min, float source_max, float sigma_space, float sigma_color)
+{
+	const int cells = resize(width, height, source_min, source_max, sigma_space, sigma_color);
+	enqueueFullSplat(source, width, height, cells, source_min, sigma_space, sigma_color);
+
+	enqueueBlur(0, 1.0, grid, buffer);
+	enqueueBlur(1, 1.0, buffer, grid);
+	enqueueBlur(2, 1.0, grid, buffer);
+
+	kernel_names.push_back("bilateralGrid_normalise");
+	kernel_events.push_back(normalise(cl::EnqueueArgs(queue, cl::NDRange(alignTo(cells, 256)), cl::NDRange(256)), buffer, cells));
+
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		Trace::addEvent(kernel_names[i], kernel_events[i]);
+	}
+
+	return kernel_events.back();
+}
+
+
+double BilateralGridCL::getSplatTime(void)
+{
+	double time = 0.0;
+	for (size_t i = splat_begin; i < splat_end; i++)
+	{
+		time += getEventTime(kernel_events[i]);
+	}
+	return time;
+}
+
+
+double BilateralGridCL::getKernelTime(void)
+{
+	double time = 0.0;
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		time += getEventTime(kernel_events[i]);
+	}
+	return time;
+}
@@ -0,0 +1,295 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * Bilaterální mřížka v OpenCL (bilateralGrid.cl) - stejný algoritmus jako cv_extend::bilateralFilter.
+ *
+ * Rozmazání mřížky běží po osách, každá osa jedním spuštěním (oba průchody [1 2 1]/4
+ * v lokální paměti). Mřížka a pomocný buffer zůstávají na zařízení mezi voláními.
+ * Pokud se vzorkování mřížky liší od sigma, osa se rozmaže obecným jádrem o šířce
+ * sigma / vzorkování buněk (bilateralGrid_blurWide).
+ *
+ * Normalizovaná mřížka se pro slice ukládá do image3d_t (CL_RG / CL_RGBA float), trilineární
+ * interpolaci pak dělá hardware (CLK_FILTER_LINEAR). Bez cl_khr_3d_image_writes se mřížka
+ * do obrazu kopíruje z bufferu, bez podpory obrazů (nebo pro příliš velkou mřížku)
+ * zůstává slice nad bufferem.
+ *
+ * Splat: SPLAT_LOCAL sčítá buňky bloku pixelů v lokální paměti pracovní skupiny a do globální
+ * mřížky zapíše každou buňku jednou (pokud se podmřížka do lokální paměti nevejde, použije
+ * se SPLAT_GLOBAL - atomické přičítání každého pixelu). SPLAT_SORTED seřadí pixely podle
+ * buňky a sčítá je bez atomických operací ve stejném pořadí jako hostitel - výsledek je
+ * reprodukovatelný.
+ */
+class BilateralGridCL
+{
+public:
+	enum SlicePath
+	{
+		SLICE_BUFFER,      // trilineární interpolace v kernelu
+		SLICE_IMAGE_COPY,  // normalizace v bufferu, clEnqueueCopyBufferToImage
+		SLICE_IMAGE_WRITE  // normalizace přímo do obrazu (write_imagef)
+	};
+
+	enum SplatMode
+	{
+		SPLAT_GLOBAL,
+		SPLAT_LOCAL,
+		SPLAT_SORTED
+	};
+
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	cl::Program program;
+
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&,
+		const cl_float&, const cl_float&, const cl_float&> splat;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&,
+		const cl_float&, const cl_float&, const cl_float&, const cl_int&, cl::LocalSpaceArg> splatLocal;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&, const cl_int&,
+		const cl_float&, const cl_float&, const cl_float&> cellKeys;
+	cl::make_kernel<cl::Buffer&, const cl_int&, const cl_int&> bitonicStep;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&> reduceSorted;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&> blurDepth;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&> blurStrided;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&, const cl_int&> blurWide;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&,
+		const cl_float&, const cl_float&, const cl_float&> splatDelta;
+	cl::make_kernel<cl::Buffer&, const cl_int&> normalise;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_int&, const cl_int&,
+		const cl_float&, const cl_float&, const cl_float&> slice;
+
+	cl::Buffer grid, buffer;
+	size_t grid_capacity;
+	int small_height, small_width, small_depth;
+	cl::Buffer blur_weights[3]; // váhy bilateralGrid_blurWide pro osy y, x, hloubka
+
+	size_t local_mem_size;
+	SplatMode splat_mode, splat_path;
+	cl::Buffer keys;
+	size_t keys_capacity;
+	size_t splat_begin, splat_end; // rozsah událostí splatu v kernel_events
+
+	// enqueueTemporal - splat předchozího snímku a vstup, ze kterého vznikl
+	cl::Buffer splat_grid, splatted, tiles;
+	int temporal_cells, temporal_width, temporal_height;
+	size_t tiles_capacity;
+	int slice_region[4]; // x, y, width, height; width 0 = celý obraz
+
+	// kernely nad image3d_t, jen pokud je zařízení podporuje
+	cl::Kernel normaliseImage, sliceImage;
+	bool image_support, image_writes;
+	cl::ImageFormat image_format;
+	size_t image_max_size[3];
+
+	cl::Image3D image;
+	int image_size[3];
+	SlicePath slice_path;
+
+	std::vector<cl::Event> kernel_events;
+	std::vector<std::string> kernel_names;
+
+private:
+	/**
+	 * (Re)alokuje mřížku a pomocný buffer, pokud je potřeba více buněk.
+	 */
+	void allocate(size_t cells);
+
+	/**
+	 * (Re)alokuje obraz mřížky pro aktuální rozměry.
+	 */
+	void allocateImage(void);
+
+	/**
+	 * Rozměry mřížky pro vstup a vzorkování, alokace. Vrátí počet buněk.
+	 */
+	int resize(int width, int height, float source_min, float source_max, float sampling_space, float sampling_color);
+
+	/**
+	 * Vynuluje mřížku a zařadí splat celého vstupu.
+	 */
+	void enqueueFullSplat(cl::Buffer &source, int width, int height, int cells, float source_min, float sampling_space, float sampling_color);
+
+	/**
+	 * Rozmazání, normalizace a slice nad mřížkou po splatu.
+	 */
+	cl::Event enqueueBlurSlice(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		float source_min, float sigma_space, float sigma_color, float sampling_space, float sampling_color);
+
+	/**
+	 * Normalizace a slice rozmazané mřížky (buffer) zvolenou cestou.
+	 */
+	void enqueueSlice(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		float source_min, float sampling_space, float sampling_color);
+
+	/**
+	 * Zařadí splat zvolenou cestou, mřížka už je vynulovaná.
+	 */
+	void enqueueSplat(cl::Buffer &source, int width, int height, float source_min, float sampling_space, float sampling_color);
+
+	/**
+	 * Cesta slice pro aktuální rozměry mřížky.
+	 */
+	SlicePath selectSlicePath(void) const;
+
+	/**
+	 * Zařadí rozmazání osy axis (0 = y, 1 = x, 2 = hloubka) o sigma_cells buněk.
+	 * Pro sigma_cells = 1 dvojí [1 2 1]/4 v lokální paměti, jinak bilateralGrid_blurWide.
+	 */
+	void enqueueBlur(int axis, double sigma_cells, cl::Buffer &source, cl::Buffer &destination);
+
+public:
+	// velikost dlaždice rozmazání, musí odpovídat BLUR_TILE v bilateralGrid.cl
+	static const int BLUR_TILE = 16;
+
+	/**
+	 * use_image = false vynutí slice nad bufferem.
+	 */
+	BilateralGridCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool use_image = true);
+
+	/**
+	 * Zařadí filtr do fronty. source a destination obsahují width x height hodnot float
+	 * (šedotónový obraz), source_min a source_max je rozsah hodnot vstupu.
+	 * sampling_space a sampling_color je velikost buňky mřížky (0 = sigma), viz cv_extend::bilateralFilter.
+	 * Vrátí událost posledního kernelu.
+	 */
+	cl::Event enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		float source_min, float source_max, float sigma_space, float sigma_color,
+		float sampling_space = 0.0f, float sampling_color = 0.0f);
+
+	// velikost dlaždice enqueueTemporal, musí odpovídat TEMPORAL_TILE v bilateralGrid.cl
+	static const int TEMPORAL_TILE = 16;
+
+	/**
+	 * Jako enqueue pro posloupnost snímků stejné velikosti a rozsahu. Splat zůstává z předchozího
+	 * volání a jen v dlaždicích dirty_tiles (souřadnice dlaždic TEMPORAL_TILE x TEMPORAL_TILE) se
+	 * odečte příspěvek starého vstupu a přičte nový - statické oblasti se znovu nesplatují.
+	 * reset (nebo změna rozměrů) udělá úplný splat. Vzorkování je rovno sigma.
+	 */
+	cl::Event enqueueTemporal(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		float source_min, float source_max, float sigma_space, float sigma_color,
+		const std::vector<cl_int2> &dirty_tiles, bool reset);
+
+	/**
+	 * Filtr pro několik sigma_color se společným sigma_space. Splat a prostorové rozmazání
+	 * proběhnou jednou (vzorkování barev podle nejmenší sigma_color), pro každou sigma_color
+	 * jen rozmazání v hloubce a slice do destinations[i]. Vrátí události slice.
+	 */
+	std::vector<cl::Event> enqueueSweep(cl::Buffer &source, std::vector<cl::Buffer> &destinations, int width, int height,
+		float source_min, float source_max, float sigma_space, const std::vector<float> &sigma_colors);
+
+	/**
+	 * Splat, rozmazání a normalizace bez slice (vzorkování je rovno sigma). Normalizovaná
+	 * mřížka zůstane v getNormalisedGrid() pro vlastní slice kernel (FilterGraph).
+	 * Vrátí událost normalizace.
+	 */
+	cl::Event enqueueNormalised(cl::Buffer &source, int width, int height,
+		float source_min, float source_max, float sigma_space, float sigma_color);
+
+	/**
+	 * Normalizovaná mřížka posledního volání enqueueNormalised (float2, hodnota v .x).
+	 */
+	cl::Buffer &getNormalisedGrid(void)
+	{
+		return buffer;
+	}
+
+	/**
+	 * Omezí slice dalších volání na obdélník výstupu (zbytek výstupu zůstane beze změny),
+	 * width = 0 vrátí slice celého obrazu.
+	 */
+	void setSliceRegion(int x, int y, int width, int height)
+	{
+		slice_region[0] = x;
+		slice_region[1] = y;
+		slice_region[2] = width;
+		slice_region[3] = height;
+	}
+
+	/**
+	 * Velikost mřížky posledního volání enqueue v bajtech.
+	 */
+	size_t getGridBytes(void) const
+	{
+		return sizeof(cl_float2) * small_height * small_width * small_depth;
+	}
+
+	/**
+	 * Součet doby běhu kernelů posledního volání enqueue v sekundách (po dokončení fronty).
+	 */
+	double getKernelTime(void);
+
+	/**
+	 * Události a názvy kernelů posledního volání enqueue (ve stejném pořadí).
+	 */
+	const std::vector<cl::Event> &getKernelEvents(void) const
+	{
+		return kernel_events;
+	}
+
+	const std::vector<std::string> &getKernelNames(void) const
+	{
+		return kernel_names;
+	}
+
+	/**
+	 * Rozměry mřížky posledního volání enqueue.
+	 */
+	int getSmallHeight(void) const
+	{
+		return small_height;
+	}
+
+	int getSmallWidth(void) const
+	{
+		return small_width;
+	}
+
+	int getSmallDepth(void) const
+	{
+		return small_depth;
+	}
+
+	/**
+	 * Požadovaný způsob splatu pro další volání enqueue (výchozí SPLAT_LOCAL).
+	 */
+	void setSplatMode(SplatMode mode)
+	{
+		splat_mode = mode;
+	}
+
+	/**
+	 * Skutečně použitý splat posledního volání enqueue.
+	 */
+	SplatMode getSplatPath(void) const
+	{
+		return splat_path;
+	}
+
+	static const char *splatModeName(SplatMode mode);
+
+	/**
+	 * Doba běhu kernelů splatu posledního volání enqueue v sekundách.
+	 */
+	double getSplatTime(void);
+
+	/**
+	 * Cesta slice posledního volání enqueue.
+	 */
+	SlicePath getSlicePath(void) const
+	{
+		return slice_path;
+	}
+
+	static const char *slicePathName(SlicePath path);
+};
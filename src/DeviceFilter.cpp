@@ -0,0 +1,317 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "DeviceFilter.hpp"
+#include "oclHelper.h"
+
+
+/**
+ * Wrappers of caller objects - the single-argument constructors take over a reference, so retain first.
+ * On failure the wrapper stays empty and err_msg holds the error.
+ */
+static cl::Context wrapContext(cl_context context, cl_int &err_msg)
+{
+	err_msg = clRetainContext(context);
+	return (err_msg == CL_SUCCESS) ? cl::Context(context) : cl::Context();
+}
+
+static cl::CommandQueue wrapQueue(cl_command_queue queue, cl_int &err_msg)
+{
+	err_msg = clRetainCommandQueue(queue);
+	return (err_msg == CL_SUCCESS) ? cl::CommandQueue(queue) : cl::CommandQueue();
+}
+
+/**
+ * The buffer has to belong to context and hold at least size bytes.
+ */
+static cl::Buffer wrapBuffer(cl_mem buffer, cl_context context, size_t size, cl_int &err_msg)
+{
+	cl_context buffer_context;
+	size_t buffer_size;
+
+	err_msg = clGetMemObjectInfo(buffer, CL_MEM_CONTEXT, sizeof(buffer_context), &buffer_context, NULL);
+	if (err_msg == CL_SUCCESS)
+	{
+		err_msg = clGetMemObjectInfo(buffer, CL_MEM_SIZE, sizeof(buffer_size), &buffer_size, NULL);
+	}
+	if (err_msg == CL_SUCCESS && buffer_context != context)
+	{
+		err_msg = CL_INVALID_CONTEXT;
+	}
+	if (err_msg == CL_SUCCESS && buffer_size < size)
+	{
+		err_msg = CL_INVALID_BUFFER_SIZE;
+	}
+	if (err_msg == CL_SUCCESS)
+	{
+		err_msg = clRetainMemObject(buffer);
+	}
+	return (err_msg == CL_SUCCESS) ? cl::Buffer(buffer) : cl::Buffer();
+}
+
+static cl_int wrapEvents(cl_uint num_events, const cl_event *wait_list, std::vector<cl::Event> &events)
+{
+	if ((num_events > 0) != (wait_list != NULL))
+	{
+		return CL_INVALID_EVENT_WAIT_LIST;
+	}
+
+	for (cl_uint i = 0; i < num_events; i++)
+	{
+		cl_int err_msg = clRetainEvent(wait_list[i]);
+		if (err_msg != CL_SUCCESS)
+		{
+			return CL_INVALID_EVENT_WAIT_LIST;
+		}
+		events.push_back(cl::Event(wait_list[i]));
+	}
+	return CL_SUCCESS;
+}
+
+/**
+ * Event handed to the caller with its own reference (released by clReleaseEvent), handle may be NULL.
+ */
+static cl_int returnEvent(const cl::Event &event, cl_event *handle)
+{
+	if (handle == NULL)
+	{
+		return CL_SUCCESS;
+	}
+
+	cl_int err_msg = clRetainEvent(event());
+	*handle = (err_msg == CL_SUCCESS) ? event() : NULL;
+	return err_msg;
+}
+
+
+cl::CommandQueue DeviceFilter::inOrderQueue(const cl::Context &context, const cl::CommandQueue &queue, cl_int *err_msg)
+{
+	cl_int status;
+	cl::CommandQueue result = queue;
+
+	cl_command_queue_properties properties = queue.getInfo<CL_QUEUE_PROPERTIES>(&status);
+	if (status == CL_SUCCESS && (properties & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE))
+	{
+		// the filter classes rely on in-order execution between their kernels
+		cl::Device device = queue.getInfo<CL_QUEUE_DEVICE>(&status);
+		if (status == CL_SUCCESS)
+		{
+			result = cl::CommandQueue(context, device, properties & ~(cl_command_queue_properties)CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE, &status);
+		}
+	}
+
+	if (err_msg == NULL)
+	{
+		clPrintErrorExit(status, "cl::CommandQueue: device filter");
+	}
+	else
+	{
+		*err_msg = status;
+	}
+	return result;
+}
+
+
+DeviceFilter::DeviceFilter(cl::Context &context, cl::CommandQueue &queue) :
+	context(context),
+	queue(inOrderQueue(context, queue)),
+	device(this->queue.getInfo<CL_QUEUE_DEVICE>()),
+	filter(this->context, device, this->queue),
+	grid(this->context, device, this->queue),
+	padded_capacity(0)
+{
+}
+
+
+DeviceFilter *DeviceFilter::create(cl_context context, cl_command_queue queue, cl_int *err_msg)
+{
+	DeviceFilter *device_filter = NULL;
+	cl::Context context_wrapper;
+	cl::CommandQueue queue_wrapper;
+
+	// also rejects an invalid queue before anything is retained
+	cl_context queue_context;
+	cl_int status = clGetCommandQueueInfo(queue, CL_QUEUE_CONTEXT, sizeof(queue_context), &queue_context, NULL);
+	if (status == CL_SUCCESS && queue_context != context)
+	{
+		status = CL_INVALID_CONTEXT;
+	}
+	if (status == CL_SUCCESS)
+	{
+		context_wrapper = wrapContext(context, status);
+	}
+	if (status == CL_SUCCESS)
+	{
+		queue_wrapper = wrapQueue(queue, status);
+	}
+	if (status == CL_SUCCESS)
+	{
+		queue_wrapper = inOrderQueue(context_wrapper, queue_wrapper, &status);
+	}
+	if (status == CL_SUCCESS)
+	{
+		device_filter = new DeviceFilter(context_wrapper, queue_wrapper);
+	}
+
+	if (err_msg != NULL)
+	{
+		*err_msg = status;
+	}
+	return device_filter;
+}
+
+
+cl_int DeviceFilter::enqueueWait(const std::vector<cl::Event> *wait_list)
+{
+	if (wait_list != NULL && !wait_list->empty())
+	{
+		return queue.enqueueBarrierWithWaitList(wait_list);
+	}
+	return CL_SUCCESS;
+}
+
+
+cl_int DeviceFilter::enqueueFilter(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	int radius, float range_param, const std::vector<cl::Event> *wait_list, cl::Event &event)
+{
+	// radius 0 would give exp(0 / 0) = NaN as the spatial weight in every brute-force kernel
+	if (width <= 0 || height <= 0 || radius <= 0)
+	{
+		return CL_INVALID_VALUE;
+	}
+
+	cl_int err_msg;
+
+	const size_t padded_size = sizeof(cl_float3) * ((size_t)width + 2 * (size_t)radius) * ((size_t)height + 2 * (size_t)radius);
+	if (padded_size > padded_capacity)
+	{
+		cl::Buffer buffer(context, CL_MEM_READ_WRITE, padded_size, NULL, &err_msg);
+		if (err_msg != CL_SUCCESS)
+		{
+			return err_msg;
+		}
+		padded = buffer;
+		padded_capacity = padded_size;
+	}
+
+	err_msg = enqueueWait(wait_list);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+
+	filter.enqueuePad(source, padded, width, height, radius);
+	event = filter.enqueue(padded, destination, width, height, radius, range_param);
+	return CL_SUCCESS;
+}
+
+
+cl::Event DeviceFilter::enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	int radius, float range_param, const std::vector<cl::Event> *wait_list)
+{
+	cl::Event event;
+	clPrintErrorExit(enqueueFilter(source, destination, width, height, radius, range_param, wait_list, event), "DeviceFilter::enqueue");
+	return event;
+}
+
+
+cl::Event DeviceFilter::enqueuePadded(cl::Buffer &source, cl::Buffer &destination, int dst_width, int dst_height,
+	int radius, float range_param, const std::vector<cl::Event> *wait_list)
+{
+	if (dst_width <= 0 || dst_height <= 0 || radius <= 0)
+	{
+		clPrintErrorExit(CL_INVALID_VALUE, "DeviceFilter::enqueuePadded");
+	}
+
+	clPrintErrorExit(enqueueWait(wait_list), "clEnqueueBarrierWithWaitList: device filter");
+	return filter.enqueue(source, destination, dst_width, dst_height, radius, range_param);
+}
+
+
+cl::Event DeviceFilter::enqueueGrid(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+	float source_min, float source_max, float sigma_space, float sigma_color,
+	const std::vector<cl::Event> *wait_list)
+{
+	clPrintErrorExit(enqueueWait(wait_list), "clEnqueueBarrierWithWaitList: device filter");
+	return grid.enqueue(source, destination, width, height, source_min, source_max, sigma_space, sigma_color);
+}
+
+
+cl_int DeviceFilter::enqueue(cl_mem source, cl_mem destination, int width, int height, int radius, float range_param,
+	cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+	if (width <= 0 || height <= 0 || radius <= 0 || !(range_param > 0.0f))
+	{
+		return CL_INVALID_VALUE;
+	}
+
+	cl_int err_msg;
+	const size_t image_size = sizeof(cl_float3) * (size_t)width * (size_t)height;
+
+	cl::Buffer source_buffer = wrapBuffer(source, context(), image_size, err_msg);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	cl::Buffer destination_buffer = wrapBuffer(destination, context(), image_size, err_msg);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	std::vector<cl::Event> events;
+	err_msg = wrapEvents(num_events, wait_list, events);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+
+	cl::Event filter_event;
+	err_msg = enqueueFilter(source_buffer, destination_buffer, width, height, radius, range_param, &events, filter_event);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	return returnEvent(filter_event, event);
+}
+
+
+cl_int DeviceFilter::enqueueGrid(cl_mem source, cl_mem destination, int width, int height,
+	float source_min, float source_max, float sigma_space, float sigma_color,
+	cl_uint num_events, const cl_event *wait_list, cl_event *event)
+{
+	if (width <= 0 || height <= 0 || !(source_max >= source_min) || !(sigma_space > 0.0f) || !(sigma_color > 0.0f))
+	{
+		return CL_INVALID_VALUE;
+	}
+
+	cl_int err_msg;
+	const size_t image_size = sizeof(float) * (size_t)width * (size_t)height;
+
+	cl::Buffer source_buffer = wrapBuffer(source, context(), image_size, err_msg);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	cl::Buffer destination_buffer = wrapBuffer(destination, context(), image_size, err_msg);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	std::vector<cl::Event> events;
+	err_msg = wrapEvents(num_events, wait_list, events);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+
+	err_msg = enqueueWait(&events);
+	if (err_msg != CL_SUCCESS)
+	{
+		return err_msg;
+	}
+	return returnEvent(grid.enqueue(source_buffer, destination_buffer, width, height,
+		source_min, source_max, sigma_space, sigma_color), event);
+}
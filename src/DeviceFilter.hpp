@@ -0,0 +1,106 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <vector>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Filtr nad buffery volajícího - pro zařazení do cizího řetězce kernelů bez přenosů na hostitele
+ * a bez synchronizace.
+ *
+ * Pracuje v kontextu a frontě volajícího, před prvním kernelem počká na události wait_list
+ * a vrátí událost posledního kernelu (dokončení výstupu). Nic nečte ani nečeká na hostiteli.
+ * Pokud je fronta volajícího out-of-order, kernely jdou do vlastní in-order fronty na stejném
+ * zařízení - pořadí se pak drží jen přes vrácenou událost.
+ *
+ * Rozhraní s cl_mem / cl_event je pro volající bez C++ obalů - předané objekty se nepřevezmou
+ * (jen retain), vrácenou událost uvolní volající (clReleaseEvent). Chyby parametrů, objektů
+ * volajícího, alokace a bariéry vrací jako cl_int místo ukončení programu; sestavení programů
+ * a alokace uvnitř BilateralGridCL končí jako ve zbytku programu (clPrintErrorExit).
+ */
+class DeviceFilter
+{
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	cl::Device device;
+	BilateralFilterCL filter;
+	BilateralGridCL grid;
+
+	// pomocný buffer s halo zónami pro enqueue, zvětšuje se podle potřeby
+	cl::Buffer padded;
+	size_t padded_capacity;
+
+private:
+	/**
+	 * Zajistí, že fronta počká na wait_list (bariéra), prázdný seznam nic nezařadí.
+	 */
+	cl_int enqueueWait(const std::vector<cl::Event> *wait_list);
+
+	/**
+	 * Doplnění halo zón a jádro basic, event je událost posledního kernelu.
+	 */
+	cl_int enqueueFilter(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		int radius, float range_param, const std::vector<cl::Event> *wait_list, cl::Event &event);
+
+	/**
+	 * Fronta volajícího, nebo nová in-order fronta na stejném zařízení pro out-of-order frontu.
+	 * Bez err_msg chyba ukončí program.
+	 */
+	static cl::CommandQueue inOrderQueue(const cl::Context &context, const cl::CommandQueue &queue, cl_int *err_msg = NULL);
+
+public:
+	DeviceFilter(cl::Context &context, cl::CommandQueue &queue);
+
+	/**
+	 * Kontext a fronta volajícího bez C++ obalů. Při chybě vrátí NULL a kód v err_msg,
+	 * filtr uvolní volající (delete).
+	 */
+	static DeviceFilter *create(cl_context context, cl_command_queue queue, cl_int *err_msg = NULL);
+
+	/**
+	 * Jádro basic - source i destination obsahují width x height bodů Lab (cl_float3),
+	 * halo zóny se doplní na zařízení opakováním okrajů. source a destination může být
+	 * tentýž buffer. radius musí být kladný (jako u všech metod jádra basic).
+	 */
+	cl::Event enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		int radius, float range_param, const std::vector<cl::Event> *wait_list = NULL);
+
+	/**
+	 * Jádro basic nad vstupem, který už halo zóny má (větší o 2x radius) - výstup
+	 * dst_width x dst_height jako BilateralFilterCL::enqueue.
+	 */
+	cl::Event enqueuePadded(cl::Buffer &source, cl::Buffer &destination, int dst_width, int dst_height,
+		int radius, float range_param, const std::vector<cl::Event> *wait_list = NULL);
+
+	/**
+	 * Bilaterální mřížka - source a destination obsahují width x height hodnot float,
+	 * parametry jako BilateralGridCL::enqueue.
+	 */
+	cl::Event enqueueGrid(cl::Buffer &source, cl::Buffer &destination, int width, int height,
+		float source_min, float source_max, float sigma_space, float sigma_color,
+		const std::vector<cl::Event> *wait_list = NULL);
+
+	/**
+	 * enqueue pro cl_mem. Vrátí CL_SUCCESS nebo kód chyby, do event (může být NULL)
+	 * uloží událost, kterou uvolní volající. Buffery musí být z kontextu filtru a dost velké.
+	 */
+	cl_int enqueue(cl_mem source, cl_mem destination, int width, int height, int radius, float range_param,
+		cl_uint num_events = 0, const cl_event *wait_list = NULL, cl_event *event = NULL);
+
+	/**
+	 * enqueueGrid pro cl_mem, chyby a událost jako enqueue.
+	 */
+	cl_int enqueueGrid(cl_mem source, cl_mem destination, int width, int height,
+		float source_min, float source_max, float sigma_space, float sigma_color,
+		cl_uint num_events = 0, const cl_event *wait_list = NULL, cl_event *event = NULL);
+};
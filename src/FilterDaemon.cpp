@@ -0,0 +1,586 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "FilterDaemon.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <climits>
+#include <cmath>
+#include <iostream>
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+
+#ifndef _WIN32
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#endif
+
+
+FilterDaemon::FilterDaemon(cl::Context &context, cl::Device &device, cl::CommandQueue &queue) :
+	context(context),
+	queue(queue),
+	filter(context, device, queue),
+	grid(context, device, queue, false),
+	image_capacity(0),
+	padded_capacity(0),
+	lightness_capacity(0),
+	max_alloc((size_t)device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>()),
+	jobs(0),
+	total_latency(0.0),
+	max_latency(0.0)
+{
+}
+
+
+bool FilterDaemon::reserve(cl::Buffer &buffer, size_t &capacity, size_t size)
+{
+	if (size <= capacity)
+	{
+		return true;
+	}
+
+	// a failed job must not stop the daemon - report instead of clPrintErrorExit
+	cl_int err_msg;
+	cl::Buffer resized(context, CL_MEM_READ_WRITE, size, NULL, &err_msg);
+	if (err_msg != CL_SUCCESS)
+	{
+		std::cerr << "Daemon: clCreateBuffer failed: " << getCLError(err_msg) << std::endl;
+		return false;
+	}
+
+	buffer = resized;
+	capacity = size;
+	return true;
+}
+
+
+bool FilterDaemon::validate(const Job &job, size_t segment_size, size_t &image_size) const
+{
+	if (job.width <= 0 || job.height <= 0 || job.width > MAX_DIMENSION || job.height > MAX_DIMENSION ||
+		job.radius <= 0 || job.radius > MAX_RADIUS || !(job.range > 0.0f) || !std::isfinite(job.range) ||
+		(job.engine != ENGINE_BASIC && job.engine != ENGINE_GRID))
+	{
+		return false;
+	}
+
+	// dimensions and radius are bounded, so the products below fit in 64 bits
+	const uint64_t image_bytes = (uint64_t)sizeof(cl_float3) * job.width * job.height;
+	uint64_t device_bytes;
+	if (job.engine == ENGINE_BASIC)
+	{
+		device_bytes = (uint64_t)sizeof(cl_float3) * (job.width + job.radius * 2) * (job.height + job.radius * 2);
+	}
+	else
+	{
+		// grid cells as in BilateralGridCL::resize, at most 256 along L
+		if (job.range < 1.0f)
+		{
+			return false;
+		}
+		const uint64_t cells = (uint64_t)((job.height - 1) / job.radius + 5) * ((job.width - 1) / job.radius + 5) *
+			((int)(255.0f / job.range) + 5);
+		if (cells > INT_MAX)
+		{
+			return false;
+		}
+		device_bytes = std::max((uint64_t)sizeof(cl_float2) * cells, (uint64_t)sizeof(float) * job.width * job.height);
+	}
+
+	if (device_bytes > max_alloc || image_bytes > segment_size)
+	{
+		return false;
+	}
+
+	// output in place (0) or after the input, both inside the segment; no sums that could wrap
+	if (job.output_offset != 0 && (job.output_offset < image_bytes || job.output_offset > segment_size - image_bytes))
+	{
+		return false;
+	}
+
+	image_size = (size_t)image_bytes;
+	return true;
+}
+
+
+/**
+ * The kernel functors do not report launch errors - a failed launch leaves no event
+ * or an event with a negative execution status. Call after the command has finished.
+ */
+static bool eventFailed(const cl::Event &event)
+{
+	if (event() == NULL)
+	{
+		return true;
+	}
+
+	cl_int err_msg;
+	cl_int execution = event.getInfo<CL_EVENT_COMMAND_EXECUTION_STATUS>(&err_msg);
+	return err_msg != CL_SUCCESS || execution < 0;
+}
+
+
+bool FilterDaemon::process(const Job &job, void *segment)
+{
+	TRACE_SCOPE("FilterDaemon::process");
+
+	const int width = job.width;
+	const int height = job.height;
+	const size_t image_size = sizeof(cl_float3) * width * height;
+	char *input = (char *)segment;
+	char *output = input + job.output_offset;
+
+	if (job.engine == ENGINE_BASIC)
+	{
+		// Lab straight from the segment to the device and back, no host copy
+		if (!reserve(image_dev, image_capacity, image_size) ||
+			!reserve(padded_dev, padded_capacity, sizeof(cl_float3) * (width + job.radius * 2) * (height + job.radius * 2)))
+		{
+			return false;
+		}
+
+		cl::Event write_event, read_event;
+		if (queue.enqueueWriteBuffer(image_dev, CL_FALSE, 0, image_size, input, NULL, &write_event) != CL_SUCCESS)
+		{
+			return false;
+		}
+		Trace::addEvent("write daemon image", write_event);
+
+		cl::Event kernel_event = filter.enqueueIterations(image_dev, padded_dev, width, height, job.radius, job.range, 1);
+
+		if (queue.enqueueReadBuffer(image_dev, CL_TRUE, 0, image_size, output, NULL, &read_event) != CL_SUCCESS ||
+			eventFailed(kernel_event))
+		{
+			return false;
+		}
+		Trace::addEvent("read daemon image", read_event);
+	}
+	else
+	{
+		// grid filters L*255 only, a/b are copied from the input
+		const size_t lightness_size = sizeof(float) * width * height;
+		if (!reserve(lightness_dev, lightness_capacity, lightness_size))
+		{
+			return false;
+		}
+
+		cv::Mat source(height, width, CV_32FC4, input);
+		cv::Mat result(height, width, CV_32FC4, output);
+		cv::Mat lightness;
+		cv::extractChannel(source, lightness, 0);
+		lightness.convertTo(lightness, -1, 255.0);
+
+		if (queue.enqueueWriteBuffer(lightness_dev, CL_FALSE, 0, lightness_size, lightness.data) != CL_SUCCESS)
+		{
+			return false;
+		}
+		cl::Event kernel_event = grid.enqueue(lightness_dev, lightness_dev, width, height, 0.0f, 255.0f, (float)job.radius, job.range);
+		if (queue.enqueueReadBuffer(lightness_dev, CL_TRUE, 0, lightness_size, lightness.data) != CL_SUCCESS ||
+			eventFailed(kernel_event))
+		{
+			return false;
+		}
+
+		if (output != input)
+		{
+			source.copyTo(result);
+		}
+		lightness.convertTo(lightness, -1, 1.0 / 255);
+		cv::insertChannel(lightness, result, 0);
+	}
+
+	return true;
+}
+
+
+void FilterDaemon::printStats(void)
+{
+	printf("\nDaemon: %d jobs, latency avg %.3fms, max %.3fms\n",
+		jobs, jobs > 0 ? total_latency / jobs * 1000 : 0.0, max_latency * 1000);
+}
+
+
+#ifdef _WIN32
+
+int FilterDaemon::run(const std::string &socket_path)
+{
+	std::cerr << "Daemon mode is not supported on Windows." << std::endl;
+	return 0;
+}
+
+
+cv::Mat FilterDaemon::request(const std::string &socket_path, const cv::Mat &lab, Engine engine, int radius, float range, int repeat)
+{
+	std::cerr << "Daemon mode is not supported on Windows." << std::endl;
+	return cv::Mat();
+}
+
+
+void FilterDaemon::shutdown(const std::string &socket_path)
+{
+	std::cerr << "Daemon mode is not supported on Windows." << std::endl;
+}
+
+#else
+
+/**
+ * Přečte / zapíše celou zprávu ze socketu. Vrátí false při chybě nebo uzavření spojení.
+ */
+static bool receiveAll(int fd, void *data, size_t size)
+{
+	char *bytes = (char *)data;
+	while (size > 0)
+	{
+		ssize_t received = recv(fd, bytes, size, 0);
+		if (received <= 0)
+		{
+			return false;
+		}
+		bytes += received;
+		size -= (size_t)received;
+	}
+	return true;
+}
+
+static bool sendAll(int fd, const void *data, size_t size)
+{
+	const char *bytes = (const char *)data;
+	while (size > 0)
+	{
+		ssize_t sent = send(fd, bytes, size, MSG_NOSIGNAL);
+		if (sent <= 0)
+		{
+			return false;
+		}
+		bytes += sent;
+		size -= (size_t)sent;
+	}
+	return true;
+}
+
+static bool socketAddress(const std::string &socket_path, sockaddr_un &address)
+{
+	memset(&address, 0, sizeof(address));
+	address.sun_family = AF_UNIX;
+	if (socket_path.length() >= sizeof(address.sun_path))
+	{
+		std::cerr << "Socket path is too long: " << socket_path << std::endl;
+		return false;
+	}
+	strcpy(address.sun_path, socket_path.c_str());
+	return true;
+}
+
+
+FilterDaemon::Reply FilterDaemon::serve(Job &job, bool &running)
+{
+	double begin = getTime();
+	Reply reply = { -1, 0.0 };
+
+	if (job.command == COMMAND_SHUTDOWN)
+	{
+		running = false;
+		reply.status = 0;
+		return reply;
+	}
+
+	job.segment[sizeof(job.segment) - 1] = '\0';
+	size_t image_size = 0;
+
+	int segment_fd = shm_open(job.segment, O_RDWR, 0);
+	struct stat segment_stat;
+	void *segment = MAP_FAILED;
+	bool valid = false;
+	if (segment_fd >= 0 && fstat(segment_fd, &segment_stat) == 0 && segment_stat.st_size > 0)
+	{
+		valid = validate(job, (size_t)segment_stat.st_size, image_size);
+		if (valid)
+		{
+			segment = mmap(NULL, (size_t)segment_stat.st_size, PROT_READ | PROT_WRITE, MAP_SHARED, segment_fd, 0);
+		}
+	}
+
+	if (segment != MAP_FAILED)
+	{
+		if (process(job, segment))
+		{
+			reply.status = 0;
+		}
+		else
+		{
+			std::cerr << "Daemon: job " << job.segment << " failed on the device." << std::endl;
+		}
+		munmap(segment, (size_t)segment_stat.st_size);
+	}
+	else if (segment_fd >= 0 && !valid)
+	{
+		std::cerr << "Daemon: job " << job.segment << " has invalid parameters." << std::endl;
+	}
+	else
+	{
+		std::cerr << "Daemon: job segment " << job.segment << " could not be mapped." << std::endl;
+	}
+	if (segment_fd >= 0)
+	{
+		close(segment_fd);
+	}
+
+	reply.latency = getTime() - begin;
+	if (reply.status == 0)
+	{
+		jobs++;
+		total_latency += reply.latency;
+		max_latency = std::max(max_latency, reply.latency);
+		printf("Job %d: %s %dx%d, radius %d, range %g, %.3fms\n", jobs, job.engine == ENGINE_BASIC ? "basic" : "grid",
+			job.width, job.height, job.radius, job.range, reply.latency * 1000);
+		fflush(stdout);
+	}
+	return reply;
+}
+
+
+int FilterDaemon::run(const std::string &socket_path)
+{
+	sockaddr_un address;
+	if (!socketAddress(socket_path, address))
+	{
+		return 0;
+	}
+
+	int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+	unlink(socket_path.c_str());
+	if (listener < 0 || bind(listener, (sockaddr *)&address, sizeof(address)) != 0 || listen(listener, 4) != 0)
+	{
+		perror("Daemon socket");
+		if (listener >= 0)
+		{
+			close(listener);
+		}
+		return 0;
+	}
+
+	printf("Daemon listening on %s\n", socket_path.c_str());
+	fflush(stdout);
+
+	// fds[0] is the listener, the rest are open connections; one job per ready connection
+	// and round, so a client keeping its connection open does not block the others
+	std::vector<pollfd> fds(1);
+	fds[0].fd = listener;
+	fds[0].events = POLLIN;
+	fds[0].revents = 0;
+
+	bool running = true;
+	while (running)
+	{
+		if (poll(fds.data(), fds.size(), -1) < 0)
+		{
+			if (errno == EINTR)
+			{
+				continue;
+			}
+			perror("poll");
+			break;
+		}
+
+		// backwards, closed connections are erased
+		for (size_t i = fds.size() - 1; i > 0 && running; i--)
+		{
+			if (!(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+			{
+				continue;
+			}
+
+			Job job;
+			bool keep = receiveAll(fds[i].fd, &job, sizeof(job));
+			if (keep && job.magic != JOB_MAGIC)
+			{
+				std::cerr << "Daemon: invalid job message." << std::endl;
+				keep = false;
+			}
+			if (keep)
+			{
+				Reply reply = serve(job, running);
+				keep = sendAll(fds[i].fd, &reply, sizeof(reply));
+			}
+
+			if (!keep)
+			{
+				close(fds[i].fd);
+				fds.erase(fds.begin() + i);
+			}
+		}
+
+		if (running && (fds[0].revents & POLLIN))
+		{
+			int connection = accept(listener, NULL, NULL);
+			if (connection < 0)
+			{
+				perror("accept");
+			}
+			else if (fds.size() > (size_t)MAX_CONNECTIONS)
+			{
+				std::cerr << "Daemon: too many connections." << std::endl;
+				close(connection);
+			}
+			else
+			{
+				// a client that stops in the middle of a message (or stops reading replies) gives up its connection
+				timeval timeout = { RECEIVE_TIMEOUT, 0 };
+				setsockopt(connection, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+				setsockopt(connection, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+
+				pollfd connection_fd = { connection, POLLIN, 0 };
+				fds.push_back(connection_fd);
+			}
+		}
+	}
+
+	for (size_t i = 1; i < fds.size(); i++)
+	{
+		close(fds[i].fd);
+	}
+	close(listener);
+	unlink(socket_path.c_str());
+	return jobs;
+}
+
+
+/**
+ * Připojí se k démonovi. Vrátí -1 při chybě.
+ */
+static int connectDaemon(const std::string &socket_path)
+{
+	sockaddr_un address;
+	if (!socketAddress(socket_path, address))
+	{
+		return -1;
+	}
+
+	int connection = socket(AF_UNIX, SOCK_STREAM, 0);
+	if (connection < 0 || connect(connection, (sockaddr *)&address, sizeof(address)) != 0)
+	{
+		perror("Daemon connection");
+		if (connection >= 0)
+		{
+			close(connection);
+		}
+		return -1;
+	}
+	return connection;
+}
+
+
+cv::Mat FilterDaemon::request(const std::string &socket_path, const cv::Mat &lab, Engine engine, int radius, float range, int repeat)
+{
+	const size_t image_size = sizeof(cl_float3) * lab.rows * lab.cols;
+
+	Job job;
+	memset(&job, 0, sizeof(job));
+	job.magic = JOB_MAGIC;
+	job.command = COMMAND_FILTER;
+	snprintf(job.segment, sizeof(job.segment), "/gmu_%d", (int)getpid());
+	job.width = lab.cols;
+	job.height = lab.rows;
+	job.engine = engine;
+	job.radius = radius;
+	job.range = range;
+	job.output_offset = image_size;
+
+	// input and output side by side in one segment, the daemon maps it by name
+	int segment_fd = shm_open(job.segment, O_CREAT | O_RDWR | O_TRUNC, 0600);
+	if (segment_fd < 0 || ftruncate(segment_fd, (off_t)(image_size * 2)) != 0)
+	{
+		perror("shm_open");
+		if (segment_fd >= 0)
+		{
+			close(segment_fd);
+			shm_unlink(job.segment);
+		}
+		return cv::Mat();
+	}
+
+	void *segment = mmap(NULL, image_size * 2, PROT_READ | PROT_WRITE, MAP_SHARED, segment_fd, 0);
+	close(segment_fd);
+	if (segment == MAP_FAILED)
+	{
+		perror("mmap");
+		shm_unlink(job.segment);
+		return cv::Mat();
+	}
+
+	cv::Mat input(lab.rows, lab.cols, CV_32FC4, segment);
+	cv::Mat output(lab.rows, lab.cols, CV_32FC4, (char *)segment + image_size);
+	cv::cvtColor(lab, input, cv::COLOR_BGR2BGRA);
+
+	cv::Mat result;
+	int connection = connectDaemon(socket_path);
+	if (connection >= 0)
+	{
+		bool failed = false;
+		double total = 0.0, daemon_total = 0.0;
+		for (int i = 0; i < repeat && !failed; i++)
+		{
+			double begin = getTime();
+			Reply reply;
+			if (!sendAll(connection, &job, sizeof(job)) || !receiveAll(connection, &reply, sizeof(reply)) || reply.status != 0)
+			{
+				std::cerr << "Daemon job failed." << std::endl;
+				failed = true;
+				break;
+			}
+			double latency = getTime() - begin;
+			total += latency;
+			daemon_total += reply.latency;
+			printf("Job %d: %.3fms round trip, %.3fms in daemon\n", i + 1, latency * 1000, reply.latency * 1000);
+		}
+		close(connection);
+
+		if (!failed)
+		{
+			printf("\nClient: %d jobs %dx%d, average %.3fms round trip, %.3fms in daemon\n",
+				repeat, lab.cols, lab.rows, total / std::max(repeat, 1) * 1000, daemon_total / std::max(repeat, 1) * 1000);
+			cv::cvtColor(output, result, cv::COLOR_BGRA2BGR);
+		}
+	}
+
+	munmap(segment, image_size * 2);
+	shm_unlink(job.segment);
+	return result;
+}
+
+
+void FilterDaemon::shutdown(const std::string &socket_path)
+{
+	int connection = connectDaemon(socket_path);
+	if (connection < 0)
+	{
+		return;
+	}
+
+	Job job;
+	memset(&job, 0, sizeof(job));
+	job.magic = JOB_MAGIC;
+	job.command = COMMAND_SHUTDOWN;
+
+	Reply reply;
+	if (!sendAll(connection, &job, sizeof(job)) || !receiveAll(connection, &reply, sizeof(reply)))
+	{
+		std::cerr << "Daemon did not acknowledge shutdown." << std::endl;
+	}
+	close(connection);
+}
+
+#endif
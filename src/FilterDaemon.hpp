@@ -0,0 +1,136 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <stdint.h>
+#include <string>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Dlouho běžící filtr - kontext, fronta, programy a buffery zůstávají mezi úlohami.
+ *
+ * Úlohy přicházejí přes lokální Unix socket (Job, odpověď Reply). Démon hlídá (poll) naslouchající
+ * socket i všechna otevřená spojení a z každého připraveného spojení zpracuje jednu úlohu - klient,
+ * který spojení drží otevřené, neblokuje ostatní. Obrazová data se socketem
+ * neposílají - klient je zapíše do POSIX sdílené paměti (shm_open) a předá její název.
+ * Vstup i výstup jsou Lab float doplněné na 4 kanály (layout cl_float3), výstup má velikost
+ * vstupu a leží v segmentu od output_offset. Data jdou na zařízení přímo ze segmentu.
+ * Jádro basic filtruje Lab hrubou silou, jádro grid kanál L (a/b se zkopírují).
+ * Jen pro POSIX systémy.
+ */
+class FilterDaemon
+{
+public:
+	enum Command
+	{
+		COMMAND_FILTER = 0,
+		COMMAND_SHUTDOWN = 1
+	};
+
+	enum Engine
+	{
+		ENGINE_BASIC = 0,
+		ENGINE_GRID = 1
+	};
+
+	struct Job
+	{
+		uint32_t magic;       // JOB_MAGIC
+		int32_t command;
+		char segment[64];     // název segmentu sdílené paměti, např. /gmu_1234
+		int32_t width, height;
+		int32_t engine;
+		int32_t radius;       // basic: radius, grid: sigma_space
+		float range;          // basic: barvy, grid: sigma_color
+		uint64_t output_offset;
+	};
+
+	struct Reply
+	{
+		int32_t status;       // 0 = v pořádku
+		double latency;       // doba zpracování v démonu v sekundách (od přijetí úlohy)
+	};
+
+	static const uint32_t JOB_MAGIC = 0x4a554d47; // "GMUJ"
+
+	// meze parametrů úlohy - hodnoty ze socketu se kontrolují dřív, než se z nich počítají velikosti
+	static const int MAX_DIMENSION = 32768;
+	static const int MAX_RADIUS = 128;
+
+	// nejvíce současně otevřených spojení, doba čekání na zbytek rozepsané zprávy
+	static const int MAX_CONNECTIONS = 64;
+	static const int RECEIVE_TIMEOUT = 5; // s, platí i pro odeslání odpovědi
+
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	BilateralFilterCL filter;
+	BilateralGridCL grid;
+
+	// buffery se zvětšují podle potřeby a zůstávají pro další úlohy
+	cl::Buffer image_dev, padded_dev, lightness_dev;
+	size_t image_capacity, padded_capacity, lightness_capacity;
+
+	size_t max_alloc;
+
+	int jobs;
+	double total_latency, max_latency;
+
+private:
+	/**
+	 * Zvětší buffer na size bajtů. Vrátí false, pokud se nepodaří alokovat.
+	 */
+	bool reserve(cl::Buffer &buffer, size_t &capacity, size_t size);
+
+	/**
+	 * Zkontroluje parametry úlohy a velikost segmentu. Do image_size uloží velikost obrázku v bajtech.
+	 */
+	bool validate(const Job &job, size_t segment_size, size_t &image_size) const;
+
+	/**
+	 * Zpracuje úlohu nad namapovaným segmentem. Vrátí false, pokud selže alokace bufferu démona,
+	 * přenos nebo spuštění kernelu (démon běží dál). Sestavení programů a alokace uvnitř
+	 * BilateralGridCL končí jako ve zbytku programu (clPrintErrorExit) - validate proto předem
+	 * omezuje velikost mřížky na CL_DEVICE_MAX_MEM_ALLOC_SIZE.
+	 */
+	bool process(const Job &job, void *segment);
+
+	/**
+	 * Vyřídí jednu přijatou úlohu (filtr nebo ukončení) a vrátí odpověď.
+	 */
+	Reply serve(Job &job, bool &running);
+
+public:
+	FilterDaemon(cl::Context &context, cl::Device &device, cl::CommandQueue &queue);
+
+	/**
+	 * Přijímá úlohy na socketu socket_path, dokud nepřijde COMMAND_SHUTDOWN.
+	 * Každá úloha se vypíše s dobou zpracování. Vrátí počet zpracovaných úloh.
+	 */
+	int run(const std::string &socket_path);
+
+	/**
+	 * Vypíše počet úloh a průměrnou / největší dobu zpracování.
+	 */
+	void printStats(void);
+
+	/**
+	 * Klient - pošle démonovi repeat úloh nad obrázkem lab (CV_32FC3) a vrátí výsledek.
+	 * Vypíše dobu odezvy každé úlohy (včetně socketu) a dobu zpracování v démonu.
+	 */
+	static cv::Mat request(const std::string &socket_path, const cv::Mat &lab, Engine engine, int radius, float range, int repeat);
+
+	/**
+	 * Klient - ukončí démona.
+	 */
+	static void shutdown(const std::string &socket_path);
+};
@@ -0,0 +1,268 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "FilterGraph.hpp"
+#include "ProgramCache.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <iomanip>
+#include <sstream>
+#include <stdlib.h>
+
+
+FilterGraph::FilterGraph(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool specialise) :
+	context(context),
+	device(device),
+	queue(queue),
+	filter(context, device, queue, specialise),
+	grid(context, device, queue, false)
+{
+}
+
+
+bool FilterGraph::add(Operation operation, float parameter)
+{
+	if (isQuantised() || (isBGR() && operation != OP_QUANTISE))
+	{
+		return false;
+	}
+
+	operations.push_back(std::make_pair(operation, parameter));
+	return true;
+}
+
+
+bool FilterGraph::parse(const std::string &list)
+{
+	std::stringstream stream(list);
+	std::string item;
+
+	while (std::getline(stream, item, ','))
+	{
+		std::string name = item.substr(0, item.find('='));
+		float parameter = (item.find('=') != std::string::npos) ? (float)atof(item.c_str() + item.find('=') + 1) : 0.0f;
+		bool added;
+
+		if (name == "detail")
+		{
+			added = add(OP_DETAIL);
+		}
+		else if (name == "boost" && parameter > 0.0f)
+		{
+			added = add(OP_DETAIL_BOOST, parameter);
+		}
+		else if (name == "contrast" && parameter > 0.0f)
+		{
+			added = add(OP_CONTRAST, parameter);
+		}
+		else if (name == "bgr")
+		{
+			added = add(OP_LAB_TO_BGR);
+		}
+		else if (name == "u8")
+		{
+			added = add(OP_QUANTISE);
+		}
+		else
+		{
+			added = false;
+		}
+
+		if (!added)
+		{
+			return false;
+		}
+	}
+
+	return !operations.empty();
+}
+
+
+std::string FilterGraph::getSource(void) const
+{
+	std::stringstream source;
+
+	// Lab (float3) and L only (float) variants, the L variant skips the colour operations
+	std::stringstream lab, lightness;
+	lab << std::fixed << std::setprecision(6);
+	lightness << std::fixed << std::setprecision(6);
+
+	for (size_t i = 0; i < operations.size(); i++)
+	{
+		const float parameter = operations[i].second;
+
+		switch (operations[i].first)
+		{
+		case OP_DETAIL:
+			lab << " \\\n\tvalue = source_pix - value;";
+			lightness << " \\\n\tvalue = source_pix - value;";
+			break;
+		case OP_DETAIL_BOOST:
+			lab << " \\\n\tvalue = value + (source_pix - value) * " << parameter << "f;";
+			lightness << " \\\n\tvalue = value + (source_pix - value) * " << parameter << "f;";
+			break;
+		case OP_CONTRAST:
+			lab << " \\\n\tvalue.x = 0.5f + (value.x - 0.5f) * " << parameter << "f;";
+			lightness << " \\\n\tvalue = 0.5f + (value - 0.5f) * " << parameter << "f;";
+			break;
+		case OP_LAB_TO_BGR:
+			lab << " \\\n\tvalue = labToBGR(value);";
+			break;
+		case OP_QUANTISE:
+			break;
+		}
+	}
+
+	source << "#define GRAPH_OPS(value, source_pix)" << lab.str() << "\n";
+	source << "#define GRAPH_OPS_L(value, source_pix)" << lightness.str() << "\n";
+
+	if (isQuantised())
+	{
+		source << "#define GRAPH_OUTPUT uchar\n";
+		source << "#define GRAPH_STORE(destination, index, value) vstore3(convert_uchar3_sat_rte((value) * 255.0f), (index), (destination))\n";
+	}
+	else
+	{
+		source << "#define GRAPH_OUTPUT float4\n";
+		source << "#define GRAPH_STORE(destination, index, value) ((destination)[index] = (float4)((value), 0.0f))\n";
+	}
+
+	return source.str();
+}
+
+
+bool FilterGraph::isQuantised(void) const
+{
+	return !operations.empty() && operations.back().first == OP_QUANTISE;
+}
+
+
+bool FilterGraph::isBGR(void) const
+{
+	for (size_t i = 0; i < operations.size(); i++)
+	{
+		if (operations[i].first == OP_LAB_TO_BGR)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+cl::Kernel &FilterGraph::getSliceKernel(void)
+{
+	const std::string header = getSource();
+	if (header == slice_header)
+	{
+		return slice_kernel;
+	}
+
+	cl_int err_msg;
+	const char *files[] = { "filterGraph.cl", "bilateralGrid.cl" };
+
+	slice_kernel = cl::Kernel(ProgramCache::get(context, device, std::vector<std::string>(files, files + 2), "", header),
+		"bilateralGrid_sliceGraph", &err_msg);
+	clPrintErrorExit(err_msg, "bilateralGrid_sliceGraph");
+	slice_header = header;
+
+	return slice_kernel;
+}
+
+
+cl::Event FilterGraph::enqueueBasic(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, int radius, float range_param)
+{
+	// the existing brute-force kernels (blocked, radius-specialised) with the graph on their store
+	filter.setGraph(getSource());
+	filter.setChannels(3);
+	return filter.enqueue(source, destination, dst_width, dst_height, radius, range_param);
+}
+
+
+cl::Event FilterGraph::enqueueLightness(cl::Buffer &source, cl::Buffer &destination,
+	int dst_width, int dst_height, int radius, float range_param)
+{
+	filter.setGraph(getSource());
+	filter.setChannels(1);
+	return filter.enqueue(source, destination, dst_width, dst_height, radius, range_param);
+}
+
+
+cl::Event FilterGraph::enqueueGrid(cl::Buffer &source, cl::Buffer &lightness, cl::Buffer &destination,
+	int width, int height, float sigma_space, float sigma_color)
+{
+	// L * 255 always lies in 0 - 255, the slice kernel assumes source_min = 0
+	grid.enqueueNormalised(lightness, width, height, 0.0f, 255.0f, sigma_space, sigma_color);
+
+	auto bilateralGrid_sliceGraph = cl::make_kernel<
+		cl::Buffer&,
+		cl::Buffer&,
+		cl::Buffer&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_int&,
+		const cl_float&,
+		const cl_float&
+	>(getSliceKernel());
+
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(width, local[0]), alignTo(height, local[1]));
+
+	cl::Event event = bilateralGrid_sliceGraph(cl::EnqueueArgs(queue, global, local),
+		source, destination, grid.getNormalisedGrid(), width, height,
+		grid.getSmallHeight(), grid.getSmallWidth(), grid.getSmallDepth(), sigma_space, sigma_color);
+	Trace::addEvent("bilateralGrid_sliceGraph", event);
+	return event;
+}
+
+
+cv::Mat FilterGraph::applyHost(const cv::Mat &source, const cv::Mat &filtered) const
+{
+	cv::Mat value = filtered.clone();
+
+	for (size_t i = 0; i < operations.size(); i++)
+	{
+		const float parameter = operations[i].second;
+
+		switch (operations[i].first)
+		{
+		case OP_DETAIL:
+			value = source - value;
+			break;
+		case OP_DETAIL_BOOST:
+			value = value + (source - value) * parameter;
+			break;
+		case OP_CONTRAST:
+		{
+			std::vector<cv::Mat> channels;
+			cv::split(value, channels);
+			channels[0].convertTo(channels[0], -1, parameter, 0.5 - 0.5 * parameter);
+			cv::merge(channels, value);
+			break;
+		}
+		case OP_LAB_TO_BGR:
+		{
+			// as MyMat::saveLabToFile - through 8-bit Lab
+			cv::Mat lab_uint8, bgr_uint8;
+			value.convertTo(lab_uint8, CV_8UC3, 255.0);
+			cv::cvtColor(lab_uint8, bgr_uint8, cv::COLOR_Lab2BGR);
+			bgr_uint8.convertTo(value, CV_32FC3, 1.0 / 255);
+			break;
+		}
+		case OP_QUANTISE:
+			value.convertTo(value, CV_8UC3, 255.0);
+			break;
+		}
+	}
+
+	return value;
+}
@@ -0,0 +1,132 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Bilaterální filtr následovaný bodovými operacemi (detail, zesílení detailu, kontrast,
+ * Lab -> BGR, kvantizace na uint8) v jednom průchodu.
+ *
+ * Z operací se vygeneruje hlavička (makra GRAPH_OPS, GRAPH_OPS_L, GRAPH_STORE), se kterou se sestaví
+ * kernely BilateralFilterCL (basic, _radius, _blocked, _lightness) a slice mřížky (kanál L, a/b ze vstupu) -
+ * operace proběhnou při zápisu výstupu těchto kernelů. Mezivýsledky se do globální paměti nezapisují.
+ * Program se pro každý graf sestaví jednou (ProgramCache).
+ */
+class FilterGraph
+{
+public:
+	enum Operation
+	{
+		OP_DETAIL,        // zdroj - filtr (detailní vrstva)
+		OP_DETAIL_BOOST,  // filtr + parametr * (zdroj - filtr), unsharp mask
+		OP_CONTRAST,      // L = 0.5 + parametr * (L - 0.5)
+		OP_LAB_TO_BGR,    // Lab -> BGR, dál už jen OP_QUANTISE
+		OP_QUANTISE       // výstup uchar3, musí být poslední
+	};
+
+protected:
+	cl::Context context;
+	cl::Device device;
+	cl::CommandQueue queue;
+	BilateralFilterCL filter;
+	BilateralGridCL grid;
+
+	std::vector<std::pair<Operation, float> > operations;
+
+	// slice mřížky a hlavička, se kterou byl sestaven
+	cl::Kernel slice_kernel;
+	std::string slice_header;
+
+private:
+	cl::Kernel &getSliceKernel(void);
+
+public:
+	/**
+	 * specialise jako u BilateralFilterCL (varianty kernelu pro radius).
+	 */
+	FilterGraph(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, bool specialise = true);
+
+	/**
+	 * Připojí operaci na konec grafu. Vrátí false, pokud operace za předchozí nepatří
+	 * (po OP_LAB_TO_BGR jen OP_QUANTISE, po OP_QUANTISE nic).
+	 */
+	bool add(Operation operation, float parameter = 0.0f);
+
+	/**
+	 * Operace ze seznamu odděleného čárkou: detail, boost=k, contrast=k, bgr, u8.
+	 * Vrátí false pro neznámou operaci nebo špatné pořadí.
+	 */
+	bool parse(const std::string &list);
+
+	/**
+	 * Vygenerovaná hlavička vkládaná před filterGraph.cl a bilateralFilter_basic.cl / bilateralGrid.cl.
+	 */
+	std::string getSource(void) const;
+
+	bool isQuantised(void) const;
+
+	bool isBGR(void) const;
+
+	/**
+	 * Zda graf lze použít jen na kanál L (bez OP_LAB_TO_BGR a OP_QUANTISE).
+	 */
+	bool isLightnessOnly(void) const
+	{
+		return !isBGR() && !isQuantised();
+	}
+
+	/**
+	 * Filtr hrubou silou pro nastavení bloku a specializace radiusu.
+	 */
+	BilateralFilterCL &getFilter(void)
+	{
+		return filter;
+	}
+
+	/**
+	 * Velikost jednoho výstupního bodu v bajtech (uchar3 nebo float4).
+	 */
+	size_t getPixelSize(void) const
+	{
+		return isQuantised() ? 3 : sizeof(cl_float4);
+	}
+
+	/**
+	 * Hrubá síla s operacemi grafu. source je Lab (cl_float3), výstup je menší o 2x radius.
+	 */
+	cl::Event enqueueBasic(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, int radius, float range_param);
+
+	/**
+	 * Hrubá síla jen nad kanálem L (float) s operacemi grafu, jen pro isLightnessOnly.
+	 * Výstup je float, menší o 2x radius.
+	 */
+	cl::Event enqueueLightness(cl::Buffer &source, cl::Buffer &destination,
+		int dst_width, int dst_height, int radius, float range_param);
+
+	/**
+	 * Mřížka nad kanálem L s operacemi grafu ve slice. source je Lab (cl_float3), lightness
+	 * je L * 255 (float) stejného obrázku, výstup má velikost vstupu.
+	 */
+	cl::Event enqueueGrid(cl::Buffer &source, cl::Buffer &lightness, cl::Buffer &destination,
+		int width, int height, float sigma_space, float sigma_color);
+
+	/**
+	 * Stejné operace na hostiteli po samostatných průchodech (pro porovnání). source a filtered
+	 * jsou Lab CV_32FC3, výsledek CV_32FC3 nebo CV_8UC3 (OP_QUANTISE).
+	 */
+	cv::Mat applyHost(const cv::Mat &source, const cv::Mat &filtered) const;
+};
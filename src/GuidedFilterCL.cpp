@@ -0,0 +1,121 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "GuidedFilterCL.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+
+GuidedFilterCL::GuidedFilterCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue) :
+	context(context),
+	queue(queue),
+	program(buildProgram(context, device, std::vector<std::string>(1, "guidedFilter.cl"))),
+	prepare(program, "guidedFilter_prepare"),
+	scanRows(program, "guidedFilter_scanRows"),
+	boxColumns(program, "guidedFilter_boxColumns"),
+	coefficients(program, "guidedFilter_coefficients"),
+	output(program, "guidedFilter_output"),
+	buffer_width(0),
+	buffer_height(0)
+{
+	// Hillis-Steele scan needs a power of two work-group
+	size_t max_local_size = device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>();
+	scan_local_size = 1;
+	while (scan_local_size * 2 <= max_local_size && scan_local_size < 256)
+	{
+		scan_local_size *= 2;
+	}
+}
+
+
+void GuidedFilterCL::allocate(int width, int height)
+{
+	if (width == buffer_width && height == buffer_height)
+	{
+		return;
+	}
+
+	cl_int err_msg;
+	size_t plane_size = sizeof(cl_float4) * width * height;
+
+	moments = cl::Buffer(context, CL_MEM_READ_WRITE, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: guided moments");
+	cross = cl::Buffer(context, CL_MEM_READ_WRITE, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: guided cross");
+	prefix = cl::Buffer(context, CL_MEM_READ_WRITE, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: guided prefix");
+
+	buffer_width = width;
+	buffer_height = height;
+}
+
+
+void GuidedFilterCL::enqueueBoxSum(cl::Buffer &plane, int width, int height, int radius)
+{
+	kernel_names.push_back("guidedFilter_scanRows");
+	kernel_events.push_back(scanRows(
+		cl::EnqueueArgs(queue, cl::NDRange(scan_local_size, height), cl::NDRange(scan_local_size, 1)),
+		plane,
+		prefix,
+		width,
+		cl::Local(sizeof(cl_float4) * scan_local_size)
+	));
+
+	cl::NDRange local(64);
+	kernel_names.push_back("guidedFilter_boxColumns");
+	kernel_events.push_back(boxColumns(
+		cl::EnqueueArgs(queue, cl::NDRange(alignTo(width, local[0])), local),
+		prefix,
+		plane,
+		width,
+		height,
+		radius
+	));
+}
+
+
+cl::Event GuidedFilterCL::enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height, int radius, float epsilon)
+{
+	allocate(width, height);
+	kernel_events.clear();
+	kernel_names.clear();
+
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(width, local[0]), alignTo(height, local[1]));
+
+	kernel_names.push_back("guidedFilter_prepare");
+	kernel_events.push_back(prepare(cl::EnqueueArgs(queue, global, local), source, moments, cross, width, height));
+
+	enqueueBoxSum(moments, width, height, radius);
+	enqueueBoxSum(cross, width, height, radius);
+
+	kernel_names.push_back("guidedFilter_coefficients");
+	kernel_events.push_back(coefficients(cl::EnqueueArgs(queue, global, local), moments, cross, width, height, radius, epsilon));
+
+	enqueueBoxSum(moments, width, height, radius);
+	enqueueBoxSum(cross, width, height, radius);
+
+	kernel_names.push_back("guidedFilter_output");
+	kernel_events.push_back(output(cl::EnqueueArgs(queue, global, local), source, destination, moments, cross, width, height, radius));
+
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		Trace::addEvent(kernel_names[i], kernel_events[i]);
+	}
+
+	return kernel_events.back();
+}
+
+
+double GuidedFilterCL::getKernelTime(void)
+{
+	double time = 0.0;
+	for (size_t i = 0; i < kernel_events.size(); i++)
+	{
+		time += getEventTime(kernel_events[i]);
+	}
+	return time;
+}
@@ -0,0 +1,83 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * Guided filter v OpenCL (guidedFilter.cl).
+ * Mezivýsledky (dvě roviny float4 a prefixové součty) zůstávají na zařízení mezi voláními.
+ */
+class GuidedFilterCL
+{
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	cl::Program program;
+	size_t scan_local_size;
+
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&> prepare;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, cl::LocalSpaceArg> scanRows;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&> boxColumns;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&, const cl_float&> coefficients;
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&, const cl_int&> output;
+
+	cl::Buffer moments, cross, prefix;
+	int buffer_width, buffer_height;
+
+	std::vector<cl::Event> kernel_events;
+	std::vector<std::string> kernel_names;
+
+private:
+	/**
+	 * (Re)alokuje mezivýsledky pro obrázek zadané velikosti.
+	 */
+	void allocate(int width, int height);
+
+	/**
+	 * Box součty roviny plane (na místě).
+	 */
+	void enqueueBoxSum(cl::Buffer &plane, int width, int height, int radius);
+
+public:
+	GuidedFilterCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue);
+
+	/**
+	 * Zařadí filtr do fronty. source a destination obsahují width x height pixelů cl_float3.
+	 * Vrátí událost posledního kernelu.
+	 */
+	cl::Event enqueue(cl::Buffer &source, cl::Buffer &destination, int width, int height, int radius, float epsilon);
+
+	/**
+	 * Součet doby běhu kernelů posledního volání enqueue v sekundách (po dokončení fronty).
+	 */
+	double getKernelTime(void);
+
+	/**
+	 * Události a názvy kernelů posledního volání enqueue (ve stejném pořadí).
+	 */
+	const std::vector<cl::Event> &getKernelEvents(void) const
+	{
+		return kernel_events;
+	}
+
+	const std::vector<std::string> &getKernelNames(void) const
+	{
+		return kernel_names;
+	}
+
+	/**
+	 * Velikost pracovní skupiny prefixového součtu.
+	 */
+	size_t getScanLocalSize(void) const
+	{
+		return scan_local_size;
+	}
+};
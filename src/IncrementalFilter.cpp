@@ -0,0 +1,245 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "IncrementalFilter.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+
+
+IncrementalFilter::IncrementalFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	bool grid_engine, int param_space, float param_range) :
+	context(context),
+	queue(queue),
+	filter(context, device, queue),
+	grid(context, device, queue),
+	grid_engine(grid_engine),
+	param_space(param_space),
+	param_range(param_range),
+	width(0),
+	height(0),
+	uploaded_bytes(0),
+	recomputed_pixels(0)
+{
+}
+
+
+int IncrementalFilter::margin(void) const
+{
+	// grid: splat rounding, [1 2 1] blur twice and the trilinear slice reach 4 cells of sigma_space pixels
+	return grid_engine ? 4 * param_space : param_space;
+}
+
+
+void IncrementalFilter::uploadRect(const cv::Mat &lab, const cv::Rect &rect)
+{
+	cv::Rect source_rect;
+
+	if (grid_engine)
+	{
+		cv::Mat lightness;
+		cv::extractChannel(lab(rect), lightness, 0);
+		lightness *= 255.0;
+		lightness.copyTo(source(rect));
+		source_rect = rect;
+	}
+	else
+	{
+		// the border replication changes too when the rectangle touches the image border
+		const int r = param_space;
+		const int left = rect.x == 0 ? r : 0;
+		const int top = rect.y == 0 ? r : 0;
+		const int right = rect.x + rect.width == width ? r : 0;
+		const int bottom = rect.y + rect.height == height ? r : 0;
+
+		cv::Mat padded, padded4;
+		cv::copyMakeBorder(lab(rect), padded, top, bottom, left, right, cv::BORDER_REPLICATE);
+		cv::cvtColor(padded, padded4, cv::COLOR_BGR2BGRA);
+
+		source_rect = cv::Rect(rect.x + r - left, rect.y + r - top, padded4.cols, padded4.rows);
+		padded4.copyTo(source(source_rect));
+	}
+
+	const size_t element = source.elemSize();
+	cl::size_t<3> origin, region;
+	origin[0] = source_rect.x * element;
+	origin[1] = source_rect.y;
+	origin[2] = 0;
+	region[0] = source_rect.width * element;
+	region[1] = source_rect.height;
+	region[2] = 1;
+
+	clPrintErrorExit(queue.enqueueWriteBufferRect(source_dev, CL_FALSE, origin, origin, region,
+		source.cols * element, 0, source.step, 0, source.data), "clEnqueueWriteBufferRect: incremental source");
+	uploaded_bytes += region[0] * region[1];
+}
+
+
+void IncrementalFilter::readRect(const cv::Mat &lab, const cv::Rect &rect)
+{
+	const size_t element = filtered.elemSize();
+	cl::size_t<3> origin, region;
+	origin[0] = rect.x * element;
+	origin[1] = rect.y;
+	origin[2] = 0;
+	region[0] = rect.width * element;
+	region[1] = rect.height;
+	region[2] = 1;
+
+	clPrintErrorExit(queue.enqueueReadBufferRect(dest_dev, CL_TRUE, origin, origin, region,
+		filtered.cols * element, 0, filtered.step, 0, filtered.data), "clEnqueueReadBufferRect: incremental dest");
+
+	cv::Mat part;
+	if (grid_engine)
+	{
+		std::vector<cv::Mat> planes;
+		cv::split(lab(rect), planes);
+		planes[0] = filtered(rect) / 255.0;
+		cv::merge(planes, part);
+	}
+	else
+	{
+		cv::cvtColor(filtered(rect), part, cv::COLOR_BGRA2BGR);
+	}
+	part.copyTo(result(rect));
+}
+
+
+const cv::Mat &IncrementalFilter::reset(const cv::Mat &lab)
+{
+	TRACE_SCOPE("incremental reset");
+	cl_int err_msg;
+
+	width = lab.cols;
+	height = lab.rows;
+	uploaded_bytes = 0;
+
+	if (grid_engine)
+	{
+		source.create(height, width, CV_32FC1);
+		filtered.create(height, width, CV_32FC1);
+	}
+	else
+	{
+		source.create(height + 2 * param_space, width + 2 * param_space, CV_32FC4);
+		filtered.create(height, width, CV_32FC4);
+	}
+	result.create(height, width, CV_32FC3);
+
+	source_dev = cl::Buffer(context, CL_MEM_READ_ONLY, source.total() * source.elemSize(), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: incremental source");
+	dest_dev = cl::Buffer(context, CL_MEM_READ_WRITE, filtered.total() * filtered.elemSize(), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: incremental dest");
+
+	const cv::Rect all(0, 0, width, height);
+	uploadRect(lab, all);
+
+	if (grid_engine)
+	{
+		// fixed range 0-255 keeps the grid size for the later updates
+		grid.setSliceRegion(0, 0, 0, 0);
+		grid.enqueueTemporal(source_dev, dest_dev, width, height, 0.0f, 255.0f, (float)param_space, param_range,
+			std::vector<cl_int2>(), true);
+	}
+	else
+	{
+		filter.enqueue(source_dev, dest_dev, width, height, param_space, param_range);
+	}
+
+	readRect(lab, all);
+	recomputed_pixels = (size_t)width * height;
+	return result;
+}
+
+
+const cv::Mat &IncrementalFilter::update(const cv::Mat &lab, const std::vector<cv::Rect> &dirty)
+{
+	TRACE_SCOPE("incremental update");
+
+	const cv::Rect all(0, 0, width, height);
+	uploaded_bytes = 0;
+	recomputed_pixels = 0;
+
+	std::vector<cv::Rect> changed, affected;
+	for (size_t i = 0; i < dirty.size(); i++)
+	{
+		cv::Rect rect = dirty[i] & all;
+		if (rect.area() == 0)
+		{
+			continue;
+		}
+		changed.push_back(rect);
+
+		const int m = margin();
+		affected.push_back(cv::Rect(rect.x - m, rect.y - m, rect.width + 2 * m, rect.height + 2 * m) & all);
+	}
+
+	if (changed.empty())
+	{
+		return result;
+	}
+
+	for (size_t i = 0; i < changed.size(); i++)
+	{
+		uploadRect(lab, changed[i]);
+	}
+
+	if (grid_engine)
+	{
+		// every tile touched by a changed rectangle, each only once
+		const int tile = BilateralGridCL::TEMPORAL_TILE;
+		const int tiles_x = (width + tile - 1) / tile;
+		const int tiles_y = (height + tile - 1) / tile;
+		std::vector<bool> marked(tiles_x * tiles_y, false);
+		std::vector<cl_int2> tiles;
+
+		cv::Rect bounds = affected[0];
+		for (size_t i = 0; i < changed.size(); i++)
+		{
+			bounds |= affected[i];
+
+			for (int ty = changed[i].y / tile; ty <= (changed[i].y + changed[i].height - 1) / tile; ty++)
+			{
+				for (int tx = changed[i].x / tile; tx <= (changed[i].x + changed[i].width - 1) / tile; tx++)
+				{
+					if (!marked[ty * tiles_x + tx])
+					{
+						marked[ty * tiles_x + tx] = true;
+						cl_int2 position;
+						position.s[0] = tx;
+						position.s[1] = ty;
+						tiles.push_back(position);
+					}
+				}
+			}
+		}
+
+		// one slice over the bounding box of the affected regions
+		affected.assign(1, bounds);
+		grid.setSliceRegion(bounds.x, bounds.y, bounds.width, bounds.height);
+		grid.enqueueTemporal(source_dev, dest_dev, width, height, 0.0f, 255.0f, (float)param_space, param_range, tiles, false);
+		grid.setSliceRegion(0, 0, 0, 0);
+	}
+	else
+	{
+		for (size_t i = 0; i < affected.size(); i++)
+		{
+			filter.enqueueRegion(source_dev, dest_dev, width, height, param_space, param_range,
+				affected[i].x, affected[i].y, affected[i].width, affected[i].height);
+		}
+	}
+
+	for (size_t i = 0; i < affected.size(); i++)
+	{
+		readRect(lab, affected[i]);
+		recomputed_pixels += affected[i].area();
+	}
+
+	return result;
+}
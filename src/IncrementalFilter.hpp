@@ -0,0 +1,90 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <vector>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Přírůstkové filtrování - mezi voláními se mění jen malé obdélníky obrázku (retušovací štětec).
+ *
+ * Vstup i výstup zůstávají na zařízení. update nahraje jen změněné obdélníky vstupu
+ * a přepočítá jen výstup, který na ně dosáhne:
+ *  - basic (Lab hrubou silou) - obdélník rozšířený o radius,
+ *  - grid (kanál L) - v mřížce se přepočítají jen dlaždice obdélníků (BilateralGridCL::enqueueTemporal),
+ *    slice jen pro pixely, které čtou ovlivněné buňky (obdélník rozšířený o 4 buňky).
+ * Výstup má velikost vstupu (okraje replikované), z výstupu se čtou jen přepočítané oblasti.
+ */
+class IncrementalFilter
+{
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	BilateralFilterCL filter;
+	BilateralGridCL grid;
+
+	bool grid_engine;
+	int param_space;
+	float param_range;
+
+	int width, height;
+	cv::Mat source;     // obsah source_dev - basic: Lab float4 rozšířený o radius, grid: L 0-255
+	cv::Mat filtered;   // obsah dest_dev - basic: Lab float4, grid: L 0-255
+	cv::Mat result;     // Lab CV_32FC3
+	cl::Buffer source_dev, dest_dev;
+
+	size_t uploaded_bytes;
+	size_t recomputed_pixels;
+
+private:
+	/**
+	 * Přepíše obdélník rect (souřadnice obrázku) vstupu na hostiteli a nahraje ho na zařízení.
+	 */
+	void uploadRect(const cv::Mat &lab, const cv::Rect &rect);
+
+	/**
+	 * Přečte obdélník výstupu a převede ho do result.
+	 */
+	void readRect(const cv::Mat &lab, const cv::Rect &rect);
+
+	/**
+	 * Okraj, o který se rozšíří změněný obdélník pro přepočet výstupu.
+	 */
+	int margin(void) const;
+
+public:
+	IncrementalFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+		bool grid_engine, int param_space, float param_range);
+
+	/**
+	 * Nahraje celý obrázek (Lab CV_32FC3) a spočítá celý výstup.
+	 */
+	const cv::Mat &reset(const cv::Mat &lab);
+
+	/**
+	 * Obrázek se od posledního volání změnil jen v obdélnících dirty - přepočítá jen ovlivněný výstup.
+	 */
+	const cv::Mat &update(const cv::Mat &lab, const std::vector<cv::Rect> &dirty);
+
+	/**
+	 * Nahrané bajty a přepočítané pixely posledního volání reset / update.
+	 */
+	size_t getUploadedBytes(void) const
+	{
+		return uploaded_bytes;
+	}
+
+	size_t getRecomputedPixels(void) const
+	{
+		return recomputed_pixels;
+	}
+};
@@ -0,0 +1,33 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "JointUpsampleCL.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <string>
+#include <vector>
+
+
+JointUpsampleCL::JointUpsampleCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue) :
+	queue(queue),
+	program(buildProgram(context, device, std::vector<std::string>(1, "jointBilateralUpsample.cl"))),
+	upsample(program, "jointBilateralUpsample")
+{
+}
+
+
+cl::Event JointUpsampleCL::enqueue(cl::Buffer &low, cl::Buffer &low_guide, cl::Buffer &guide, cl::Buffer &destination,
+	int width, int height, int low_width, int low_height, float range_param)
+{
+	cl::NDRange local(16, 16);
+	cl::NDRange global(alignTo(width, local[0]), alignTo(height, local[1]));
+
+	cl::Event event = upsample(cl::EnqueueArgs(queue, global, local),
+		low, low_guide, guide, destination, width, height, low_width, low_height, RADIUS, range_param);
+	Trace::addEvent("jointBilateralUpsample", event);
+	return event;
+}
@@ -0,0 +1,36 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+/**
+ * Joint bilateral upsampling v OpenCL (jointBilateralUpsample.cl).
+ * Obraz filtrovaný v nízkém rozlišení se převede do plného rozlišení podle vodicího obrazu.
+ */
+class JointUpsampleCL
+{
+protected:
+	cl::CommandQueue queue;
+	cl::Program program;
+
+	cl::make_kernel<cl::Buffer&, cl::Buffer&, cl::Buffer&, cl::Buffer&, const cl_int&, const cl_int&,
+		const cl_int&, const cl_int&, const cl_int&, const cl_float&> upsample;
+
+public:
+	// okno v pixelech nízkého rozlišení
+	static const int RADIUS = 2;
+
+	JointUpsampleCL(cl::Context &context, cl::Device &device, cl::CommandQueue &queue);
+
+	/**
+	 * Zařadí upsampling do fronty. Všechny buffery obsahují cl_float3,
+	 * low a low_guide low_width x low_height, guide a destination width x height.
+	 */
+	cl::Event enqueue(cl::Buffer &low, cl::Buffer &low_guide, cl::Buffer &guide, cl::Buffer &destination,
+		int width, int height, int low_width, int low_height, float range_param);
+};
@@ -0,0 +1,209 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "MultiDeviceFilter.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <algorithm>
+
+
+MultiDeviceFilter::DeviceState::DeviceState(cl::Device &device, cl::Context &context, cl::CommandQueue &queue, bool specialise) :
+	device(device),
+	context(context),
+	queue(queue),
+	filter(context, device, queue, specialise),
+	source_capacity(0),
+	destination_capacity(0),
+	capability(0.0),
+	throughput(0.0),
+	measured(false),
+	rows_begin(0),
+	rows_end(0),
+	time(0.0)
+{
+	// first estimate before anything is measured
+	capability = (double)device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * device.getInfo<CL_DEVICE_MAX_CLOCK_FREQUENCY>();
+}
+
+
+MultiDeviceFilter::MultiDeviceFilter(bool specialise)
+{
+	std::vector<cl::Platform> platforms;
+	cl_int err_msg;
+
+	clPrintErrorExit(cl::Platform::get(&platforms), "cl::Platform::get");
+
+	for (size_t i = 0; i < platforms.size(); i++)
+	{
+		std::vector<cl::Device> platform_devices;
+		clPrintErrorExit(platforms[i].getDevices(CL_DEVICE_TYPE_ALL, &platform_devices), "getDevices");
+
+		for (size_t j = 0; j < platform_devices.size(); j++)
+		{
+			cl::Context context(platform_devices[j], NULL, NULL, NULL, &err_msg);
+			clPrintErrorExit(err_msg, "cl::Context");
+			cl::CommandQueue queue(context, platform_devices[j], CL_QUEUE_PROFILING_ENABLE, &err_msg);
+			clPrintErrorExit(err_msg, "cl::CommandQueue");
+
+			devices.push_back(DeviceState(platform_devices[j], context, queue, specialise));
+		}
+	}
+
+	if (devices.empty())
+	{
+		clPrintErrorExit(CL_DEVICE_NOT_FOUND, "no OpenCL device");
+	}
+}
+
+
+void MultiDeviceFilter::split(int rows)
+{
+	// rows/s per CU x MHz of the measured devices, so that unmeasured devices
+	// (e.g. ones whose band rounded to zero rows) are weighed in the same unit
+	double measured_throughput = 0.0, measured_capability = 0.0;
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		if (devices[i].measured)
+		{
+			measured_throughput += devices[i].throughput;
+			measured_capability += devices[i].capability;
+		}
+	}
+	double scale = (measured_capability > 0.0) ? measured_throughput / measured_capability : 1.0;
+
+	std::vector<double> weights(devices.size());
+	double total = 0.0;
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		weights[i] = devices[i].measured ? devices[i].throughput : devices[i].capability * scale;
+		total += weights[i];
+	}
+
+	double share = 0.0;
+	int begin = 0;
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		share += (total > 0.0) ? weights[i] / total : 1.0 / devices.size();
+		int end = (i + 1 == devices.size()) ? rows : std::min(rows, (int)(share * rows + 0.5));
+
+		devices[i].rows_begin = begin;
+		devices[i].rows_end = std::max(begin, end);
+		begin = devices[i].rows_end;
+	}
+}
+
+
+void MultiDeviceFilter::ensureCapacity(DeviceState &state, size_t source_size, size_t destination_size)
+{
+	cl_int err_msg;
+
+	if (source_size > state.source_capacity)
+	{
+		state.source = cl::Buffer(state.context, CL_MEM_READ_ONLY, source_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: band source");
+		state.source_capacity = source_size;
+	}
+
+	if (destination_size > state.destination_capacity)
+	{
+		state.destination = cl::Buffer(state.context, CL_MEM_WRITE_ONLY, destination_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: band destination");
+		state.destination_capacity = destination_size;
+	}
+}
+
+
+void MultiDeviceFilter::run(const cl_float3 *source, cl_float3 *destination,
+	int src_width, int src_height, int radius, float range_param)
+{
+	const int dst_width = src_width - 2 * radius;
+	const int dst_height = src_height - 2 * radius;
+
+	split(dst_height);
+
+	// enqueue every band first, the devices run concurrently
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		DeviceState &state = devices[i];
+		int band_rows = state.rows_end - state.rows_begin;
+		if (band_rows == 0)
+		{
+			continue;
+		}
+
+		size_t source_size = sizeof(cl_float3) * src_width * (band_rows + 2 * radius);
+		size_t destination_size = sizeof(cl_float3) * dst_width * band_rows;
+		ensureCapacity(state, source_size, destination_size);
+
+		std::string track = state.device.getInfo<CL_DEVICE_NAME>();
+
+		clPrintErrorExit(state.queue.enqueueWriteBuffer(
+			state.source, CL_FALSE, 0, source_size,
+			source + (size_t)state.rows_begin * src_width,
+			NULL, &state.write_event
+		), "clEnqueueWriteBuffer: band source");
+		Trace::addEvent("write band", state.write_event, track);
+
+		state.kernel_event = state.filter.enqueue(state.source, state.destination, dst_width, band_rows, radius, range_param);
+
+		clPrintErrorExit(state.queue.enqueueReadBuffer(
+			state.destination, CL_FALSE, 0, destination_size,
+			destination + (size_t)state.rows_begin * dst_width,
+			NULL, &state.read_event
+		), "clEnqueueReadBuffer: band destination");
+		Trace::addEvent("read band", state.read_event, track);
+
+		state.queue.flush();
+	}
+
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		devices[i].queue.finish();
+	}
+
+	// new throughput estimates for the next call
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		DeviceState &state = devices[i];
+		int band_rows = state.rows_end - state.rows_begin;
+		if (band_rows == 0)
+		{
+			state.time = 0.0;
+			continue;
+		}
+
+		state.time = getEventTime(state.write_event) + getEventTime(state.kernel_event) + getEventTime(state.read_event);
+		double measured = band_rows / std::max(state.time, 1e-9);
+
+		state.throughput = state.measured ? 0.5 * (state.throughput + measured) : measured;
+		state.measured = true;
+	}
+}
+
+
+void MultiDeviceFilter::printBalance(void) const
+{
+	for (size_t i = 0; i < devices.size(); i++)
+	{
+		const DeviceState &state = devices[i];
+		printf(" %d. %s: rows %d-%d (%d), %.3fms, ",
+			(int)i,
+			state.device.getInfo<CL_DEVICE_NAME>().c_str(),
+			state.rows_begin,
+			state.rows_end,
+			state.rows_end - state.rows_begin,
+			state.time * 1000);
+		if (state.measured)
+		{
+			printf("%.0f rows/s\n", state.throughput);
+		}
+		else
+		{
+			printf("not measured\n");
+		}
+	}
+}
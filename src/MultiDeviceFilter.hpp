@@ -0,0 +1,81 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <vector>
+
+#include "BilateralFilterCL.hpp"
+
+/**
+ * Bilaterální filtr (bilateralFilter_basic) rozdělený po pásech řádků mezi všechna zařízení OpenCL.
+ *
+ * Každé zařízení má vlastní kontext a frontu (zařízení mohou být z různých platforem).
+ * Pás výstupních řádků [begin, end) potřebuje vstupní řádky [begin, end + 2 * radius),
+ * tedy halo zónu z obou stran. Velikost pásů se řídí změřenou propustností zařízení
+ * (řádky za sekundu), která se po každém volání run() aktualizuje - při zpracování
+ * dávky se tak rozdělení postupně vyvažuje.
+ */
+class MultiDeviceFilter
+{
+protected:
+	struct DeviceState
+	{
+		cl::Device device;
+		cl::Context context;
+		cl::CommandQueue queue;
+		BilateralFilterCL filter;
+
+		cl::Buffer source, destination;
+		size_t source_capacity, destination_capacity;
+
+		double capability; // výpočetní jednotky x MHz - jen k odhadu, dokud zařízení není změřené
+		double throughput; // řádky za sekundu, platí jen když measured
+		bool measured;
+		int rows_begin, rows_end;
+		double time;
+
+		cl::Event write_event, kernel_event, read_event;
+
+		DeviceState(cl::Device &device, cl::Context &context, cl::CommandQueue &queue, bool specialise);
+	};
+
+	std::vector<DeviceState> devices;
+
+private:
+	/**
+	 * Rozdělí rows výstupních řádků podle odhadu propustnosti. Nezměřená zařízení
+	 * dostanou capability přepočtenou na řádky za sekundu podle změřených zařízení.
+	 */
+	void split(int rows);
+
+	void ensureCapacity(DeviceState &state, size_t source_size, size_t destination_size);
+
+public:
+	/**
+	 * Najde všechna zařízení všech platforem a pro každé vytvoří kontext a frontu.
+	 */
+	MultiDeviceFilter(bool specialise = true);
+
+	size_t getDeviceCount(void) const
+	{
+		return devices.size();
+	}
+
+	/**
+	 * Filtruje source (src_width x src_height cl_float3) do destination,
+	 * výstup je menší o 2x radius. Po návratu je výsledek hotový.
+	 */
+	void run(const cl_float3 *source, cl_float3 *destination,
+		int src_width, int src_height, int radius, float range_param);
+
+	/**
+	 * Vypíše rozdělení a časy posledního volání run().
+	 */
+	void printBalance(void) const;
+};
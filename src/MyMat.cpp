@@ -5,6 +5,10 @@
  */
 
 #include "MyMat.hpp"
+#include "RawImage.hpp"
+#include "Trace.hpp"
+
+#include <stdexcept>
 
 
 MyMat::MyMat() : flData(NULL)
@@ -40,7 +44,23 @@ void MyMat::loadImageFromFile(std::string fileName)
 	 * Typ float bude v rozsahu 0-1.
 	 */
 
-	cv::Mat im_bgr_uint8 = cv::imread(fileName, CV_LOAD_IMAGE_COLOR);
+	// surov formt u obsahuje Lab float, nic se nedekduje
+	if (RawImage::isRawFile(fileName))
+	{
+		RawImage raw;
+		if (!raw.open(fileName))
+		{
+			throw std::runtime_error("raw image could not be opened");
+		}
+		mat = raw.toLab();
+		return;
+	}
+
+	cv::Mat im_bgr_uint8;
+	{
+		TRACE_SCOPE("imread");
+		im_bgr_uint8 = cv::imread(fileName, CV_LOAD_IMAGE_COLOR);
+	}
 
 	if (!im_bgr_uint8.data)
 	{
@@ -48,8 +68,12 @@ void MyMat::loadImageFromFile(std::string fileName)
 	}
 
 	cv::Mat im_lab_uint8;
-	cv::cvtColor(im_bgr_uint8, im_lab_uint8, cv::COLOR_BGR2Lab);
+	{
+		TRACE_SCOPE("cvtColor BGR2Lab");
+		cv::cvtColor(im_bgr_uint8, im_lab_uint8, cv::COLOR_BGR2Lab);
+	}
 
+	TRACE_SCOPE("convertTo CV_32FC3");
 	im_lab_uint8.convertTo(mat, CV_32FC3, 1.0 / 255);
 }
 
@@ -63,18 +87,69 @@ void MyMat::saveImageToFile(std::string fileName)
 	 * Pevd se do barevnho prostoru BGR s datovmi typy UINT8.
 	 * Typ float se pedpokld v rozsahu 0-1.
 	 */
+	saveLabToFile(mat, fileName);
+}
+
+
+void MyMat::saveImageToFile(std::string fileName, const cv::Mat &lightness)
+{
+	/*
+	 * Rovina L se spoj s kanly a, b pvodnho obrzku (jen L-filtr).
+	 */
+	cv::Rect center((mat.cols - lightness.cols) / 2, (mat.rows - lightness.rows) / 2, lightness.cols, lightness.rows);
+
+	std::vector<cv::Mat> planes;
+	cv::split(mat(center), planes);
+	planes[0] = lightness;
+
+	cv::Mat im_lab;
+	{
+		TRACE_SCOPE("merge L, a, b");
+		cv::merge(planes, im_lab);
+	}
+
+	saveLabToFile(im_lab, fileName);
+}
+
+
+cv::Mat MyMat::getLightness(void)
+{
+	cv::Mat lightness;
+	cv::extractChannel(mat, lightness, 0);
+	return lightness;
+}
+
+
+void MyMat::saveLabToFile(const cv::Mat &lab, std::string fileName)
+{
+	if (RawImage::isRawFile(fileName))
+	{
+		TRACE_SCOPE("RawImage::save");
+		RawImage::save(fileName, lab);
+		return;
+	}
+
 	cv::Mat im_lab_uint8;
-	mat.convertTo(im_lab_uint8, CV_8UC3, 255.0);
+	{
+		TRACE_SCOPE("convertTo CV_8UC3");
+		lab.convertTo(im_lab_uint8, CV_8UC3, 255.0);
+	}
 
 	cv::Mat im_bgr_uint8;
-	cv::cvtColor(im_lab_uint8, im_bgr_uint8, cv::COLOR_Lab2BGR);
+	{
+		TRACE_SCOPE("cvtColor Lab2BGR");
+		cv::cvtColor(im_lab_uint8, im_bgr_uint8, cv::COLOR_Lab2BGR);
+	}
 
+	TRACE_SCOPE("imwrite");
 	cv::imwrite(fileName, im_bgr_uint8);
 }
 
 
 cl_float3 * MyMat::getData(void)
 {
+	TRACE_SCOPE("MyMat::getData");
+
 	freeFlData();
 
 	flData = (cl_float3 *)malloc(getDataSize());
@@ -99,6 +174,8 @@ cl_float3 * MyMat::getData(void)
 
 void MyMat::setData(cl_float3 * data)
 {
+	TRACE_SCOPE("MyMat::setData");
+
 	cl_float3 temp;
 
 	for (int row = 0; row < mat.rows; row++)
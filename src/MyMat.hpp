@@ -30,6 +30,11 @@ private:
 	 */
 	void freeFlData(void);
 
+	/**
+	 * Pevede obrazov data Lab (float 0-1) do BGR UINT8 a ulo je do souboru.
+	 */
+	static void saveLabToFile(const cv::Mat &lab, std::string fileName);
+
 public:
 	MyMat();
 	MyMat(int rows, int cols);
@@ -53,6 +58,17 @@ public:
 	 */
 	void saveImageToFile(std::string fileName);
 
+	/**
+	 * Ulo obrzek, ve kterm je kanl L nahrazen zadanou rovinou (CV_32FC1, 0-1).
+	 * Kanly a, b se berou z mat. Pokud je rovina men (halo zny), pouije se sted mat.
+	 */
+	void saveImageToFile(std::string fileName, const cv::Mat &lightness);
+
+	/**
+	 * Vrt kopii kanlu L (CV_32FC1, 0-1).
+	 */
+	cv::Mat getLightness(void);
+
 	/**
 	 * Nasype data z obrazov matice mat do pole flData, kter alokuje.
 	 */
@@ -0,0 +1,45 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "ProgramCache.hpp"
+#include "oclHelper.h"
+
+
+std::map<ProgramCache::Key, cl::Program> ProgramCache::programs;
+std::mutex ProgramCache::programs_mutex;
+
+
+cl::Program ProgramCache::get(cl::Context &context, cl::Device &device,
+	const std::vector<std::string> &files, const std::string &options, const std::string &header)
+{
+	std::string sources = header;
+	for (size_t i = 0; i < files.size(); i++)
+	{
+		sources += files[i] + "\n";
+	}
+
+	Key key(std::make_pair(context(), device()), sources + options);
+
+	std::lock_guard<std::mutex> lock(programs_mutex);
+
+	std::map<Key, cl::Program>::iterator it = programs.find(key);
+	if (it != programs.end())
+	{
+		return it->second;
+	}
+
+	cl::Program program = buildProgram(context, device, files, options, header);
+	programs[key] = program;
+
+	return program;
+}
+
+
+size_t ProgramCache::size(void)
+{
+	std::lock_guard<std::mutex> lock(programs_mutex);
+	return programs.size();
+}
@@ -0,0 +1,42 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Cache sestavených OpenCL programů.
+ *
+ * Klíčem je kontext, zařízení, zdrojové soubory a volby překladu (např. -D RADIUS=4),
+ * program se sestaví až při prvním požadavku a dál se používá ten samý.
+ */
+class ProgramCache
+{
+private:
+	typedef std::pair<std::pair<cl_context, cl_device_id>, std::string> Key;
+
+	static std::map<Key, cl::Program> programs;
+	static std::mutex programs_mutex;
+
+public:
+	/**
+	 * Vrátí program ze souborů files sestavený s volbami options, případně ho sestaví.
+	 * header je (generovaný) zdrojový kód vložený před soubory, je součástí klíče.
+	 */
+	static cl::Program get(cl::Context &context, cl::Device &device,
+		const std::vector<std::string> &files, const std::string &options = "", const std::string &header = "");
+
+	/**
+	 * Počet sestavených programů (pro výpis statistiky).
+	 */
+	static size_t size(void);
+};
@@ -0,0 +1,272 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "ProgressiveFilter.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+
+ProgressiveFilter::ProgressiveFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, double latency_target) :
+	context(context),
+	queue(queue),
+	grid(context, device, queue),
+	filter(context, device, queue),
+	latency_target(latency_target),
+	coarse_factor(4),
+	source_changed(false),
+	lightness_min(0.0f),
+	lightness_max(0.0f),
+	has_pending(false),
+	busy(false),
+	stop(false),
+	last_request(0)
+{
+	worker = std::thread(&ProgressiveFilter::run, this);
+}
+
+
+ProgressiveFilter::~ProgressiveFilter()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stop = true;
+	}
+	condition.notify_all();
+	worker.join();
+}
+
+
+const char *ProgressiveFilter::levelName(int level)
+{
+	switch (level)
+	{
+	case LEVEL_COARSE_GRID:
+		return "coarse grid (L)";
+	case LEVEL_GRID:
+		return "grid (L)";
+	default:
+		return "brute force";
+	}
+}
+
+
+void ProgressiveFilter::setImage(const cv::Mat &lab)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	next_source = lab.clone();
+	source_changed = true;
+}
+
+
+unsigned int ProgressiveFilter::submit(int radius, float range_param, Callback callback)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	pending.id = ++last_request;
+	pending.radius = radius;
+	pending.range_param = range_param;
+	pending.callback = callback;
+	pending.submit_time = getTime();
+	has_pending = true;
+
+	condition.notify_all();
+	return pending.id;
+}
+
+
+void ProgressiveFilter::wait(void)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	condition.wait(lock, [this] { return !has_pending && !busy; });
+}
+
+
+void ProgressiveFilter::run(void)
+{
+	for (;;)
+	{
+		Request request;
+		cv::Mat new_source;
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			busy = false;
+			condition.notify_all();
+			condition.wait(lock, [this] { return has_pending || stop; });
+
+			if (stop)
+			{
+				return;
+			}
+
+			// only the newest request is kept, older ones were dropped by submit
+			request = pending;
+			has_pending = false;
+			busy = true;
+
+			if (source_changed)
+			{
+				new_source = next_source;
+				source_changed = false;
+			}
+		}
+
+		// upload outside the lock - submit / setImage must not wait for the transfer
+		if (!new_source.empty())
+		{
+			source = new_source;
+			uploadSource();
+		}
+
+		if (!source.empty())
+		{
+			process(request);
+		}
+	}
+}
+
+
+void ProgressiveFilter::uploadSource(void)
+{
+	TRACE_SCOPE("progressive upload");
+	cl_int err_msg;
+
+	// L in 0-255, sigma_color of the grid is in the same units as for gray-scale input
+	cv::extractChannel(source, lightness, 0);
+	lightness *= 255.0;
+
+	double min_value, max_value;
+	cv::minMaxLoc(lightness, &min_value, &max_value);
+	lightness_min = (float)min_value;
+	lightness_max = (float)max_value;
+
+	const size_t plane_size = sizeof(float) * lightness.total();
+	lightness_dev = cl::Buffer(context, CL_MEM_READ_ONLY, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: progressive L");
+	lightness_dest_dev = cl::Buffer(context, CL_MEM_WRITE_ONLY, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: progressive L dest");
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(lightness_dev, CL_TRUE, 0, plane_size, lightness.ptr<float>()),
+		"clEnqueueWriteBuffer: progressive L");
+}
+
+
+cv::Mat ProgressiveFilter::runGrid(float sigma_space, float sigma_color, float sampling_factor)
+{
+	grid.enqueue(lightness_dev, lightness_dest_dev, lightness.cols, lightness.rows,
+		lightness_min, lightness_max, sigma_space, sigma_color, sigma_space * sampling_factor, sigma_color * sampling_factor);
+
+	cv::Mat filtered(lightness.size(), CV_32FC1);
+	clPrintErrorExit(queue.enqueueReadBuffer(lightness_dest_dev, CL_TRUE, 0, sizeof(float) * filtered.total(), filtered.ptr<float>()),
+		"clEnqueueReadBuffer: progressive L");
+
+	std::vector<cv::Mat> planes;
+	cv::split(source, planes);
+	planes[0] = filtered / 255.0;
+
+	cv::Mat result;
+	cv::merge(planes, result);
+	return result;
+}
+
+
+cv::Mat ProgressiveFilter::runBruteForce(const Request &request)
+{
+	cl_int err_msg;
+	const int radius = request.radius;
+
+	cv::Mat padded, padded4, result4(source.size(), CV_32FC4), result;
+	cv::copyMakeBorder(source, padded, radius, radius, radius, radius, cv::BORDER_REPLICATE);
+	cv::cvtColor(padded, padded4, cv::COLOR_BGR2BGRA);
+
+	cl::Buffer padded_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(cl_float3) * padded4.total(), padded4.ptr<float>(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: progressive source");
+	cl::Buffer dest_dev(context, CL_MEM_WRITE_ONLY, sizeof(cl_float3) * result4.total(), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: progressive dest");
+
+	// bands of rows, so that a newer request does not wait for the whole image
+	for (int y = 0; y < source.rows; y += BAND_ROWS)
+	{
+		if (isStale(request))
+		{
+			return cv::Mat();
+		}
+
+		cl::Event band_event = filter.enqueueRegion(padded_dev, dest_dev, source.cols, source.rows, radius, request.range_param,
+			0, y, source.cols, std::min((int)BAND_ROWS, source.rows - y));
+		clPrintErrorExit(band_event.wait(), "clWaitForEvents: progressive band");
+	}
+
+	clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, sizeof(cl_float3) * result4.total(), result4.ptr<float>()),
+		"clEnqueueReadBuffer: progressive dest");
+
+	cv::cvtColor(result4, result, cv::COLOR_BGRA2BGR);
+	return result;
+}
+
+
+void ProgressiveFilter::process(const Request &request)
+{
+	// grid parameters of the same filter: exp(-0.5 * d^2 / radius) -> sigma_space = sqrt(radius),
+	// exp(-d^2 * range_param) -> sigma_color = sqrt(0.5 / range_param) in L units 0-1
+	const float sigma_space = std::max(1.0f, std::sqrt((float)request.radius));
+	const float sigma_color = std::max(1.0f, 255.0f * std::sqrt(0.5f / request.range_param));
+
+	for (int level = 0; level < LEVEL_COUNT; level++)
+	{
+		if (isStale(request))
+		{
+			return;
+		}
+
+		double begin = getTime();
+		cv::Mat result;
+
+		if (level == LEVEL_COARSE_GRID)
+		{
+			// only this thread changes the factor, getCoarseFactor may read it concurrently
+			int factor = coarse_factor.load();
+			result = runGrid(sigma_space, sigma_color, (float)factor);
+
+			// keep the first level within the latency target
+			double time = getTime() - begin;
+			if (time > latency_target && factor < 32)
+			{
+				coarse_factor.store(factor * 2);
+			}
+			else if (time < latency_target / 4 && factor > 2)
+			{
+				coarse_factor.store(factor / 2);
+			}
+		}
+		else if (level == LEVEL_GRID)
+		{
+			result = runGrid(sigma_space, sigma_color, 1.0f);
+		}
+		else
+		{
+			result = runBruteForce(request);
+			if (result.empty())
+			{
+				return;
+			}
+		}
+
+		Trace::addSpan(std::string("progressive ") + levelName(level), "host", begin, getTime());
+
+		// a newer request arrived while the level was running - do not deliver stale results
+		if (isStale(request))
+		{
+			return;
+		}
+		request.callback(request.id, level, result, getTime() - request.submit_time);
+	}
+}
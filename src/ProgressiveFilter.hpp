@@ -0,0 +1,144 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Postupný (coarse-to-fine) bilaterální filtr pro interaktivní použití.
+ *
+ * Každý požadavek se počítá v úrovních: hrubá mřížka (kanál L, buňka coarse_factor-krát větší
+ * než sigma v každé ose), mřížka odpovídající parametrům (kanál L) a nakonec hrubá síla v plném rozlišení
+ * (Lab). Každá úroveň se předá callbacku. Hrubost první úrovně se přizpůsobuje tak, aby
+ * se vešla do cílové latence.
+ *
+ * Požadavky zpracovává jedno pracovní vlákno, které vlastní frontu OpenCL. Novější požadavek
+ * zruší rozpracované úrovně staršího - mezi úrovněmi a u hrubé síly i mezi pásy BAND_ROWS
+ * řádků, čekající starší požadavky se zahodí.
+ * Callback se volá z pracovního vlákna.
+ */
+class ProgressiveFilter
+{
+public:
+	enum Level
+	{
+		LEVEL_COARSE_GRID,
+		LEVEL_GRID,
+		LEVEL_BRUTE_FORCE,
+		LEVEL_COUNT
+	};
+
+	/**
+	 * Výsledek úrovně level požadavku request (Lab CV_32FC3, velikost vstupu),
+	 * latency je doba od zadání požadavku v sekundách.
+	 */
+	typedef std::function<void(unsigned int request, int level, const cv::Mat &result, double latency)> Callback;
+
+protected:
+	struct Request
+	{
+		unsigned int id;
+		int radius;
+		float range_param;
+		Callback callback;
+		double submit_time;
+	};
+
+	cl::Context context;
+	cl::CommandQueue queue;
+	BilateralGridCL grid;
+	BilateralFilterCL filter;
+
+	double latency_target;
+	std::atomic<int> coarse_factor; // upravuje pracovní vlákno, getCoarseFactor čte odkudkoli
+
+	// vstup - mění ho setImage, čte pracovní vlákno
+	cv::Mat next_source;
+	bool source_changed;
+
+	// stav pracovního vlákna
+	cv::Mat source;
+	cv::Mat lightness;
+	float lightness_min, lightness_max;
+	cl::Buffer lightness_dev, lightness_dest_dev;
+
+	std::thread worker;
+	std::mutex mutex;
+	std::condition_variable condition;
+	Request pending;
+	bool has_pending, busy, stop;
+	std::atomic<unsigned int> last_request;
+
+	// výška pásu hrubé síly - po každém pásu se kontroluje novější požadavek
+	static const int BAND_ROWS = 64;
+
+private:
+	void run(void);
+	void process(const Request &request);
+
+	bool isStale(const Request &request) const
+	{
+		return request.id != last_request;
+	}
+
+	/**
+	 * Nahraje nový vstup na zařízení (pracovní vlákno).
+	 */
+	void uploadSource(void);
+
+	/**
+	 * Mřížka na kanálu L, a/b zůstanou z původního obrázku.
+	 * Buňka mřížky je sampling_factor-krát větší než sigma (stejný filtr, hrubší mřížka).
+	 */
+	cv::Mat runGrid(float sigma_space, float sigma_color, float sampling_factor);
+
+	/**
+	 * Hrubá síla na Lab, vstup se rozšíří o radius (replikace okraje), výstup má velikost vstupu.
+	 * Počítá se po pásech řádků, pro zastaralý request vrátí prázdnou matici.
+	 */
+	cv::Mat runBruteForce(const Request &request);
+
+public:
+	/**
+	 * latency_target - cílová latence první úrovně v sekundách.
+	 */
+	ProgressiveFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, double latency_target);
+	~ProgressiveFilter();
+
+	/**
+	 * Nastaví vstupní obrázek (Lab CV_32FC3), platí pro další požadavky.
+	 */
+	void setImage(const cv::Mat &lab);
+
+	/**
+	 * Zadá požadavek a hned se vrátí. Rozpracovaný starší požadavek se zruší.
+	 * Vrátí číslo požadavku.
+	 */
+	unsigned int submit(int radius, float range_param, Callback callback);
+
+	/**
+	 * Počká, až pracovní vlákno zpracuje všechny požadavky.
+	 */
+	void wait(void);
+
+	int getCoarseFactor(void) const
+	{
+		return coarse_factor;
+	}
+
+	static const char *levelName(int level);
+};
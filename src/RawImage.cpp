@@ -0,0 +1,291 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "RawImage.hpp"
+#include "Trace.hpp"
+
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <string.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+
+RawImage::RawImage() :
+	header(NULL),
+	mapped_size(0)
+{
+#ifdef _WIN32
+	file = INVALID_HANDLE_VALUE;
+	mapping = NULL;
+#else
+	file = -1;
+#endif
+}
+
+
+RawImage::~RawImage()
+{
+	close();
+}
+
+
+bool RawImage::isRawFile(const std::string &fileName)
+{
+	return fileName.length() > 5 && fileName.compare(fileName.length() - 5, 5, ".rawf") == 0;
+}
+
+
+bool RawImage::map(const std::string &fileName, size_t size, bool writable, bool create)
+{
+	close();
+
+#ifdef _WIN32
+	file = CreateFileA(fileName.c_str(), writable ? GENERIC_READ | GENERIC_WRITE : GENERIC_READ, FILE_SHARE_READ, NULL,
+		create ? CREATE_ALWAYS : OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	if (!create)
+	{
+		LARGE_INTEGER file_size;
+		if (!GetFileSizeEx((HANDLE)file, &file_size) || (unsigned long long)file_size.QuadPart < sizeof(Header) ||
+			(unsigned long long)file_size.QuadPart > (size_t)-1)
+		{
+			close();
+			return false;
+		}
+		size = (size_t)file_size.QuadPart;
+	}
+
+	mapping = CreateFileMappingA((HANDLE)file, NULL, writable ? PAGE_READWRITE : PAGE_READONLY,
+		(DWORD)((unsigned long long)size >> 32), (DWORD)(size & 0xffffffff), NULL);
+	if (mapping == NULL)
+	{
+		close();
+		return false;
+	}
+
+	header = (Header *)MapViewOfFile((HANDLE)mapping, writable ? FILE_MAP_WRITE : FILE_MAP_READ, 0, 0, size);
+	if (header == NULL)
+	{
+		close();
+		return false;
+	}
+#else
+	file = ::open(fileName.c_str(), writable ? (O_RDWR | (create ? O_CREAT | O_TRUNC : 0)) : O_RDONLY, 0644);
+	if (file < 0)
+	{
+		return false;
+	}
+
+	if (create)
+	{
+		if (ftruncate(file, (off_t)size) != 0)
+		{
+			close();
+			return false;
+		}
+	}
+	else
+	{
+		struct stat file_stat;
+		if (fstat(file, &file_stat) != 0 || file_stat.st_size < (off_t)sizeof(Header) ||
+			(unsigned long long)file_stat.st_size > (size_t)-1)
+		{
+			close();
+			return false;
+		}
+		size = (size_t)file_stat.st_size;
+	}
+
+	void *address = mmap(NULL, size, writable ? PROT_READ | PROT_WRITE : PROT_READ, MAP_SHARED, file, 0);
+	if (address == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	header = (Header *)address;
+#endif
+
+	mapped_size = size;
+	return true;
+}
+
+
+bool RawImage::open(const std::string &fileName, bool writable)
+{
+	TRACE_SCOPE("RawImage::open");
+
+	if (!map(fileName, 0, writable, false))
+	{
+		return false;
+	}
+
+	// dimensions first - getDataSize multiplies them
+	if (mapped_size < sizeof(Header) || memcmp(header->magic, "GMUF", 4) != 0 || header->version != VERSION ||
+		(header->channels != 1 && header->channels != 3) || header->dtype > DTYPE_UINT8 || header->layout > LAYOUT_ALIGNED4 ||
+		header->width == 0 || header->width > MAX_DIMENSION || header->height == 0 || header->height > MAX_DIMENSION ||
+		header->data_offset < sizeof(Header) || header->data_offset > mapped_size || mapped_size - header->data_offset < getDataSize())
+	{
+		close();
+		return false;
+	}
+
+	return true;
+}
+
+
+bool RawImage::create(const std::string &fileName, int width, int height, int channels, DataType dtype, Layout layout)
+{
+	TRACE_SCOPE("RawImage::create");
+
+	if (width <= 0 || (uint32_t)width > MAX_DIMENSION || height <= 0 || (uint32_t)height > MAX_DIMENSION ||
+		(channels != 1 && channels != 3))
+	{
+		return false;
+	}
+
+	Header new_header;
+	memcpy(new_header.magic, "GMUF", 4);
+	new_header.version = VERSION;
+	new_header.width = width;
+	new_header.height = height;
+	new_header.channels = channels;
+	new_header.dtype = dtype;
+	new_header.layout = layout;
+	new_header.data_offset = DATA_OFFSET;
+
+	// getDataSize reads the header - compute the size before the mapping exists
+	const size_t element = (dtype == DTYPE_FLOAT32) ? sizeof(float) : 1;
+	const size_t stored_channels = (layout == LAYOUT_ALIGNED4 && channels == 3) ? 4 : channels;
+
+	if (!map(fileName, DATA_OFFSET + element * stored_channels * (size_t)width * (size_t)height, true, true))
+	{
+		return false;
+	}
+
+	*header = new_header;
+	return true;
+}
+
+
+void RawImage::flush(void)
+{
+	if (header == NULL)
+	{
+		return;
+	}
+
+#ifdef _WIN32
+	FlushViewOfFile(header, mapped_size);
+#else
+	msync(header, mapped_size, MS_SYNC);
+#endif
+}
+
+
+void RawImage::close(void)
+{
+#ifdef _WIN32
+	if (header != NULL)
+	{
+		UnmapViewOfFile(header);
+	}
+	if (mapping != NULL)
+	{
+		CloseHandle((HANDLE)mapping);
+	}
+	if (file != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle((HANDLE)file);
+	}
+	mapping = NULL;
+	file = INVALID_HANDLE_VALUE;
+#else
+	if (header != NULL)
+	{
+		munmap(header, mapped_size);
+	}
+	if (file >= 0)
+	{
+		::close(file);
+	}
+	file = -1;
+#endif
+
+	header = NULL;
+	mapped_size = 0;
+}
+
+
+size_t RawImage::getDataSize(void) const
+{
+	const size_t element = (header->dtype == DTYPE_FLOAT32) ? sizeof(float) : 1;
+	const size_t channels = (header->layout == LAYOUT_ALIGNED4 && header->channels == 3) ? 4 : header->channels;
+	return element * channels * (size_t)header->width * (size_t)header->height;
+}
+
+
+cv::Mat RawImage::getMat(void) const
+{
+	const int depth = (header->dtype == DTYPE_FLOAT32) ? CV_32F : CV_8U;
+	const int channels = (header->layout == LAYOUT_ALIGNED4 && header->channels == 3) ? 4 : header->channels;
+	return cv::Mat(header->height, header->width, CV_MAKETYPE(depth, channels), getData());
+}
+
+
+cv::Mat RawImage::toLab(void) const
+{
+	TRACE_SCOPE("RawImage::toLab");
+
+	cv::Mat data = getMat(), lab;
+	if (data.channels() == 4)
+	{
+		cv::cvtColor(data, lab, cv::COLOR_BGRA2BGR);
+	}
+	else if (data.channels() == 1)
+	{
+		// gray - L only, neutral a/b
+		const double neutral = (data.depth() == CV_32F) ? 128.0 / 255 : 128.0;
+		cv::Mat planes[3] = { data, cv::Mat(data.size(), data.type(), cv::Scalar(neutral)), cv::Mat(data.size(), data.type(), cv::Scalar(neutral)) };
+		cv::merge(planes, 3, lab);
+	}
+	else
+	{
+		lab = data.clone();
+	}
+
+	if (lab.depth() != CV_32F)
+	{
+		lab.convertTo(lab, CV_32FC3, 1.0 / 255);
+	}
+	return lab;
+}
+
+
+bool RawImage::save(const std::string &fileName, const cv::Mat &lab)
+{
+	RawImage raw;
+	if (!raw.create(fileName, lab.cols, lab.rows, 3))
+	{
+		return false;
+	}
+
+	cv::Mat data = raw.getMat();
+	cv::cvtColor(lab, data, cv::COLOR_BGR2BGRA);
+	raw.close();
+	return true;
+}
@@ -0,0 +1,123 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <stdint.h>
+#include <string>
+
+/**
+ * Surový obrázek bez komprese (přípona .rawf) mapovaný do paměti (mmap, MapViewOfFile).
+ *
+ * Soubor začíná hlavičkou (Header), data leží od data_offset (zarovnáno na 64 B). Data jsou
+ * Lab ve stejném rozsahu jako MyMat (float 0-1), řádky bez mezer. Layout LAYOUT_ALIGNED4 má
+ * kanály doplněné na 4 (stejně jako cl_float3) - data jdou na zařízení bez převodu.
+ * Zápis do mapování je pro další fázi vidět hned, flush ho zapíše na disk.
+ */
+class RawImage
+{
+public:
+	enum DataType
+	{
+		DTYPE_FLOAT32 = 0,
+		DTYPE_UINT8 = 1
+	};
+
+	enum Layout
+	{
+		LAYOUT_PACKED = 0,   // kanály za sebou (CV_32FC3)
+		LAYOUT_ALIGNED4 = 1  // kanály doplněné na 4 (cl_float3, CV_32FC4)
+	};
+
+	struct Header
+	{
+		char magic[4];       // "GMUF"
+		uint32_t version;
+		uint32_t width, height, channels;
+		uint32_t dtype, layout;
+		uint32_t data_offset;
+	};
+
+	static const uint32_t VERSION = 1;
+	static const uint32_t DATA_OFFSET = 64;
+
+	// největší šířka / výška - rozměry z hlavičky se kontrolují dřív, než se z nich počítají velikosti
+	static const uint32_t MAX_DIMENSION = 32768;
+
+protected:
+	Header *header;
+	size_t mapped_size;
+
+#ifdef _WIN32
+	void *file, *mapping; // HANDLE, windows.h jen v RawImage.cpp
+#else
+	int file;
+#endif
+
+private:
+	bool map(const std::string &fileName, size_t size, bool writable, bool create);
+
+public:
+	RawImage();
+	~RawImage();
+
+	/**
+	 * Zda má soubor příponu surového formátu.
+	 */
+	static bool isRawFile(const std::string &fileName);
+
+	/**
+	 * Namapuje existující soubor a zkontroluje hlavičku. Vrátí false při chybě.
+	 */
+	bool open(const std::string &fileName, bool writable = false);
+
+	/**
+	 * Vytvoří (přepíše) soubor pro obrázek daných rozměrů, zapíše hlavičku a namapuje ho pro zápis.
+	 * Vrátí false i pro rozměry mimo 1 až MAX_DIMENSION.
+	 */
+	bool create(const std::string &fileName, int width, int height, int channels,
+		DataType dtype = DTYPE_FLOAT32, Layout layout = LAYOUT_ALIGNED4);
+
+	/**
+	 * Zruší mapování, zapsaná data zůstanou v souboru.
+	 */
+	void close(void);
+
+	/**
+	 * Zapíše změny mapování na disk.
+	 */
+	void flush(void);
+
+	const Header &getHeader(void) const
+	{
+		return *header;
+	}
+
+	void *getData(void) const
+	{
+		return (char *)header + header->data_offset;
+	}
+
+	size_t getDataSize(void) const;
+
+	/**
+	 * Matice nad namapovanými daty (bez kopie) - CV_32FC3 / CV_32FC4 podle layoutu,
+	 * případně CV_8U. Platí do close.
+	 */
+	cv::Mat getMat(void) const;
+
+	/**
+	 * Lab CV_32FC3 (kopie), pro MyMat a jádra na hostiteli.
+	 */
+	cv::Mat toLab(void) const;
+
+	/**
+	 * Uloží Lab CV_32FC3 (float 0-1) do nového souboru s layoutem LAYOUT_ALIGNED4.
+	 */
+	static bool save(const std::string &fileName, const cv::Mat &lab);
+};
@@ -0,0 +1,248 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "Roofline.hpp"
+#include "ProgramCache.hpp"
+#include "oclHelper.h"
+
+#include <algorithm>
+#include <cmath>
+#include <sstream>
+
+
+Roofline::Peak Roofline::measurePeak(cl::Context &context, cl::Device &device, cl::CommandQueue &queue)
+{
+	const int repeats = 3;
+	const int fma_iterations = 256;
+	cl_int err_msg;
+
+	std::stringstream options;
+	options << "-D FMA_ITERATIONS=" << fma_iterations;
+	cl::Program program = ProgramCache::get(context, device, std::vector<std::string>(1, "microbenchmark.cl"), options.str());
+
+	auto microbenchmark_copy = cl::make_kernel<cl::Buffer&, cl::Buffer&>(program, "microbenchmark_copy", &err_msg);
+	clPrintErrorExit(err_msg, "microbenchmark_copy");
+	auto microbenchmark_fma = cl::make_kernel<cl::Buffer&, const cl_float&, const cl_float&>(program, "microbenchmark_fma", &err_msg);
+	clPrintErrorExit(err_msg, "microbenchmark_fma");
+
+	// 64 MB per buffer, less if the device does not allow it
+	size_t copy_size = std::min((cl_ulong)64 * 1024 * 1024, device.getInfo<CL_DEVICE_MAX_MEM_ALLOC_SIZE>() / 2);
+	size_t copy_items = copy_size / sizeof(cl_float4);
+	copy_items -= copy_items % 256;
+
+	cl::Buffer source(context, CL_MEM_READ_ONLY, copy_items * sizeof(cl_float4), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: microbenchmark source");
+	cl::Buffer destination(context, CL_MEM_WRITE_ONLY, copy_items * sizeof(cl_float4), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: microbenchmark destination");
+
+	Peak peak = { 0.0, 0.0 };
+
+	for (int i = 0; i < repeats; i++)
+	{
+		cl::Event event = microbenchmark_copy(cl::EnqueueArgs(queue, cl::NDRange(copy_items)), source, destination);
+		event.wait();
+		peak.bandwidth = std::max(peak.bandwidth, 2.0 * copy_items * sizeof(cl_float4) / getEventTime(event));
+	}
+
+	size_t fma_items = (size_t)device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>() * 16384;
+	fma_items = std::min(fma_items, copy_items);
+	fma_items -= fma_items % 256;
+
+	for (int i = 0; i < repeats; i++)
+	{
+		cl::Event event = microbenchmark_fma(cl::EnqueueArgs(queue, cl::NDRange(fma_items)), destination, 0.999f, 0.001f);
+		event.wait();
+		peak.flops = std::max(peak.flops, 64.0 * fma_iterations * fma_items / getEventTime(event));
+	}
+
+	return peak;
+}
+
+
+Roofline::Cost Roofline::basicCost(int dst_width, int dst_height, int radius, bool specialised)
+{
+	const double pixels = (double)dst_width * dst_height;
+	const double source_pixels = (double)(dst_width + 2 * radius) * (dst_height + 2 * radius);
+	const double taps = (double)(2 * radius + 1) * (2 * radius + 1);
+
+	// spatial weight: 2 mul, add, mul, div, exp (folded away in the RADIUS variant)
+	// range weight: 3 sub, 3 mul, 2 add, mul, exp; total weight: mul; sum: 3 mad; normalisation: add
+	const double tap_flops = (specialised ? 0.0 : 6.0) + 10.0 + 1.0 + 6.0 + 1.0;
+
+	Cost cost;
+	cost.bytes = (source_pixels + pixels) * sizeof(cl_float3);
+	cost.flops = pixels * (taps * tap_flops + 3.0);
+	return cost;
+}
+
+
+Roofline::Cost Roofline::guidedCost(const std::string &kernel, int width, int height, size_t scan_local_size)
+{
+	const double pixels = (double)width * height;
+	const double plane = sizeof(cl_float4);
+	Cost cost = { 0.0, 0.0 };
+
+	if (kernel == "guidedFilter_prepare")
+	{
+		cost.bytes = pixels * (sizeof(cl_float3) + 2 * plane);
+		cost.flops = pixels * 3.0;
+	}
+	else if (kernel == "guidedFilter_scanRows")
+	{
+		// Hillis-Steele: log2(local size) float4 additions plus the carried chunk total
+		cost.bytes = pixels * 2 * plane;
+		cost.flops = pixels * 4.0 * (std::log((double)scan_local_size) / std::log(2.0) + 1.0);
+	}
+	else if (kernel == "guidedFilter_boxColumns")
+	{
+		// every prefix row is read twice (entering and leaving the window)
+		cost.bytes = pixels * 3 * plane;
+		cost.flops = pixels * 16.0;
+	}
+	else if (kernel == "guidedFilter_coefficients")
+	{
+		cost.bytes = pixels * 4 * plane;
+		cost.flops = pixels * 30.0;
+	}
+	else if (kernel == "guidedFilter_output")
+	{
+		cost.bytes = pixels * (2 * sizeof(cl_float3) + 2 * plane);
+		cost.flops = pixels * 9.0;
+	}
+
+	return cost;
+}
+
+
+Roofline::Cost Roofline::gridCost(int width, int height, int small_height, int small_width, int small_depth)
+{
+	const double pixels = (double)width * height;
+	const double cells = (double)small_height * small_width * small_depth;
+	const double cell = 2 * sizeof(float);
+
+	Cost cost;
+	// splat: source read, cell read-modify-write; blur: 6 passes of 3 reads and a write;
+	// normalisation: cell read and write; slice: source read, 8 cells, output write
+	cost.bytes =
+		pixels * (sizeof(float) + 2 * cell) +
+		6 * cells * 4 * cell +
+		cells * 2 * cell +
+		pixels * (2 * sizeof(float) + 8 * cell);
+	cost.flops =
+		pixels * 3.0 +
+		6 * cells * 2 * 4.0 +
+		cells +
+		pixels * 30.0;
+	return cost;
+}
+
+
+Roofline::Cost Roofline::gridKernelCost(const std::string &kernel, int width, int height, int small_height, int small_width, int small_depth)
+{
+	const double pixels = (double)width * height;
+	const double cells = (double)small_height * small_width * small_depth;
+	const double cell = 2 * sizeof(float);
+	Cost cost = { 0.0, 0.0 };
+
+	if (kernel == "fill grid")
+	{
+		cost.bytes = cells * cell;
+	}
+	else if (kernel == "bilateralGrid_splat")
+	{
+		// source read, two atomic read-modify-writes of the cell
+		cost.bytes = pixels * (sizeof(float) + 2 * cell);
+		cost.flops = pixels * 8.0;
+	}
+	else if (kernel == "bilateralGrid_splatLocal")
+	{
+		// source read, at most one flush of every cell
+		cost.bytes = pixels * sizeof(float) + cells * 2 * cell;
+		cost.flops = pixels * 8.0;
+	}
+	else if (kernel == "bilateralGrid_cellKeys" || kernel == "bilateralGrid_bitonicStep")
+	{
+		double keys = 1.0;
+		while (keys < pixels)
+		{
+			keys *= 2.0;
+		}
+		// cellKeys: source read, key write; bitonic step: every key read and written
+		cost.bytes = (kernel == "bilateralGrid_cellKeys") ? pixels * sizeof(float) + keys * sizeof(cl_ulong) : keys * 2 * sizeof(cl_ulong);
+		cost.flops = (kernel == "bilateralGrid_cellKeys") ? pixels * 8.0 : 0.0;
+	}
+	else if (kernel == "bilateralGrid_reduceSorted")
+	{
+		// keys read twice (run boundary), source gathered, non-empty cells written
+		cost.bytes = pixels * (2 * sizeof(cl_ulong) + sizeof(float)) + cells * cell;
+		cost.flops = pixels * 2.0;
+	}
+	else if (kernel == "bilateralGrid_blurDepth" || kernel == "bilateralGrid_blurStrided")
+	{
+		// both passes in local memory, every cell read and written once
+		cost.bytes = cells * 2 * cell;
+		cost.flops = cells * 2 * 2 * 4.0;
+	}
+	else if (kernel == "bilateralGrid_blurWide")
+	{
+		// the taps of neighbouring work-items hit the cache, flops for the 5-tap kernel
+		cost.bytes = cells * 2 * cell;
+		cost.flops = cells * 2 * 5 * 2.0;
+	}
+	else if (kernel == "bilateralGrid_normalise" || kernel == "bilateralGrid_normaliseImage" || kernel == "copy grid to image")
+	{
+		cost.bytes = cells * 2 * cell;
+		cost.flops = (kernel == "copy grid to image") ? 0.0 : cells;
+	}
+	else if (kernel == "bilateralGrid_sliceImage")
+	{
+		// one filtered fetch, the texture cache serves the neighbouring texels
+		cost.bytes = pixels * (2 * sizeof(float) + cell);
+		cost.flops = pixels * 8.0;
+	}
+	else if (kernel == "bilateralGrid_slice")
+	{
+		cost.bytes = pixels * (2 * sizeof(float) + 8 * cell);
+		cost.flops = pixels * 30.0;
+	}
+	return cost;
+}
+
+
+void Roofline::add(const std::string &name, const cl::Event &event, const Cost &cost)
+{
+	Launch launch = { name, event, cost };
+	launches.push_back(launch);
+}
+
+
+void Roofline::print(const Peak &peak) const
+{
+	const double ridge = peak.flops / peak.bandwidth;
+
+	printf("Roofline: peak %.1f GB/s, %.1f GFLOP/s, ridge %.2f FLOP/B\n",
+		peak.bandwidth * 1e-9, peak.flops * 1e-9, ridge);
+	printf(" %-28s %10s %10s %10s %8s %8s %7s\n", "kernel", "time[ms]", "GB/s", "GFLOP/s", "FLOP/B", "bound", "%roof");
+
+	for (size_t i = 0; i < launches.size(); i++)
+	{
+		const Launch &launch = launches[i];
+		cl::Event event = launch.event;
+		double time = getEventTime(event);
+		double intensity = launch.cost.flops / launch.cost.bytes;
+		double roof = std::min(peak.flops, intensity * peak.bandwidth);
+		double achieved = launch.cost.flops / time;
+
+		printf(" %-28s %10.3f %10.2f %10.2f %8.2f %8s %6.1f%%\n",
+			launch.name.c_str(),
+			time * 1000,
+			launch.cost.bytes / time * 1e-9,
+			achieved * 1e-9,
+			intensity,
+			intensity < ridge ? "memory" : "compute",
+			100.0 * achieved / roof);
+	}
+}
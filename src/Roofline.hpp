@@ -0,0 +1,85 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <string>
+#include <vector>
+
+/**
+ * Roofline report - dosažená propustnost paměti a výpočetní výkon jednotlivých kernelů.
+ *
+ * Přenesené bajty a počet operací se počítají analyticky z parametrů spuštění
+ * (radius, velikost obrazu, rozměry mřížky), doba běhu z profilovacích událostí.
+ * Špičky zařízení se změří mikrobenchmarky (microbenchmark.cl).
+ *
+ * Bajty jsou nutné přenosy z/do globální paměti za předpokladu, že sousední
+ * pracovní položky sdílejí data přes cache. Transcendentní funkce (exp) se počítají
+ * jako jedna operace.
+ */
+class Roofline
+{
+public:
+	struct Cost
+	{
+		double bytes;
+		double flops;
+	};
+
+	struct Peak
+	{
+		double bandwidth; // B/s
+		double flops;     // FLOP/s
+	};
+
+private:
+	struct Launch
+	{
+		std::string name;
+		cl::Event event;
+		Cost cost;
+	};
+
+	std::vector<Launch> launches;
+
+public:
+	/**
+	 * Změří špičkovou propustnost (kopie float4) a výkon (řetězce mad) zařízení.
+	 */
+	static Peak measurePeak(cl::Context &context, cl::Device &device, cl::CommandQueue &queue);
+
+	/**
+	 * bilateralFilter_basic / bilateralFilter_radius, výstup dst_width x dst_height.
+	 */
+	static Cost basicCost(int dst_width, int dst_height, int radius, bool specialised);
+
+	/**
+	 * Kernely guidedFilter.cl podle názvu, obraz width x height.
+	 */
+	static Cost guidedCost(const std::string &kernel, int width, int height, size_t scan_local_size);
+
+	/**
+	 * bilateralFilter_optimized - mřížka small_height x small_width x small_depth (splat, 6 průchodů rozmazání, slice).
+	 */
+	static Cost gridCost(int width, int height, int small_height, int small_width, int small_depth);
+
+	/**
+	 * Kernely bilateralGrid.cl podle názvu, obraz width x height, mřížka small_height x small_width x small_depth.
+	 */
+	static Cost gridKernelCost(const std::string &kernel, int width, int height, int small_height, int small_width, int small_depth);
+
+	/**
+	 * Přidá spuštění kernelu do reportu (událost musí pocházet z fronty s profilováním).
+	 */
+	void add(const std::string &name, const cl::Event &event, const Cost &cost);
+
+	/**
+	 * Vypíše report (fronta už musí být dokončená).
+	 */
+	void print(const Peak &peak) const;
+};
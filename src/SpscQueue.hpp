@@ -0,0 +1,173 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+/**
+ * Omezená fronta bez zámků pro jednoho producenta a jednoho konzumenta (kruhový buffer).
+ *
+ * push čeká, dokud je fronta plná - zpětný tlak omezuje počet rozpracovaných položek.
+ * pop čeká, dokud je prázdná. Čekání nejdřív SPIN_YIELDS-krát předá procesor (yield),
+ * potom spí po SLEEP_MICROSECONDS, aby dlouhé čekání (např. na disk) nevytěžovalo jádro. Doby čekání a průměrná obsazenost
+ * fronty se sčítají pro výpis statistiky (push volá jen producent, pop jen konzument).
+ */
+template <typename T>
+class SpscQueue
+{
+protected:
+	std::vector<T> items;
+	std::atomic<size_t> head; // další pop, mění jen konzument
+	std::atomic<size_t> tail; // další push, mění jen producent
+
+	// statistika producenta
+	double push_stall;
+	double occupancy_sum;
+	size_t pushes;
+
+	// statistika konzumenta
+	double pop_stall;
+
+	static const int SPIN_YIELDS = 64;
+	static const int SLEEP_MICROSECONDS = 100;
+
+private:
+	static void backOff(int &spins)
+	{
+		if (spins < SPIN_YIELDS)
+		{
+			spins++;
+			std::this_thread::yield();
+		}
+		else
+		{
+			std::this_thread::sleep_for(std::chrono::microseconds((int)SLEEP_MICROSECONDS));
+		}
+	}
+
+	static double elapsed(std::chrono::steady_clock::time_point start)
+	{
+		return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+
+public:
+	explicit SpscQueue(size_t capacity) :
+		items(capacity + 1),
+		head(0),
+		tail(0),
+		push_stall(0.0),
+		occupancy_sum(0.0),
+		pushes(0),
+		pop_stall(0.0)
+	{
+	}
+
+	bool tryPush(const T &item)
+	{
+		const size_t current = tail.load(std::memory_order_relaxed);
+		const size_t next = (current + 1) % items.size();
+
+		if (next == head.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		items[current] = item;
+		tail.store(next, std::memory_order_release);
+		return true;
+	}
+
+	bool tryPop(T &item)
+	{
+		const size_t current = head.load(std::memory_order_relaxed);
+
+		if (current == tail.load(std::memory_order_acquire))
+		{
+			return false;
+		}
+
+		item = items[current];
+		items[current] = T(); // uvolní data položky hned, ne až při přepsání
+		head.store((current + 1) % items.size(), std::memory_order_release);
+		return true;
+	}
+
+	void push(const T &item)
+	{
+		occupancy_sum += size();
+		pushes++;
+
+		if (!tryPush(item))
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int spins = 0;
+			while (!tryPush(item))
+			{
+				backOff(spins);
+			}
+			push_stall += elapsed(start);
+		}
+	}
+
+	T pop(void)
+	{
+		T item;
+		if (!tryPop(item))
+		{
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			int spins = 0;
+			while (!tryPop(item))
+			{
+				backOff(spins);
+			}
+			pop_stall += elapsed(start);
+		}
+		return item;
+	}
+
+	/**
+	 * Počet položek ve frontě (z pohledu volajícího vlákna jen přibližný).
+	 */
+	size_t size(void) const
+	{
+		const size_t current_head = head.load(std::memory_order_acquire);
+		const size_t current_tail = tail.load(std::memory_order_acquire);
+		return (current_tail + items.size() - current_head) % items.size();
+	}
+
+	size_t capacity(void) const
+	{
+		return items.size() - 1;
+	}
+
+	/**
+	 * Doba, po kterou producent čekal na místo (zpětný tlak), v sekundách.
+	 */
+	double getPushStall(void) const
+	{
+		return push_stall;
+	}
+
+	/**
+	 * Doba, po kterou konzument čekal na položku, v sekundách.
+	 */
+	double getPopStall(void) const
+	{
+		return pop_stall;
+	}
+
+	/**
+	 * Průměrná obsazenost fronty při push.
+	 */
+	double getAverageOccupancy(void) const
+	{
+		return pushes > 0 ? occupancy_sum / pushes : 0.0;
+	}
+};
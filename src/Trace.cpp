@@ -0,0 +1,206 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "Trace.hpp"
+#include "oclHelper.h"
+
+#include <algorithm>
+
+
+bool Trace::enabled = false;
+std::string Trace::file_name;
+double Trace::time_origin = 0.0;
+std::vector<Trace::HostSpan> Trace::host_spans;
+std::vector<Trace::DeviceCommand> Trace::device_commands;
+std::map<std::thread::id, int> Trace::threads;
+std::mutex Trace::trace_mutex;
+
+
+static std::string jsonEscape(const std::string &text)
+{
+	std::string escaped;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '"' || text[i] == '\\')
+		{
+			escaped += '\\';
+		}
+		escaped += text[i];
+	}
+	return escaped;
+}
+
+
+void Trace::enable(const std::string &fileName)
+{
+	std::lock_guard<std::mutex> lock(trace_mutex);
+
+	file_name = fileName;
+	time_origin = getTime();
+	enabled = true;
+}
+
+
+int Trace::threadIndex(void)
+{
+	std::map<std::thread::id, int>::iterator it = threads.find(std::this_thread::get_id());
+	if (it != threads.end())
+	{
+		return it->second;
+	}
+
+	int index = (int)threads.size() + 1;
+	threads[std::this_thread::get_id()] = index;
+	return index;
+}
+
+
+void Trace::addSpan(const std::string &name, const char *category, double begin, double end)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(trace_mutex);
+
+	HostSpan span = { name, category, begin, end, threadIndex() };
+	host_spans.push_back(span);
+}
+
+
+void Trace::addEvent(const std::string &name, const cl::Event &event, const std::string &track)
+{
+	if (!enabled)
+	{
+		return;
+	}
+
+	double now = getTime();
+	std::lock_guard<std::mutex> lock(trace_mutex);
+
+	DeviceCommand command = { name, track, event, now };
+	device_commands.push_back(command);
+}
+
+
+bool Trace::write(void)
+{
+	if (!enabled)
+	{
+		return true;
+	}
+
+	std::lock_guard<std::mutex> lock(trace_mutex);
+
+	FILE *file = fopen(file_name.c_str(), "w");
+	if (file == NULL)
+	{
+		return false;
+	}
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"host\"}}");
+
+	for (size_t i = 0; i < host_spans.size(); i++)
+	{
+		const HostSpan &span = host_spans[i];
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+			jsonEscape(span.name).c_str(), span.category, span.thread,
+			(span.begin - time_origin) * 1e6, (span.end - span.begin) * 1e6);
+	}
+
+	// Device timestamps use the device clock. Every track is shifted so that its commands
+	// are queued no earlier than the host recorded them (queued is taken inside the enqueue call).
+	std::vector<std::string> tracks;
+	std::map<std::string, cl_ulong> track_base;
+	std::map<std::string, double> track_offset;
+	std::vector<cl_ulong> times(4 * device_commands.size(), 0);
+	std::vector<bool> valid(device_commands.size(), false);
+
+	for (size_t i = 0; i < device_commands.size(); i++)
+	{
+		const DeviceCommand &command = device_commands[i];
+		cl_event event = command.event();
+		valid[i] =
+			clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_QUEUED, sizeof(cl_ulong), &times[4 * i + 0], NULL) == CL_SUCCESS &&
+			clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_SUBMIT, sizeof(cl_ulong), &times[4 * i + 1], NULL) == CL_SUCCESS &&
+			clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_START, sizeof(cl_ulong), &times[4 * i + 2], NULL) == CL_SUCCESS &&
+			clGetEventProfilingInfo(event, CL_PROFILING_COMMAND_END, sizeof(cl_ulong), &times[4 * i + 3], NULL) == CL_SUCCESS;
+		if (!valid[i])
+		{
+			continue;
+		}
+
+		if (track_base.find(command.track) == track_base.end())
+		{
+			tracks.push_back(command.track);
+			track_base[command.track] = times[4 * i];
+			track_offset[command.track] = command.host_time - time_origin;
+		}
+
+		double queued = (double)(times[4 * i] - track_base[command.track]) * 1e-9;
+		track_offset[command.track] = std::min(track_offset[command.track], command.host_time - time_origin - queued);
+	}
+
+	for (size_t t = 0; t < tracks.size(); t++)
+	{
+		fprintf(file, ",\n{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"%s\"}}",
+			(int)t + 2, jsonEscape(tracks[t]).c_str());
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":1,\"args\":{\"name\":\"waiting (queued - start)\"}}", (int)t + 2);
+		fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":2,\"args\":{\"name\":\"execution (start - end)\"}}", (int)t + 2);
+	}
+
+	for (size_t i = 0; i < device_commands.size(); i++)
+	{
+		if (!valid[i])
+		{
+			continue;
+		}
+
+		const DeviceCommand &command = device_commands[i];
+		int pid = (int)(std::find(tracks.begin(), tracks.end(), command.track) - tracks.begin()) + 2;
+		cl_ulong base = track_base[command.track];
+		double offset = track_offset[command.track];
+		double queued = offset + (double)(times[4 * i + 0] - base) * 1e-9;
+		double submit = offset + (double)(times[4 * i + 1] - base) * 1e-9;
+		double start = offset + (double)(times[4 * i + 2] - base) * 1e-9;
+		double end = offset + (double)(times[4 * i + 3] - base) * 1e-9;
+		std::string name = jsonEscape(command.name);
+
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"queue\",\"ph\":\"X\",\"pid\":%d,\"tid\":1,\"ts\":%.3f,\"dur\":%.3f,"
+			"\"args\":{\"queued_to_submit_us\":%.3f,\"submit_to_start_us\":%.3f}}",
+			name.c_str(), pid, queued * 1e6, (start - queued) * 1e6, (submit - queued) * 1e6, (start - submit) * 1e6);
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"device\",\"ph\":\"X\",\"pid\":%d,\"tid\":2,\"ts\":%.3f,\"dur\":%.3f}",
+			name.c_str(), pid, start * 1e6, (end - start) * 1e6);
+	}
+
+	fprintf(file, "\n]}\n");
+	fclose(file);
+
+	return true;
+}
+
+
+ScopedTimer::ScopedTimer(const std::string &name, const char *category) :
+	category(category),
+	begin(0.0)
+{
+	if (Trace::isEnabled())
+	{
+		this->name = name;
+		begin = getTime();
+	}
+}
+
+
+ScopedTimer::~ScopedTimer()
+{
+	if (Trace::isEnabled())
+	{
+		Trace::addSpan(name, category, begin, getTime());
+	}
+}
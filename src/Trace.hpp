@@ -0,0 +1,99 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/**
+ * Záznam průběhu programu ve formátu Chrome trace_event (chrome://tracing, Perfetto).
+ *
+ * Hostitelské úseky se měří přes ScopedTimer, příkazy ve frontě OpenCL se zaznamenají
+ * přes addEvent hned po zařazení a jejich časy (queued/submit/start/end) se přečtou
+ * až při zápisu souboru. Dokud se záznam nezapne, nic se neukládá.
+ */
+class Trace
+{
+private:
+	struct HostSpan
+	{
+		std::string name;
+		const char *category;
+		double begin, end;
+		int thread;
+	};
+
+	struct DeviceCommand
+	{
+		std::string name;
+		std::string track;
+		cl::Event event;
+		double host_time;
+	};
+
+	static bool enabled;
+	static std::string file_name;
+	static double time_origin;
+	static std::vector<HostSpan> host_spans;
+	static std::vector<DeviceCommand> device_commands;
+	static std::map<std::thread::id, int> threads;
+	static std::mutex trace_mutex;
+
+	static int threadIndex(void);
+
+public:
+	/**
+	 * Zapne záznam, write() ho uloží do souboru fileName.
+	 */
+	static void enable(const std::string &fileName);
+
+	static bool isEnabled(void)
+	{
+		return enabled;
+	}
+
+	/**
+	 * Hostitelský úsek, časy z getTime() v sekundách.
+	 */
+	static void addSpan(const std::string &name, const char *category, double begin, double end);
+
+	/**
+	 * Příkaz zařazený do fronty s profilováním. Volá se hned po zařazení,
+	 * track je název časové osy (typicky zařízení nebo fronta).
+	 */
+	static void addEvent(const std::string &name, const cl::Event &event, const std::string &track = "OpenCL");
+
+	/**
+	 * Zapíše záznam (fronty už musí být dokončené). Vrátí false, pokud se soubor nepodařilo zapsat.
+	 */
+	static bool write(void);
+};
+
+
+/**
+ * Změří dobu od konstrukce do destrukce a uloží ji jako hostitelský úsek.
+ */
+class ScopedTimer
+{
+private:
+	std::string name;
+	const char *category;
+	double begin;
+
+public:
+	ScopedTimer(const std::string &name, const char *category = "host");
+	~ScopedTimer();
+};
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b) TRACE_CONCAT_(a, b)
+#define TRACE_SCOPE(name) ScopedTimer TRACE_CONCAT(trace_scope_, __LINE__)(name)
@@ -0,0 +1,362 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "VideoFilter.hpp"
+#include "oclHelper.h"
+#include "Trace.hpp"
+
+#include <opencv2/highgui/highgui.hpp>
+#include <opencv2/imgproc/imgproc.hpp>
+
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#ifdef _WIN32
+#include <fcntl.h>
+#include <io.h>
+#else
+#include <unistd.h>
+#endif
+
+
+/**
+ * Omezená fronta snímků mezi vlákny. Plná fronta zdrží producenta, prázdný snímek značí konec.
+ */
+class FrameQueue
+{
+	std::deque<cv::Mat> frames;
+	std::mutex mutex;
+	std::condition_variable not_empty, not_full;
+	size_t capacity;
+
+public:
+	explicit FrameQueue(size_t capacity) : capacity(capacity)
+	{
+	}
+
+	void push(const cv::Mat &frame)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_full.wait(lock, [this] { return frames.size() < capacity; });
+		frames.push_back(frame);
+		not_empty.notify_one();
+	}
+
+	cv::Mat pop(void)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		not_empty.wait(lock, [this] { return !frames.empty(); });
+		cv::Mat frame = frames.front();
+		frames.pop_front();
+		not_full.notify_one();
+		return frame;
+	}
+};
+
+
+// snímky rozpracované mezi dvěma fázemi
+static const size_t QUEUE_DEPTH = 4;
+
+FILE *VideoFilter::raw_stdout = NULL;
+
+
+VideoFilter::VideoFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	bool grid_engine, int param_space, float param_range, float static_threshold) :
+	context(context),
+	queue(queue),
+	filter(context, device, queue),
+	grid(context, device, queue),
+	grid_engine(grid_engine),
+	param_space(param_space),
+	param_range(param_range),
+	static_threshold(static_threshold),
+	width(0),
+	height(0),
+	frames(0),
+	full_splats(0),
+	dirty_tiles(0.0),
+	total_tiles(0.0),
+	decode_time(0.0),
+	filter_time(0.0),
+	encode_time(0.0),
+	total_time(0.0)
+{
+}
+
+
+void VideoFilter::reserveStdout(void)
+{
+	fflush(stdout);
+#ifdef _WIN32
+	int fd = _dup(_fileno(stdout));
+	_dup2(_fileno(stderr), _fileno(stdout));
+	_setmode(fd, _O_BINARY);
+	raw_stdout = _fdopen(fd, "wb");
+#else
+	int fd = dup(fileno(stdout));
+	dup2(fileno(stderr), fileno(stdout));
+	raw_stdout = fdopen(fd, "wb");
+#endif
+}
+
+
+void VideoFilter::allocate(int width, int height)
+{
+	cl_int err_msg;
+	this->width = width;
+	this->height = height;
+
+	size_t source_size, dest_size;
+	if (grid_engine)
+	{
+		source_size = dest_size = sizeof(float) * width * height;
+	}
+	else
+	{
+		source_size = sizeof(cl_float3) * (width + 2 * param_space) * (height + 2 * param_space);
+		dest_size = sizeof(cl_float3) * width * height;
+	}
+
+	source_dev = cl::Buffer(context, CL_MEM_READ_ONLY, source_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: video source");
+	dest_dev = cl::Buffer(context, CL_MEM_WRITE_ONLY, dest_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: video dest");
+}
+
+
+
+cv::Mat VideoFilter::filterBruteForce(const cv::Mat &lab)
+{
+	cv::Mat padded, padded4, result4(lab.size(), CV_32FC4), result;
+	cv::copyMakeBorder(lab, padded, param_space, param_space, param_space, param_space, cv::BORDER_REPLICATE);
+	cv::cvtColor(padded, padded4, cv::COLOR_BGR2BGRA);
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(source_dev, CL_FALSE, 0, sizeof(cl_float3) * padded4.total(), padded4.ptr<float>()),
+		"clEnqueueWriteBuffer: video source");
+	filter.enqueue(source_dev, dest_dev, width, height, param_space, param_range);
+	clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, sizeof(cl_float3) * result4.total(), result4.ptr<float>()),
+		"clEnqueueReadBuffer: video dest");
+
+	cv::cvtColor(result4, result, cv::COLOR_BGRA2BGR);
+	return result;
+}
+
+
+cv::Mat VideoFilter::filterGrid(const cv::Mat &lab)
+{
+	std::vector<cv::Mat> planes;
+	cv::split(lab, planes);
+	cv::Mat lightness = planes[0] * 255.0;
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(source_dev, CL_FALSE, 0, sizeof(float) * lightness.total(), lightness.ptr<float>()),
+		"clEnqueueWriteBuffer: video L");
+
+	// fixed range 0-255, the grid has the same size in every frame
+	if (static_threshold < 0.0f)
+	{
+		grid.enqueue(source_dev, dest_dev, width, height, 0.0f, 255.0f, (float)param_space, param_range);
+	}
+	else
+	{
+		const int tile = BilateralGridCL::TEMPORAL_TILE;
+		const int tiles_x = (width + tile - 1) / tile, tiles_y = (height + tile - 1) / tile;
+		bool reset = splatted.empty() || frames % KEYFRAME_INTERVAL == 0;
+		std::vector<cl_int2> tiles;
+
+		if (!reset)
+		{
+			for (int ty = 0; ty < tiles_y; ty++)
+			{
+				for (int tx = 0; tx < tiles_x; tx++)
+				{
+					cv::Rect rect(tx * tile, ty * tile, std::min(tile, width - tx * tile), std::min(tile, height - ty * tile));
+					if (cv::norm(lightness(rect), splatted(rect), cv::NORM_INF) > static_threshold)
+					{
+						cl_int2 position;
+						position.s[0] = tx;
+						position.s[1] = ty;
+						tiles.push_back(position);
+						lightness(rect).copyTo(splatted(rect));
+					}
+				}
+			}
+
+			dirty_tiles += (double)tiles.size();
+			total_tiles += (double)tiles_x * tiles_y;
+
+			// most of the frame changed - the full splat is cheaper than the delta
+			reset = tiles.size() * 2 > (size_t)(tiles_x * tiles_y);
+		}
+
+		if (reset)
+		{
+			splatted = lightness.clone();
+			full_splats++;
+		}
+
+		grid.enqueueTemporal(source_dev, dest_dev, width, height, 0.0f, 255.0f, (float)param_space, param_range, tiles, reset);
+	}
+
+	cv::Mat filtered(lightness.size(), CV_32FC1);
+	clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, sizeof(float) * filtered.total(), filtered.ptr<float>()),
+		"clEnqueueReadBuffer: video L");
+
+	planes[0] = filtered / 255.0;
+
+	cv::Mat result;
+	cv::merge(planes, result);
+	return result;
+}
+
+
+cv::Mat VideoFilter::filterFrame(const cv::Mat &lab)
+{
+	TRACE_SCOPE("filter frame");
+	cv::Mat result = grid_engine ? filterGrid(lab) : filterBruteForce(lab);
+	frames++;
+	return result;
+}
+
+
+int VideoFilter::run(const std::string &input, const std::string &output, int raw_width, int raw_height)
+{
+	cv::VideoCapture capture;
+	double fps = 25.0;
+	int frame_width, frame_height;
+
+	if (input == "-")
+	{
+#ifdef _WIN32
+		_setmode(_fileno(stdin), _O_BINARY);
+#endif
+		frame_width = raw_width;
+		frame_height = raw_height;
+	}
+	else
+	{
+		if (!capture.open(input))
+		{
+			std::cerr << "Input video could not be opened." << std::endl;
+			return 0;
+		}
+		frame_width = (int)capture.get(CV_CAP_PROP_FRAME_WIDTH);
+		frame_height = (int)capture.get(CV_CAP_PROP_FRAME_HEIGHT);
+		if (capture.get(CV_CAP_PROP_FPS) > 0.0)
+		{
+			fps = capture.get(CV_CAP_PROP_FPS);
+		}
+	}
+
+	FILE *raw_output = NULL;
+	cv::VideoWriter writer;
+	if (output == "-")
+	{
+		raw_output = raw_stdout ? raw_stdout : stdout;
+	}
+	else if (!writer.open(output, CV_FOURCC('M', 'J', 'P', 'G'), fps, cv::Size(frame_width, frame_height)))
+	{
+		std::cerr << "Output video could not be opened." << std::endl;
+		return 0;
+	}
+
+	allocate(frame_width, frame_height);
+
+	FrameQueue decoded(QUEUE_DEPTH), filtered(QUEUE_DEPTH);
+	double begin = getTime();
+
+	std::thread decoder([&]
+	{
+		for (;;)
+		{
+			double start = getTime();
+			cv::Mat bgr, lab_uint8, lab;
+			{
+				TRACE_SCOPE("decode frame");
+				if (input == "-")
+				{
+					bgr.create(frame_height, frame_width, CV_8UC3);
+					if (fread(bgr.data, bgr.elemSize(), bgr.total(), stdin) != bgr.total())
+					{
+						break;
+					}
+				}
+				else if (!capture.read(bgr) || bgr.empty())
+				{
+					break;
+				}
+				cv::cvtColor(bgr, lab_uint8, cv::COLOR_BGR2Lab);
+				lab_uint8.convertTo(lab, CV_32FC3, 1.0 / 255);
+			}
+			decode_time += getTime() - start;
+			decoded.push(lab);
+		}
+		decoded.push(cv::Mat());
+	});
+
+	std::thread encoder([&]
+	{
+		for (cv::Mat lab = filtered.pop(); !lab.empty(); lab = filtered.pop())
+		{
+			double start = getTime();
+			{
+				TRACE_SCOPE("encode frame");
+				cv::Mat lab_uint8, bgr;
+				lab.convertTo(lab_uint8, CV_8UC3, 255.0);
+				cv::cvtColor(lab_uint8, bgr, cv::COLOR_Lab2BGR);
+
+				if (raw_output)
+				{
+					fwrite(bgr.data, bgr.elemSize(), bgr.total(), raw_output);
+				}
+				else
+				{
+					writer.write(bgr);
+				}
+			}
+			encode_time += getTime() - start;
+		}
+
+		if (raw_output)
+		{
+			fflush(raw_output);
+		}
+	});
+
+	for (cv::Mat lab = decoded.pop(); !lab.empty(); lab = decoded.pop())
+	{
+		double start = getTime();
+		cv::Mat result = filterFrame(lab);
+		filter_time += getTime() - start;
+		filtered.push(result);
+	}
+	filtered.push(cv::Mat());
+
+	decoder.join();
+	encoder.join();
+	total_time = getTime() - begin;
+
+	return frames;
+}
+
+
+void VideoFilter::printStats(void)
+{
+	printf("\nVideo: %d frames %dx%d, %.3fs, %.1f fps\n", frames, width, height, total_time, frames / std::max(total_time, 1e-9));
+	printf("Stage busy: decode %.1f%%, filter %.1f%%, encode %.1f%%\n",
+		100.0 * decode_time / std::max(total_time, 1e-9),
+		100.0 * filter_time / std::max(total_time, 1e-9),
+		100.0 * encode_time / std::max(total_time, 1e-9));
+
+	if (grid_engine && static_threshold >= 0.0f)
+	{
+		printf("Temporal grid: %d full splats, %.1f%% tiles re-splatted in the other frames\n",
+			full_splats, total_tiles > 0.0 ? 100.0 * dirty_tiles / total_tiles : 0.0);
+	}
+}
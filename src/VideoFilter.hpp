@@ -0,0 +1,96 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <CL/cl.hpp>
+#include <opencv2/core/core.hpp>
+
+#include <stdio.h>
+#include <string>
+
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+
+/**
+ * Filtrování videa snímek po snímku.
+ *
+ * Snímky se čtou přes cv::VideoCapture nebo jako surové BGR24 ze stdin a zapisují přes
+ * cv::VideoWriter nebo jako surové BGR24 na stdout. Dekódování, filtr a kódování běží
+ * ve třech vláknech spojených omezenými frontami, stav na zařízení (program, buffery,
+ * mřížka) zůstává mezi snímky.
+ *
+ * Jádro basic filtruje Lab hrubou silou (vstup rozšířený o radius, výstup má velikost snímku),
+ * jádro grid kanál L bilaterální mřížkou (rozsah 0-255), a/b zůstanou původní.
+ * S časovým režimem (static_threshold >= 0) mřížka zůstává z předchozího snímku a znovu se
+ * splatují jen dlaždice, ve kterých se L změnilo o více než static_threshold.
+ */
+class VideoFilter
+{
+protected:
+	cl::Context context;
+	cl::CommandQueue queue;
+	BilateralFilterCL filter;
+	BilateralGridCL grid;
+
+	bool grid_engine;
+	int param_space;
+	float param_range;
+	float static_threshold;
+
+	int width, height;
+	cl::Buffer source_dev, dest_dev;
+
+	// časový režim - L, ze kterého vznikl splat na zařízení
+	cv::Mat splatted;
+
+	// statistika
+	int frames;
+	int full_splats;
+	double dirty_tiles, total_tiles;
+	double decode_time, filter_time, encode_time, total_time;
+
+	static FILE *raw_stdout;
+
+private:
+	/**
+	 * Alokuje buffery na zařízení pro snímky width x height.
+	 */
+	void allocate(int width, int height);
+
+	/**
+	 * Vyfiltruje snímek (Lab CV_32FC3), výsledek má stejnou velikost.
+	 */
+	cv::Mat filterFrame(const cv::Mat &lab);
+
+	cv::Mat filterBruteForce(const cv::Mat &lab);
+	cv::Mat filterGrid(const cv::Mat &lab);
+
+public:
+	// po tolika snímcích časového režimu se mřížka splatuje celá (kumulace zaokrouhlení)
+	static const int KEYFRAME_INTERVAL = 30;
+
+	VideoFilter(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+		bool grid_engine, int param_space, float param_range, float static_threshold);
+
+	/**
+	 * Zpracuje celé video. input je cesta pro cv::VideoCapture nebo "-" pro surové snímky
+	 * raw_width x raw_height ze stdin, output cesta pro cv::VideoWriter nebo "-" pro stdout.
+	 * Vrátí počet zpracovaných snímků.
+	 */
+	int run(const std::string &input, const std::string &output, int raw_width, int raw_height);
+
+	/**
+	 * Vypíše propustnost a vytížení jednotlivých fází.
+	 */
+	void printStats(void);
+
+	/**
+	 * Vyhradí stdout pro surové snímky, textový výstup programu se přesměruje na stderr.
+	 * Volá se před prvním výpisem.
+	 */
+	static void reserveStdout(void);
+};
@@ -8,6 +8,25 @@
 
 #define POW2(x) ((x) * (x))
 
+/*
+ * Vstup po operacch FilterGraph - hlaviku s makry generuje FilterGraph::getSource.
+ * GRAPH_OPS(value, source_pix) uprav filtrovan bod Lab (float3), GRAPH_OPS_L tot pro kanl L
+ * (float). GRAPH_STORE zape bod Lab do vstupu typu GRAPH_OUTPUT. Bez grafu jsou operace
+ * przdn a zpis je obyejn float4 (stejn layout jako float3).
+ */
+#ifndef GRAPH_OPS
+#define GRAPH_OPS(value, source_pix)
+#endif
+
+#ifndef GRAPH_OPS_L
+#define GRAPH_OPS_L(value, source_pix)
+#endif
+
+#ifndef GRAPH_STORE
+#define GRAPH_OUTPUT float4
+#define GRAPH_STORE(destination, index, value) ((destination)[index] = (float4)((value), 0.0f))
+#endif
+
 /**
  * @brief Bilaterln filtr - standardn metoda.
  * 
@@ -18,7 +37,7 @@
  */
 __kernel void bilateralFilter_basic(
 	__global float3 *source,
-	__global float3 *destination,
+	__global GRAPH_OUTPUT *destination,
 	const int dst_width,
 	const int dst_height,
 	const int space_param,
@@ -69,6 +88,461 @@ __kernel void bilateralFilter_basic(
 			}
 		}
 
+		float3 value = sum / normalization_term;
+		GRAPH_OPS(value, center_pix);
+		GRAPH_STORE(destination, global_y * dst_width + global_x, value);
+	}
+}
+
+
+/**
+ * @brief Bilaterln filtr - jen kanl L (jednorozmrn vzdlenost barev).
+ *
+ * @param Vstupn obrazov data - kanl L.
+ * @param Vstupn obrazov data - kanl L. Rozmry jsou men o 2x radius.
+ * @param Prostorov (spatial) parametr filtru - radius.
+ * @param Parametr filtru - intenzita barev.
+ */
+__kernel void bilateralFilter_lightness(
+	__global float *source,
+	__global float *destination,
+	const int dst_width,
+	const int dst_height,
+	const int space_param,
+	const float range_param)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int src_width = dst_width + space_param * 2;
+
+	if ((global_x < dst_width) && (global_y < dst_height))
+	{
+		__global float *window = source + global_y * src_width + global_x;
+		float center_pix = window[space_param * src_width + space_param];
+
+		float sum = 0.0f;
+		float normalization_term = 0.0f;
+
+		for (int local_y = -space_param; local_y <= space_param; local_y++)
+		{
+			for (int local_x = -space_param; local_x <= space_param; local_x++)
+			{
+				float temp_pix = window[(local_y + space_param) * src_width + local_x + space_param];
+
+				float spatial_weight = exp(-0.5f * (POW2(local_x) + POW2(local_y)) / space_param);
+				float total_weight = spatial_weight * exp(-POW2(center_pix - temp_pix) * range_param);
+
+				sum += temp_pix * total_weight;
+				normalization_term += total_weight;
+			}
+		}
+
+		float value = sum / normalization_term;
+		GRAPH_OPS_L(value, center_pix);
+		destination[global_y * dst_width + global_x] = value;
+	}
+}
+
+
+#ifdef RADIUS
+
+#ifndef CHANNELS
+#define CHANNELS 3
+#endif
+
+#if CHANNELS == 1
+#define PIXEL float
+#define RANGE_DISTANCE(d) ((d) * (d))
+#define PIXEL_OUTPUT float
+#define PIXEL_OPS GRAPH_OPS_L
+#define PIXEL_STORE(destination, index, value) ((destination)[index] = (value))
+#else
+#define PIXEL float3
+#define RANGE_DISTANCE(d) dot((d), (d))
+#define PIXEL_OUTPUT GRAPH_OUTPUT
+#define PIXEL_OPS GRAPH_OPS
+#define PIXEL_STORE GRAPH_STORE
+#endif
+
+/**
+ * @brief Bilaterln filtr - varianta s radiusem znmm pi pekladu.
+ *
+ * Program se sestavuje s volbami -D RADIUS=<r> -D CHANNELS=<1|3>. Meze smyek jsou konstantn,
+ * peklada je cel rozvine a prostorov vhy spot u pi pekladu.
+ *
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB (CHANNELS 3) nebo jen L (CHANNELS 1).
+ * @param Vstupn obrazov data. Rozmry jsou men o 2x radius.
+ * @param Parametr filtru - intenzita barev.
+ */
+__kernel void bilateralFilter_radius(
+	__global PIXEL *source,
+	__global PIXEL_OUTPUT *destination,
+	const int dst_width,
+	const int dst_height,
+	const float range_param)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int src_width = dst_width + RADIUS * 2;
+
+	if ((global_x < dst_width) && (global_y < dst_height))
+	{
+		__global PIXEL *window = source + global_y * src_width + global_x;
+		PIXEL center_pix = window[RADIUS * src_width + RADIUS];
+
+		PIXEL sum = 0.0f;
+		float normalization_term = 0.0f;
+
+#pragma unroll
+		for (int local_y = 0; local_y <= 2 * RADIUS; local_y++)
+		{
+#pragma unroll
+			for (int local_x = 0; local_x <= 2 * RADIUS; local_x++)
+			{
+				PIXEL temp_pix = window[local_y * src_width + local_x];
+
+				// Po rozvinut je argument konstanta.
+				float spatial_weight = exp(-0.5f * (POW2(local_x - RADIUS) + POW2(local_y - RADIUS)) / RADIUS);
+				float total_weight = spatial_weight * exp(-RANGE_DISTANCE(center_pix - temp_pix) * range_param);
+
+				sum += temp_pix * total_weight;
+				normalization_term += total_weight;
+			}
+		}
+
+		PIXEL value = sum / normalization_term;
+		PIXEL_OPS(value, center_pix);
+		PIXEL_STORE(destination, global_y * dst_width + global_x, value);
+	}
+}
+
+#endif // RADIUS
+
+
+#ifndef BLOCK_X
+#define BLOCK_X 1
+#endif
+
+#ifndef BLOCK_Y
+#define BLOCK_Y 1
+#endif
+
+#ifdef RADIUS
+#define WINDOW_RADIUS RADIUS
+#else
+#define WINDOW_RADIUS space_param
+#endif
+
+/**
+ * @brief Bilaterln filtr - kad pracovn poloka pot blok BLOCK_X x BLOCK_Y vstup.
+ *
+ * Sousedn vstupy sdlej tm cel okno. Kad bod sjednocen oken bloku se nate jen jednou
+ * (jedno ten float4, cl_float3 m velikost 16 B) a pite se ke vem vstupm bloku, do jejich
+ * okna pat. Program se sestavuje s -D BLOCK_X=<bx> -D BLOCK_Y=<by>, ppadn i s -D RADIUS=<r>.
+ *
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB.
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB. Rozmry jsou men o 2x radius.
+ * @param Prostorov (spatial) parametr filtru - radius (s -D RADIUS se nepouije).
+ * @param Parametr filtru - intenzita barev.
+ */
+__kernel void bilateralFilter_blocked(
+	__global float4 *source,
+	__global GRAPH_OUTPUT *destination,
+	const int dst_width,
+	const int dst_height,
+	const int space_param,
+	const float range_param)
+{
+	const int radius = WINDOW_RADIUS;
+	int block_x = get_global_id(0) * BLOCK_X;
+	int block_y = get_global_id(1) * BLOCK_Y;
+	int src_width = dst_width + radius * 2;
+	int src_height = dst_height + radius * 2;
+
+	if ((block_x < dst_width) && (block_y < dst_height))
+	{
+		float3 center_pix[BLOCK_Y][BLOCK_X];
+		float3 sum[BLOCK_Y][BLOCK_X];
+		float normalization_term[BLOCK_Y][BLOCK_X];
+
+#pragma unroll
+		for (int by = 0; by < BLOCK_Y; by++)
+		{
+#pragma unroll
+			for (int bx = 0; bx < BLOCK_X; bx++)
+			{
+				// Vstupy za okrajem obrzku se nezapisuj, ten se jen ozne.
+				int center_y = min(block_y + by, dst_height - 1) + radius;
+				int center_x = min(block_x + bx, dst_width - 1) + radius;
+				center_pix[by][bx] = source[center_y * src_width + center_x].xyz;
+				sum[by][bx] = 0.0f;
+				normalization_term[by][bx] = 0.0f;
+			}
+		}
+
+		for (int window_y = 0; window_y < 2 * radius + BLOCK_Y; window_y++)
+		{
+			int v = min(block_y + window_y, src_height - 1);
+
+			for (int window_x = 0; window_x < 2 * radius + BLOCK_X; window_x++)
+			{
+				int u = min(block_x + window_x, src_width - 1);
+				float3 temp_pix = source[v * src_width + u].xyz;
+
+#pragma unroll
+				for (int by = 0; by < BLOCK_Y; by++)
+				{
+					int local_y = window_y - by - radius;
+
+#pragma unroll
+					for (int bx = 0; bx < BLOCK_X; bx++)
+					{
+						int local_x = window_x - bx - radius;
+
+						if (abs(local_x) <= radius && abs(local_y) <= radius)
+						{
+							float spatial_weight = exp(-0.5f * (POW2(local_x) + POW2(local_y)) / radius);
+							float3 difference = center_pix[by][bx] - temp_pix;
+							float total_weight = spatial_weight * exp(-dot(difference, difference) * range_param);
+
+							sum[by][bx] += temp_pix * total_weight;
+							normalization_term[by][bx] += total_weight;
+						}
+					}
+				}
+			}
+		}
+
+#pragma unroll
+		for (int by = 0; by < BLOCK_Y; by++)
+		{
+#pragma unroll
+			for (int bx = 0; bx < BLOCK_X; bx++)
+			{
+				if ((block_x + bx < dst_width) && (block_y + by < dst_height))
+				{
+					float3 value = sum[by][bx] / normalization_term[by][bx];
+					GRAPH_OPS(value, center_pix[by][bx]);
+					GRAPH_STORE(destination, (block_y + by) * dst_width + block_x + bx, value);
+				}
+			}
+		}
+	}
+}
+
+
+/**
+ * @brief Bilaterln filtr - okno zadan dkm seznamem vah.
+ *
+ * Seznam sestavuje hostitel (BilateralFilterCL::setTaps) - jen body s prostorovou vahou
+ * nad zvolenou mez nebo uvnit kruhu o polomru radius. Rohy tvercovho okna, jejich
+ * vha je zanedbateln, se tak vbec netou.
+ *
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB.
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB. Rozmry jsou men o 2x radius.
+ * @param Prostorov (spatial) parametr filtru - radius (uruje jen halo zny).
+ * @param Parametr filtru - intenzita barev.
+ * @param Seznam vah (dx, dy, prostorov vha, 0).
+ * @param Poet vah v seznamu.
+ */
+__kernel void bilateralFilter_taps(
+	__global float3 *source,
+	__global float3 *destination,
+	const int dst_width,
+	const int dst_height,
+	const int space_param,
+	const float range_param,
+	__constant float4 *taps,
+	const int tap_count)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int src_width = dst_width + space_param * 2;
+
+	if ((global_x < dst_width) && (global_y < dst_height))
+	{
+		__global float3 *center = source + (global_y + space_param) * src_width + global_x + space_param;
+		float3 center_pix = *center;
+
+		float3 sum = 0.0f;
+		float normalization_term = 0.0f;
+
+		for (int i = 0; i < tap_count; i++)
+		{
+			float4 tap = taps[i];
+			float3 temp_pix = center[(int)tap.y * src_width + (int)tap.x];
+			float3 difference = center_pix - temp_pix;
+			float total_weight = tap.z * exp(-dot(difference, difference) * range_param);
+
+			sum += temp_pix * total_weight;
+			normalization_term += total_weight;
+		}
+
 		destination[global_y * dst_width + global_x] = sum / normalization_term;
 	}
 }
+
+
+/**
+ * @brief Doplnn halo zn - kopie obrzku do bufferu vtho o 2x radius s opakovnm okraj.
+ *
+ * Vstup filtru (men o 2x radius) se tak me znovu filtrovat, ani by se obrzek zmenoval.
+ * Globln rozmr odpovd rozenmu obrzku.
+ *
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB (cl_float3 m velikost 16 B).
+ * @param Vstupn obrazov data. Rozmry jsou vt o 2x radius.
+ * @param Prostorov (spatial) parametr filtru - radius.
+ */
+__kernel void bilateralFilter_pad(
+	__global float4 *source,
+	__global float4 *destination,
+	const int width,
+	const int height,
+	const int space_param)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int dst_width = width + space_param * 2;
+
+	if ((global_x < dst_width) && (global_y < height + space_param * 2))
+	{
+		int x = clamp(global_x - space_param, 0, width - 1);
+		int y = clamp(global_y - space_param, 0, height - 1);
+
+		destination[global_y * dst_width + global_x] = source[y * width + x];
+	}
+}
+
+
+/**
+ * @brief Bilaterln filtr dvky malch obrzk - get_global_id(2) je index obrzku.
+ *
+ * Obrzky jsou uloen za sebou ve slotech stejn velikosti (slot_width + 2x radius)
+ * x (slot_height + 2x radius) s halo znami, vstupn sloty maj velikost slot_width x slot_height.
+ * Obrzek men ne slot le v levm hornm rohu, body mimo jeho rozmry se nepotaj.
+ *
+ * @param Vstupn obrazov data vech obrzk. Barevn formt CIE-LAB.
+ * @param Vstupn obrazov data vech obrzk. Barevn formt CIE-LAB.
+ * @param Rozmry obrzk (ka, vka) bez halo zn.
+ * @param ka vstupnho slotu.
+ * @param Vka vstupnho slotu.
+ * @param Prostorov (spatial) parametr filtru - radius.
+ * @param Parametr filtru - intenzita barev.
+ */
+__kernel void bilateralFilter_batch(
+	__global float3 *source,
+	__global float3 *destination,
+	__global int2 *sizes,
+	const int slot_width,
+	const int slot_height,
+	const int space_param,
+	const float range_param)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int image = get_global_id(2);
+	int2 size = sizes[image];
+	int src_width = slot_width + space_param * 2;
+
+	if ((global_x < size.x) && (global_y < size.y))
+	{
+		__global float3 *window = source + image * src_width * (slot_height + space_param * 2) + global_y * src_width + global_x;
+		float3 center_pix = window[space_param * src_width + space_param];
+
+		float3 sum = 0.0f;
+		float normalization_term = 0.0f;
+
+		for (int local_y = 0; local_y <= 2 * space_param; local_y++)
+		{
+			for (int local_x = 0; local_x <= 2 * space_param; local_x++)
+			{
+				float3 temp_pix = window[local_y * src_width + local_x];
+				float spatial_weight = exp(-0.5f * (POW2(local_x - space_param) + POW2(local_y - space_param)) / space_param);
+				float3 difference = center_pix - temp_pix;
+				float total_weight = spatial_weight * exp(-dot(difference, difference) * range_param);
+
+				sum += temp_pix * total_weight;
+				normalization_term += total_weight;
+			}
+		}
+
+		destination[(image * slot_height + global_y) * slot_width + global_x] = sum / normalization_term;
+	}
+}
+
+
+#ifdef SWEEP_COUNT
+
+/**
+ * @brief Bilaterln filtr pro SWEEP_COUNT parametr barev najednou (ladn parametru).
+ *
+ * Kad bod okna se nate jednou, prostorov vha a vzdlenost barev se spotaj jednou
+ * a pro kad parametr se v registrech akumuluje vlastn souet a normalizace.
+ * Program se sestavuje s -D SWEEP_COUNT=<k> (a ppadn -D RADIUS=<r>).
+ *
+ * @param Vstupn obrazov data. Barevn formt CIE-LAB.
+ * @param Vstupy pro parametry first .. first + SWEEP_COUNT - 1, kad dst_width x dst_height bod za sebou.
+ * @param Prostorov (spatial) parametr filtru - radius.
+ * @param Parametry filtru - intenzita barev (vechny parametry sweepu).
+ * @param Index prvnho parametru tto dvky.
+ */
+__kernel void bilateralFilter_sweep(
+	__global float3 *source,
+	__global float3 *destination,
+	const int dst_width,
+	const int dst_height,
+	const int space_param,
+	__constant float *range_params,
+	const int first)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	const int radius = WINDOW_RADIUS;
+	int src_width = dst_width + radius * 2;
+
+	if ((global_x < dst_width) && (global_y < dst_height))
+	{
+		__global float3 *window = source + global_y * src_width + global_x;
+		float3 center_pix = window[radius * src_width + radius];
+
+		float range_param[SWEEP_COUNT];
+		float3 sum[SWEEP_COUNT];
+		float normalization_term[SWEEP_COUNT];
+
+#pragma unroll
+		for (int k = 0; k < SWEEP_COUNT; k++)
+		{
+			range_param[k] = range_params[first + k];
+			sum[k] = 0.0f;
+			normalization_term[k] = 0.0f;
+		}
+
+		for (int local_y = 0; local_y <= 2 * radius; local_y++)
+		{
+			for (int local_x = 0; local_x <= 2 * radius; local_x++)
+			{
+				float3 temp_pix = window[local_y * src_width + local_x];
+				float spatial_weight = exp(-0.5f * (POW2(local_x - radius) + POW2(local_y - radius)) / radius);
+				float3 difference = center_pix - temp_pix;
+				float distance = dot(difference, difference);
+
+#pragma unroll
+				for (int k = 0; k < SWEEP_COUNT; k++)
+				{
+					float total_weight = spatial_weight * exp(-distance * range_param[k]);
+					sum[k] += temp_pix * total_weight;
+					normalization_term[k] += total_weight;
+				}
+			}
+		}
+
+		const int plane = dst_width * dst_height;
+#pragma unroll
+		for (int k = 0; k < SWEEP_COUNT; k++)
+		{
+			destination[(first + k) * plane + global_y * dst_width + global_x] = sum[k] / normalization_term[k];
+		}
+	}
+}
+
+#endif // SWEEP_COUNT
@@ -0,0 +1,616 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+/**
+ * Bilateral grid on the device - the same algorithm as cv_extend::bilateralFilter.
+ *
+ * Grid cells are float2 (sum, count), layout [small_height][small_width][small_depth]
+ * with depth as the fastest axis. Every blur kernel applies the [1 2 1]/4 stencil twice
+ * along one axis (both passes of the host loop fused), the grid is read and written once.
+ */
+
+#define PADDING 2
+
+#ifndef BLUR_TILE
+#define BLUR_TILE 16
+#endif
+
+int gridIndex(int y, int x, int z, int small_width, int small_depth)
+{
+	return (y * small_width + x) * small_depth + z;
+}
+
+void atomicAddFloat(volatile __global float *address, float value)
+{
+	union { unsigned int u; float f; } old_value, new_value;
+
+	do
+	{
+		old_value.f = *address;
+		new_value.f = old_value.f + value;
+	} while (atomic_cmpxchg((volatile __global unsigned int *)address, old_value.u, new_value.u) != old_value.u);
+}
+
+void atomicAddLocalFloat(volatile __local float *address, float value)
+{
+	union { unsigned int u; float f; } old_value, new_value;
+
+	do
+	{
+		old_value.f = *address;
+		new_value.f = old_value.f + value;
+	} while (atomic_cmpxchg((volatile __local unsigned int *)address, old_value.u, new_value.u) != old_value.u);
+}
+
+/**
+ * One [1 2 1]/4 step. The border cells of the grid stay empty, as in the host version.
+ */
+float2 blurCell(float2 prev, float2 curr, float2 next, int position, int length)
+{
+	return (position > 0 && position < length - 1) ? (prev + 2.0f * curr + next) * 0.25f : (float2)(0.0f);
+}
+
+/**
+ * @brief Down sample - every pixel adds (value, 1) to its grid cell.
+ *
+ * @param Vstupní obraz (šedotónový, width x height).
+ * @param Mřížka, musí být vynulovaná.
+ */
+__kernel void bilateralGrid_splat(
+	__global float *source,
+	__global float2 *grid,
+	const int width,
+	const int height,
+	const int small_width,
+	const int small_depth,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		float value = source[global_y * width + global_x];
+
+		int small_x = (int)(global_x / sigma_space + 0.5f) + PADDING;
+		int small_y = (int)(global_y / sigma_space + 0.5f) + PADDING;
+		int small_z = (int)((value - source_min) / sigma_color + 0.5f) + PADDING;
+
+		volatile __global float *cell = (volatile __global float *)&grid[gridIndex(small_y, small_x, small_z, small_width, small_depth)];
+		atomicAddFloat(cell, value);
+		atomicAddFloat(cell + 1, 1.0f);
+	}
+}
+
+#define TEMPORAL_TILE 16
+
+/**
+ * @brief Temporal update of a kept splat - global (TEMPORAL_TILE, TEMPORAL_TILE, tiles).
+ *
+ * Every pixel of a changed tile whose value differs from the splatted one removes its old
+ * contribution from the grid and adds the new one. The splat is linear, so the result is the
+ * splat of the current input (up to the order of the float additions).
+ *
+ * @param Vstupní obraz (šedotónový, width x height).
+ * @param Vstup, ze kterého vznikl splat - aktualizuje se.
+ * @param Splat předchozího snímku (bez rozmazání).
+ * @param Souřadnice změněných dlaždic.
+ */
+__kernel void bilateralGrid_splatDelta(
+	__global float *source,
+	__global float *splatted,
+	__global float2 *grid,
+	__global int2 *tiles,
+	const int width,
+	const int height,
+	const int small_width,
+	const int small_depth,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int2 tile = tiles[get_global_id(2)];
+	int global_x = tile.x * TEMPORAL_TILE + get_local_id(0);
+	int global_y = tile.y * TEMPORAL_TILE + get_local_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+		float old_value = splatted[index];
+		float value = source[index];
+
+		if (old_value != value)
+		{
+			int small_x = (int)(global_x / sigma_space + 0.5f) + PADDING;
+			int small_y = (int)(global_y / sigma_space + 0.5f) + PADDING;
+			int old_z = (int)((old_value - source_min) / sigma_color + 0.5f) + PADDING;
+			int small_z = (int)((value - source_min) / sigma_color + 0.5f) + PADDING;
+
+			volatile __global float *old_cell = (volatile __global float *)&grid[gridIndex(small_y, small_x, old_z, small_width, small_depth)];
+			atomicAddFloat(old_cell, -old_value);
+			atomicAddFloat(old_cell + 1, -1.0f);
+
+			volatile __global float *cell = (volatile __global float *)&grid[gridIndex(small_y, small_x, small_z, small_width, small_depth)];
+			atomicAddFloat(cell, value);
+			atomicAddFloat(cell + 1, 1.0f);
+
+			splatted[index] = value;
+		}
+	}
+}
+
+/**
+ * @brief Down sample with a per-work-group sub-grid in local memory.
+ *
+ * The pixels of a work-group fall into span x span columns of the grid. They are accumulated
+ * with local atomics and every non-empty cell is flushed once to the global grid
+ * (neighbouring work-groups can share the border cells, so the flush is atomic too).
+ *
+ * @param Vstupní obraz (šedotónový, width x height).
+ * @param Mřížka, musí být vynulovaná.
+ */
+__kernel void bilateralGrid_splatLocal(
+	__global float *source,
+	__global float2 *grid,
+	const int width,
+	const int height,
+	const int small_width,
+	const int small_depth,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color,
+	const int span,
+	__local float2 *sub_grid)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+	int local_index = get_local_id(1) * get_local_size(0) + get_local_id(0);
+	int local_count = get_local_size(0) * get_local_size(1);
+
+	int cell_x_begin = (int)((get_group_id(0) * get_local_size(0)) / sigma_space + 0.5f);
+	int cell_y_begin = (int)((get_group_id(1) * get_local_size(1)) / sigma_space + 0.5f);
+	int sub_cells = span * span * small_depth;
+
+	for (int i = local_index; i < sub_cells; i += local_count)
+	{
+		sub_grid[i] = (float2)(0.0f);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		float value = source[global_y * width + global_x];
+
+		int sub_x = (int)(global_x / sigma_space + 0.5f) - cell_x_begin;
+		int sub_y = (int)(global_y / sigma_space + 0.5f) - cell_y_begin;
+		int small_z = (int)((value - source_min) / sigma_color + 0.5f) + PADDING;
+
+		volatile __local float *cell = (volatile __local float *)&sub_grid[(sub_y * span + sub_x) * small_depth + small_z];
+		atomicAddLocalFloat(cell, value);
+		atomicAddLocalFloat(cell + 1, 1.0f);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = local_index; i < sub_cells; i += local_count)
+	{
+		float2 sum = sub_grid[i];
+		if (sum.y != 0.0f)
+		{
+			int small_z = i % small_depth;
+			int small_x = cell_x_begin + (i / small_depth) % span + PADDING;
+			int small_y = cell_y_begin + i / (small_depth * span) + PADDING;
+
+			volatile __global float *cell = (volatile __global float *)&grid[gridIndex(small_y, small_x, small_z, small_width, small_depth)];
+			atomicAddFloat(cell, sum.x);
+			atomicAddFloat(cell + 1, sum.y);
+		}
+	}
+}
+
+/*
+ * Deterministic splat: the pixels are sorted by (cell, pixel index) and every cell
+ * is summed by one work-item in pixel order - the same order as the host loop.
+ */
+
+/**
+ * @brief Sort keys (cell << 32 | pixel index), padding keys sort to the end.
+ */
+__kernel void bilateralGrid_cellKeys(
+	__global float *source,
+	__global ulong *keys,
+	const int width,
+	const int height,
+	const int key_count,
+	const int small_width,
+	const int small_depth,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int index = get_global_id(0);
+
+	if (index < width * height)
+	{
+		int global_x = index % width;
+		int global_y = index / width;
+		float value = source[index];
+
+		int small_x = (int)(global_x / sigma_space + 0.5f) + PADDING;
+		int small_y = (int)(global_y / sigma_space + 0.5f) + PADDING;
+		int small_z = (int)((value - source_min) / sigma_color + 0.5f) + PADDING;
+
+		keys[index] = ((ulong)gridIndex(small_y, small_x, small_z, small_width, small_depth) << 32) | (ulong)index;
+	}
+	else if (index < key_count)
+	{
+		keys[index] = ULONG_MAX;
+	}
+}
+
+/**
+ * @brief One compare-exchange step of a bitonic sort (key_count is a power of two).
+ */
+__kernel void bilateralGrid_bitonicStep(
+	__global ulong *keys,
+	const int j,
+	const int k)
+{
+	int i = get_global_id(0);
+	int partner = i ^ j;
+
+	if (partner > i)
+	{
+		ulong a = keys[i];
+		ulong b = keys[partner];
+		bool ascending = (i & k) == 0;
+
+		if ((a > b) == ascending)
+		{
+			keys[i] = b;
+			keys[partner] = a;
+		}
+	}
+}
+
+/**
+ * @brief Segmented reduction - the first work-item of every run of equal cells sums the run.
+ */
+__kernel void bilateralGrid_reduceSorted(
+	__global ulong *keys,
+	__global float *source,
+	__global float2 *grid,
+	const int count)
+{
+	int i = get_global_id(0);
+
+	if (i < count)
+	{
+		uint cell = (uint)(keys[i] >> 32);
+
+		if (i == 0 || (uint)(keys[i - 1] >> 32) != cell)
+		{
+			float2 sum = (float2)(0.0f);
+			for (int j = i; j < count && (uint)(keys[j] >> 32) == cell; j++)
+			{
+				sum += (float2)(source[(uint)keys[j]], 1.0f);
+			}
+			grid[cell] = sum;
+		}
+	}
+}
+
+/**
+ * @brief Blur along depth (the contiguous axis).
+ *
+ * Local size (BLUR_TILE, BLUR_TILE): dim 0 runs along depth, dim 1 over grid lines.
+ * The tile is loaded with a halo of two cells (one per pass), the first pass
+ * is kept in local memory.
+ */
+__kernel void bilateralGrid_blurDepth(
+	__global float2 *source,
+	__global float2 *destination,
+	const int lines,
+	const int depth)
+{
+	__local float2 tile[BLUR_TILE][BLUR_TILE + 4];
+	__local float2 pass[BLUR_TILE][BLUR_TILE + 2];
+
+	int local_z = get_local_id(0);
+	int local_line = get_local_id(1);
+	int z_begin = get_group_id(0) * BLUR_TILE;
+	int line = get_global_id(1);
+	bool line_valid = line < lines;
+
+	__global float2 *source_line = source + line * depth;
+
+	for (int i = local_z; i < BLUR_TILE + 4; i += BLUR_TILE)
+	{
+		int z = z_begin + i - 2;
+		tile[local_line][i] = (line_valid && z >= 0 && z < depth) ? source_line[z] : (float2)(0.0f);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = local_z; i < BLUR_TILE + 2; i += BLUR_TILE)
+	{
+		pass[local_line][i] = blurCell(tile[local_line][i], tile[local_line][i + 1], tile[local_line][i + 2], z_begin + i - 1, depth);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int z = z_begin + local_z;
+	if (line_valid && z < depth)
+	{
+		destination[line * depth + z] = blurCell(pass[local_line][local_z], pass[local_line][local_z + 1], pass[local_line][local_z + 2], z, depth);
+	}
+}
+
+/**
+ * @brief Blur along a strided axis (x: stride small_depth, y: stride small_width * small_depth).
+ *
+ * Local size (BLUR_TILE, BLUR_TILE), global (depth, length, outer). Dim 0 runs along depth,
+ * so every row of the tile is a coalesced load of consecutive cells; the stencil then
+ * runs down the columns of the tile - the strided axis is transposed through local memory.
+ */
+__kernel void bilateralGrid_blurStrided(
+	__global float2 *source,
+	__global float2 *destination,
+	const int depth,
+	const int length,
+	const int axis_stride,
+	const int outer_stride)
+{
+	__local float2 tile[BLUR_TILE + 4][BLUR_TILE];
+	__local float2 pass[BLUR_TILE + 2][BLUR_TILE];
+
+	int local_z = get_local_id(0);
+	int local_a = get_local_id(1);
+	int z = get_global_id(0);
+	int a_begin = get_group_id(1) * BLUR_TILE;
+	int outer_offset = get_global_id(2) * outer_stride + z;
+	bool z_valid = z < depth;
+
+	for (int i = local_a; i < BLUR_TILE + 4; i += BLUR_TILE)
+	{
+		int a = a_begin + i - 2;
+		tile[i][local_z] = (z_valid && a >= 0 && a < length) ? source[outer_offset + a * axis_stride] : (float2)(0.0f);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	for (int i = local_a; i < BLUR_TILE + 2; i += BLUR_TILE)
+	{
+		pass[i][local_z] = blurCell(tile[i][local_z], tile[i + 1][local_z], tile[i + 2][local_z], a_begin + i - 1, length);
+	}
+	barrier(CLK_LOCAL_MEM_FENCE);
+
+	int a = a_begin + local_a;
+	if (z_valid && a < length)
+	{
+		destination[outer_offset + a * axis_stride] = blurCell(pass[local_a][local_z], pass[local_a + 1][local_z], pass[local_a + 2][local_z], a, length);
+	}
+}
+
+/**
+ * @brief Blur along one axis with an arbitrary kernel - used when the sampling rate differs from sigma.
+ *
+ * Global size (inner, length, outer), the cell at position a of the axis is
+ * outer * outer_stride + a * axis_stride + inner. Cells outside the grid count as zero and
+ * the first and last cell of the axis stay zero, as in blurCell.
+ *
+ * @param Váhy jádra, 2 * blur_radius + 1 hodnot.
+ */
+__kernel void bilateralGrid_blurWide(
+	__global float2 *source,
+	__global float2 *destination,
+	__constant float *weights,
+	const int blur_radius,
+	const int inner,
+	const int length,
+	const int axis_stride,
+	const int outer_stride)
+{
+	int i = get_global_id(0);
+	int a = get_global_id(1);
+
+	if (i < inner && a < length)
+	{
+		int offset = get_global_id(2) * outer_stride + i;
+		float2 sum = 0.0f;
+
+		if (a > 0 && a < length - 1)
+		{
+			for (int k = max(-blur_radius, -a); k <= min(blur_radius, length - 1 - a); k++)
+			{
+				sum += weights[k + blur_radius] * source[offset + (a + k) * axis_stride];
+			}
+		}
+		destination[offset + a * axis_stride] = sum;
+	}
+}
+
+/**
+ * @brief sum / count of every cell (in place).
+ */
+__kernel void bilateralGrid_normalise(
+	__global float2 *grid,
+	const int cells)
+{
+	int index = get_global_id(0);
+
+	if (index < cells)
+	{
+		float2 cell = grid[index];
+		grid[index].x = cell.x / ((cell.y != 0.0f) ? cell.y : 1.0f);
+	}
+}
+
+float gridSample(__global float2 *grid, int small_height, int small_width, int small_depth, float y, float x, float z)
+{
+	const int y_index = clamp((int)y, 0, small_height - 1);
+	const int yy_index = clamp(y_index + 1, 0, small_height - 1);
+	const int x_index = clamp((int)x, 0, small_width - 1);
+	const int xx_index = clamp(x_index + 1, 0, small_width - 1);
+	const int z_index = clamp((int)z, 0, small_depth - 1);
+	const int zz_index = clamp(z_index + 1, 0, small_depth - 1);
+	const float y_alpha = y - y_index;
+	const float x_alpha = x - x_index;
+	const float z_alpha = z - z_index;
+
+	float c000 = grid[gridIndex(y_index, x_index, z_index, small_width, small_depth)].x;
+	float c001 = grid[gridIndex(y_index, x_index, zz_index, small_width, small_depth)].x;
+	float c010 = grid[gridIndex(y_index, xx_index, z_index, small_width, small_depth)].x;
+	float c011 = grid[gridIndex(y_index, xx_index, zz_index, small_width, small_depth)].x;
+	float c100 = grid[gridIndex(yy_index, x_index, z_index, small_width, small_depth)].x;
+	float c101 = grid[gridIndex(yy_index, x_index, zz_index, small_width, small_depth)].x;
+	float c110 = grid[gridIndex(yy_index, xx_index, z_index, small_width, small_depth)].x;
+	float c111 = grid[gridIndex(yy_index, xx_index, zz_index, small_width, small_depth)].x;
+
+	return mix(
+		mix(mix(c000, c001, z_alpha), mix(c010, c011, z_alpha), x_alpha),
+		mix(mix(c100, c101, z_alpha), mix(c110, c111, z_alpha), x_alpha),
+		y_alpha);
+}
+
+/**
+ * @brief Up sample - trilinear interpolation of the normalised grid.
+ *
+ * @param Vstupní obraz (šedotónový, width x height).
+ * @param Výstupní obraz, stejné rozměry jako vstup.
+ */
+__kernel void bilateralGrid_slice(
+	__global float *source,
+	__global float *destination,
+	__global float2 *grid,
+	const int width,
+	const int height,
+	const int small_height,
+	const int small_width,
+	const int small_depth,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+
+		float px = global_x / sigma_space + PADDING;
+		float py = global_y / sigma_space + PADDING;
+		float pz = (source[index] - source_min) / sigma_color + PADDING;
+
+		destination[index] = gridSample(grid, small_height, small_width, small_depth, py, px, pz);
+	}
+}
+
+/*
+ * Slice from an image3d_t - the hardware does the trilinear interpolation and the clamping.
+ * Image axes: width = depth, height = small_width, depth = small_height.
+ */
+
+#ifdef GRID_IMAGES
+
+__constant sampler_t gridSampler = CLK_NORMALIZED_COORDS_FALSE | CLK_ADDRESS_CLAMP_TO_EDGE | CLK_FILTER_LINEAR;
+
+#ifdef GRID_IMAGE_WRITES
+#pragma OPENCL EXTENSION cl_khr_3d_image_writes : enable
+
+/**
+ * @brief sum / count of every cell, written to the image (needs cl_khr_3d_image_writes).
+ */
+__kernel void bilateralGrid_normaliseImage(
+	__global float2 *grid,
+	__write_only image3d_t image,
+	const int small_height,
+	const int small_width,
+	const int small_depth)
+{
+	int z = get_global_id(0);
+	int x = get_global_id(1);
+	int y = get_global_id(2);
+
+	if ((z < small_depth) && (x < small_width) && (y < small_height))
+	{
+		float2 cell = grid[gridIndex(y, x, z, small_width, small_depth)];
+		float value = cell.x / ((cell.y != 0.0f) ? cell.y : 1.0f);
+		write_imagef(image, (int4)(z, x, y, 0), (float4)(value, cell.y, 0.0f, 0.0f));
+	}
+}
+#endif
+
+/**
+ * @brief Up sample - one linearly filtered fetch of the normalised grid.
+ *
+ * Texel centres are at i + 0.5, the grid coordinates are shifted accordingly.
+ */
+__kernel void bilateralGrid_sliceImage(
+	__global float *source,
+	__global float *destination,
+	__read_only image3d_t grid,
+	const int width,
+	const int height,
+	const float source_min,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+
+		float px = global_x / sigma_space + PADDING;
+		float py = global_y / sigma_space + PADDING;
+		float pz = (source[index] - source_min) / sigma_color + PADDING;
+
+		destination[index] = read_imagef(grid, gridSampler, (float4)(pz + 0.5f, px + 0.5f, py + 0.5f, 0.0f)).x;
+	}
+}
+
+#endif
+
+#ifdef GRAPH_OPS
+
+/**
+ * @brief Slice of the normalised L grid with the FilterGraph operations fused into the output.
+ *
+ * The grid was built from L * 255 (range 0 - 255), a/b are taken from the Lab source.
+ * Built only with the FilterGraph header (GRAPH_OPS, GRAPH_OUTPUT, GRAPH_STORE) and filterGraph.cl.
+ */
+__kernel void bilateralGrid_sliceGraph(
+	__global float3 *source,
+	__global GRAPH_OUTPUT *destination,
+	__global float2 *grid,
+	const int width,
+	const int height,
+	const int small_height,
+	const int small_width,
+	const int small_depth,
+	const float sigma_space,
+	const float sigma_color)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+		float3 source_pix = source[index];
+
+		float px = global_x / sigma_space + PADDING;
+		float py = global_y / sigma_space + PADDING;
+		float pz = source_pix.x * 255.0f / sigma_color + PADDING;
+
+		float3 value = (float3)(gridSample(grid, small_height, small_width, small_depth, py, px, pz) / 255.0f, source_pix.y, source_pix.z);
+		GRAPH_OPS(value, source_pix);
+		GRAPH_STORE(destination, index, value);
+	}
+}
+
+#endif
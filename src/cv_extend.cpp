@@ -0,0 +1,427 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#include "cv_extend.hpp"
+
+#include <algorithm>
+#include <limits>
+#include <vector>
+
+#include <omp.h>
+
+
+namespace cv_extend {
+
+	std::vector<float> gridBlurWeights(double sigma_cells)
+	{
+		if (std::abs(sigma_cells - 1.0) < 1e-6) {
+			return std::vector<float>{ 1.0f / 16, 4.0f / 16, 6.0f / 16, 4.0f / 16, 1.0f / 16 };
+		}
+
+		const int blur_radius = std::max(1, static_cast<int>(std::ceil(2.0 * sigma_cells)));
+		std::vector<float> weights(2 * blur_radius + 1);
+		float sum = 0.0f;
+		for (int k = -blur_radius; k <= blur_radius; ++k) {
+			weights[k + blur_radius] = static_cast<float>(std::exp(-0.5 * k * k / (sigma_cells * sigma_cells)));
+			sum += weights[k + blur_radius];
+		}
+		for (float &w : weights) {
+			w /= sum;
+		}
+		return weights;
+	}
+
+
+	void bilateralFilter(cv::Mat1f src, cv::Mat1f dst,
+		double sigma_color, double sigma_space,
+		double sampling_color, double sampling_space)
+	{
+		const size_t height = src.rows, width = src.cols;
+		const size_t padding_xy = 2, padding_z = 2;
+		double src_min, src_max;
+		cv::minMaxLoc(src, &src_min, &src_max);
+
+		if (sampling_color <= 0) {
+			sampling_color = sigma_color;
+		}
+		if (sampling_space <= 0) {
+			sampling_space = sigma_space;
+		}
+		// blur width of every axis in grid cells (y, x, depth)
+		const double sigma_cells[] = { sigma_space / sampling_space, sigma_space / sampling_space, sigma_color / sampling_color };
+
+		const size_t small_height = static_cast<size_t>((height - 1) / sampling_space) + 1 + 2 * padding_xy;
+		const size_t small_width = static_cast<size_t>((width - 1) / sampling_space) + 1 + 2 * padding_xy;
+		const size_t small_depth = static_cast<size_t>((src_max - src_min) / sampling_color) + 1 + 2 * padding_xy;
+
+		int data_size[] = { small_height, small_width, small_depth };
+		cv::Mat data(3, data_size, CV_32FC2);
+		data.setTo(0);
+
+		// down sample
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				const size_t small_x = static_cast<size_t>(x / sampling_space + 0.5) + padding_xy;
+				const size_t small_y = static_cast<size_t>(y / sampling_space + 0.5) + padding_xy;
+				const float z = src.at<float>(y, x) - src_min;
+				const size_t small_z = static_cast<size_t>(z / sampling_color + 0.5) + padding_z;
+
+				cv::Vec2f v = data.at<cv::Vec2f>(small_y, small_x, small_z);
+				v[0] += src.at<float>(y, x);
+				v[1] += 1.0;
+				data.at<cv::Vec2f>(small_y, small_x, small_z) = v;
+			}
+		}
+
+		// convolution
+		cv::Mat buffer(3, data_size, CV_32FC2);
+		buffer.setTo(0);
+		int offset[3];
+		offset[0] = &(data.at<cv::Vec2f>(1, 0, 0)) - &(data.at<cv::Vec2f>(0, 0, 0));
+		offset[1] = &(data.at<cv::Vec2f>(0, 1, 0)) - &(data.at<cv::Vec2f>(0, 0, 0));
+		offset[2] = &(data.at<cv::Vec2f>(0, 0, 1)) - &(data.at<cv::Vec2f>(0, 0, 0));
+
+		for (int dim = 0; dim < 3; ++dim) { // dim = 3 stands for x, y, and depth
+			const int off = offset[dim];
+
+			if (std::abs(sigma_cells[dim] - 1.0) >= 1e-6) {
+				// sampling rate different from sigma - one pass with a wider (or narrower) kernel
+				const std::vector<float> weights = gridBlurWeights(sigma_cells[dim]);
+				const int blur_radius = static_cast<int>(weights.size()) / 2;
+				const int length = data_size[dim];
+				cv::swap(data, buffer);
+
+				for (int y = 1; y < small_height - 1; ++y) {
+					for (int x = 1; x < small_width - 1; ++x) {
+						cv::Vec2f *d_ptr = &(data.at<cv::Vec2f>(y, x, 1));
+						cv::Vec2f *b_ptr = &(buffer.at<cv::Vec2f>(y, x, 1));
+						for (int z = 1; z < small_depth - 1; ++z, ++d_ptr, ++b_ptr) {
+							const int position = dim == 0 ? y : (dim == 1 ? x : z);
+							cv::Vec2f sum(0.0f, 0.0f);
+							for (int k = std::max(-blur_radius, -position); k <= std::min(blur_radius, length - 1 - position); ++k) {
+								sum += weights[k + blur_radius] * *(b_ptr + k * off);
+							}
+							*d_ptr = sum;
+						} // z
+					} // x
+				} // y
+				continue;
+			}
+
+			for (int ittr = 0; ittr < 2; ++ittr) {
+				cv::swap(data, buffer);
+
+				for (int y = 1; y < small_height - 1; ++y) {
+					for (int x = 1; x < small_width - 1; ++x) {
+						cv::Vec2f *d_ptr = &(data.at<cv::Vec2f>(y, x, 1));
+						cv::Vec2f *b_ptr = &(buffer.at<cv::Vec2f>(y, x, 1));
+						for (int z = 1; z < small_depth - 1; ++z, ++d_ptr, ++b_ptr) {
+							cv::Vec2f b_prev = *(b_ptr - off), b_curr = *b_ptr, b_next = *(b_ptr + off);
+							*d_ptr = (b_prev + b_next + 2.0 * b_curr) / 4.0;
+						} // z
+					} // x
+				} // y
+
+			} // ittr
+		} // dim
+
+		  // upsample
+
+		for (cv::MatIterator_<cv::Vec2f> d = data.begin<cv::Vec2f>(); d != data.end<cv::Vec2f>(); ++d)
+		{
+			(*d)[0] /= (*d)[1] != 0 ? (*d)[1] : 1;
+		}
+
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				const float z = src.at<float>(y, x) - src_min;
+				const float px = static_cast<float>(x) / sampling_space + padding_xy;
+				const float py = static_cast<float>(y) / sampling_space + padding_xy;
+				const float pz = static_cast<float>(z) / sampling_color + padding_z;
+				dst.at<float>(y, x) = trilinear_interpolation<cv::Vec2f>(data, py, px, pz)[0];
+			}
+		}
+	}
+
+
+	/**
+	* Generic brute-force bilateral filter - runtime radius and channel count.
+	*/
+	static void bilateralFilterBruteForceGeneric(const cv::Mat &src, cv::Mat &dst,
+		int radius, float range_param)
+	{
+		const int size = 2 * radius + 1;
+		const int channels = src.channels();
+		const int dst_rows = src.rows - 2 * radius, dst_cols = src.cols - 2 * radius;
+		dst.create(dst_rows, dst_cols, src.type());
+
+		std::vector<float> spatial(size * size);
+		for (int i = 0; i < size * size; ++i) {
+			const int wx = i % size - radius, wy = i / size - radius;
+			spatial[i] = std::exp(-0.5f * (wx * wx + wy * wy) / radius);
+		}
+
+#pragma omp parallel for
+		for (int y = 0; y < dst_rows; ++y) {
+			float *d_ptr = dst.ptr<float>(y);
+			std::vector<float> sum(channels);
+			for (int x = 0; x < dst_cols; ++x) {
+				const float *center = src.ptr<float>(y + radius) + (x + radius) * channels;
+				std::fill(sum.begin(), sum.end(), 0.0f);
+				float normalization = 0.0f;
+
+				for (int wy = 0; wy < size; ++wy) {
+					const float *s_ptr = src.ptr<float>(y + wy) + x * channels;
+					for (int wx = 0; wx < size; ++wx, s_ptr += channels) {
+						float distance = 0.0f;
+						for (int c = 0; c < channels; ++c) {
+							distance += (center[c] - s_ptr[c]) * (center[c] - s_ptr[c]);
+						}
+						const float weight = spatial[wy * size + wx] * std::exp(-distance * range_param);
+						for (int c = 0; c < channels; ++c) {
+							sum[c] += s_ptr[c] * weight;
+						}
+						normalization += weight;
+					}
+				}
+
+				for (int c = 0; c < channels; ++c) {
+					d_ptr[x * channels + c] = sum[c] / normalization;
+				}
+			}
+		}
+	}
+
+
+	typedef void(*brute_force_kernel)(const cv::Mat &src, cv::Mat &dst, const float range_param);
+
+	static const struct {
+		int radius;
+		int channels;
+		brute_force_kernel kernel;
+	} brute_force_kernels[] = {
+		{ 1, 1, &bilateralFilterBruteForce<1, 1> },
+		{ 1, 3, &bilateralFilterBruteForce<1, 3> },
+		{ 2, 1, &bilateralFilterBruteForce<2, 1> },
+		{ 2, 3, &bilateralFilterBruteForce<2, 3> },
+		{ 4, 1, &bilateralFilterBruteForce<4, 1> },
+		{ 4, 3, &bilateralFilterBruteForce<4, 3> },
+		{ 8, 1, &bilateralFilterBruteForce<8, 1> },
+		{ 8, 3, &bilateralFilterBruteForce<8, 3> },
+		{ 16, 1, &bilateralFilterBruteForce<16, 1> },
+		{ 16, 3, &bilateralFilterBruteForce<16, 3> },
+	};
+
+
+	bool bilateralFilterBruteForce(const cv::Mat &src, cv::Mat &dst,
+		int radius, float range_param)
+	{
+		for (size_t i = 0; i < sizeof(brute_force_kernels) / sizeof(brute_force_kernels[0]); ++i) {
+			if (brute_force_kernels[i].radius == radius && brute_force_kernels[i].channels == src.channels()) {
+				brute_force_kernels[i].kernel(src, dst, range_param);
+				return true;
+			}
+		}
+
+		bilateralFilterBruteForceGeneric(src, dst, radius, range_param);
+		return false;
+	}
+
+
+	/**
+	* Box sums of a CV_32FC4 image over a (2 * radius + 1)^2 window clamped at the border.
+	* Rows are summed first, then columns; every thread owns a strip of columns
+	* in the second pass so the memory is still walked row by row.
+	*/
+	static void boxSum(const cv::Mat &src, cv::Mat &dst, int radius)
+	{
+		const int rows = src.rows, cols = src.cols;
+		const int column_strip = 64;
+		const cv::Vec4f zero(0.0f, 0.0f, 0.0f, 0.0f);
+		cv::Mat horizontal(rows, cols, CV_32FC4);
+		dst.create(rows, cols, CV_32FC4);
+
+		// running sums along rows
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y) {
+			const cv::Vec4f *s_ptr = src.ptr<cv::Vec4f>(y);
+			cv::Vec4f *h_ptr = horizontal.ptr<cv::Vec4f>(y);
+			cv::Vec4f sum = zero;
+			for (int x = 0; x < std::min(radius, cols); ++x) {
+				sum += s_ptr[x];
+			}
+			for (int x = 0; x < cols; ++x) {
+				if (x + radius < cols) sum += s_ptr[x + radius];
+				if (x - radius - 1 >= 0) sum -= s_ptr[x - radius - 1];
+				h_ptr[x] = sum;
+			}
+		}
+
+		// running sums along columns
+		const int strips = (cols + column_strip - 1) / column_strip;
+#pragma omp parallel for
+		for (int strip = 0; strip < strips; ++strip) {
+			const int x_begin = strip * column_strip;
+			const int x_end = std::min(cols, x_begin + column_strip);
+			std::vector<cv::Vec4f> sum(x_end - x_begin, zero);
+
+			for (int y = 0; y < std::min(radius, rows); ++y) {
+				const cv::Vec4f *h_ptr = horizontal.ptr<cv::Vec4f>(y);
+				for (int x = x_begin; x < x_end; ++x) sum[x - x_begin] += h_ptr[x];
+			}
+			for (int y = 0; y < rows; ++y) {
+				if (y + radius < rows) {
+					const cv::Vec4f *h_ptr = horizontal.ptr<cv::Vec4f>(y + radius);
+					for (int x = x_begin; x < x_end; ++x) sum[x - x_begin] += h_ptr[x];
+				}
+				if (y - radius - 1 >= 0) {
+					const cv::Vec4f *h_ptr = horizontal.ptr<cv::Vec4f>(y - radius - 1);
+					for (int x = x_begin; x < x_end; ++x) sum[x - x_begin] -= h_ptr[x];
+				}
+				cv::Vec4f *d_ptr = dst.ptr<cv::Vec4f>(y);
+				for (int x = x_begin; x < x_end; ++x) d_ptr[x] = sum[x - x_begin];
+			}
+		}
+	}
+
+
+	static inline float windowSize(int x, int y, int cols, int rows, int radius)
+	{
+		return static_cast<float>(
+			(std::min(x + radius, cols - 1) - std::max(x - radius, 0) + 1) *
+			(std::min(y + radius, rows - 1) - std::max(y - radius, 0) + 1));
+	}
+
+
+	void guidedFilter(const cv::Mat &src, cv::Mat &dst,
+		int radius, float epsilon)
+	{
+		const int rows = src.rows, cols = src.cols;
+
+		// guide I = L, filtered p = (L, a, b); p_L = I, so six moments are enough
+		cv::Mat moments(rows, cols, CV_32FC4); // (I, I*I, a, b)
+		cv::Mat cross(rows, cols, CV_32FC4);   // (I*a, I*b, 0, 0)
+
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y) {
+			const cv::Vec3f *s_ptr = src.ptr<cv::Vec3f>(y);
+			cv::Vec4f *m_ptr = moments.ptr<cv::Vec4f>(y);
+			cv::Vec4f *c_ptr = cross.ptr<cv::Vec4f>(y);
+			for (int x = 0; x < cols; ++x) {
+				const float i = s_ptr[x][0];
+				m_ptr[x] = cv::Vec4f(i, i * i, s_ptr[x][1], s_ptr[x][2]);
+				c_ptr[x] = cv::Vec4f(i * s_ptr[x][1], i * s_ptr[x][2], 0.0f, 0.0f);
+			}
+		}
+
+		cv::Mat moments_sum, cross_sum;
+		boxSum(moments, moments_sum, radius);
+		boxSum(cross, cross_sum, radius);
+
+		// linear coefficients q = A * I + B of every window, stored back in place
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y) {
+			cv::Vec4f *m_ptr = moments_sum.ptr<cv::Vec4f>(y);
+			cv::Vec4f *c_ptr = cross_sum.ptr<cv::Vec4f>(y);
+			for (int x = 0; x < cols; ++x) {
+				const float n = windowSize(x, y, cols, rows, radius);
+				const cv::Vec4f m = m_ptr[x] / n, c = c_ptr[x] / n;
+				const float mean_i = m[0];
+				const float denominator = m[1] - mean_i * mean_i + epsilon;
+				const float a_l = (m[1] - mean_i * mean_i) / denominator;
+				const float a_a = (c[0] - mean_i * m[2]) / denominator;
+				const float a_b = (c[1] - mean_i * m[3]) / denominator;
+				m_ptr[x] = cv::Vec4f(a_l, a_a, a_b, 0.0f);
+				c_ptr[x] = cv::Vec4f(mean_i - a_l * mean_i, m[2] - a_a * mean_i, m[3] - a_b * mean_i, 0.0f);
+			}
+		}
+
+		cv::Mat a_sum, b_sum;
+		boxSum(moments_sum, a_sum, radius);
+		boxSum(cross_sum, b_sum, radius);
+
+		dst.create(rows, cols, CV_32FC3);
+#pragma omp parallel for
+		for (int y = 0; y < rows; ++y) {
+			const cv::Vec3f *s_ptr = src.ptr<cv::Vec3f>(y);
+			const cv::Vec4f *a_ptr = a_sum.ptr<cv::Vec4f>(y);
+			const cv::Vec4f *b_ptr = b_sum.ptr<cv::Vec4f>(y);
+			cv::Vec3f *d_ptr = dst.ptr<cv::Vec3f>(y);
+			for (int x = 0; x < cols; ++x) {
+				const float n = windowSize(x, y, cols, rows, radius);
+				const float i = s_ptr[x][0];
+				d_ptr[x] = cv::Vec3f(
+					(a_ptr[x][0] * i + b_ptr[x][0]) / n,
+					(a_ptr[x][1] * i + b_ptr[x][1]) / n,
+					(a_ptr[x][2] * i + b_ptr[x][2]) / n);
+			}
+		}
+	}
+
+
+	float guidedFilterEpsilon(float range_param)
+	{
+		// exp(-d^2 * range_param) = exp(-d^2 / (2 * sigma_r^2))
+		if (range_param <= 0.0f)
+		{
+			return std::numeric_limits<float>::max();
+		}
+		return 0.5f / range_param;
+	}
+
+
+	void jointBilateralUpsample(const cv::Mat &low, const cv::Mat &low_guide, const cv::Mat &guide, cv::Mat &dst,
+		int radius, float range_param)
+	{
+		const float scale_x = static_cast<float>(low.cols) / guide.cols;
+		const float scale_y = static_cast<float>(low.rows) / guide.rows;
+		dst.create(guide.size(), CV_32FC3);
+
+#pragma omp parallel for
+		for (int y = 0; y < guide.rows; ++y) {
+			const float ly = (y + 0.5f) * scale_y - 0.5f;
+			const int cy = static_cast<int>(std::floor(ly + 0.5f));
+
+			for (int x = 0; x < guide.cols; ++x) {
+				const float lx = (x + 0.5f) * scale_x - 0.5f;
+				const int cx = static_cast<int>(std::floor(lx + 0.5f));
+				const cv::Vec3f center = guide.at<cv::Vec3f>(y, x);
+
+				cv::Vec3f sum(0.0f, 0.0f, 0.0f);
+				float normalization = 0.0f;
+
+				for (int wy = -radius; wy <= radius; ++wy) {
+					const int qy = std::min(std::max(cy + wy, 0), low.rows - 1);
+					for (int wx = -radius; wx <= radius; ++wx) {
+						const int qx = std::min(std::max(cx + wx, 0), low.cols - 1);
+
+						const cv::Vec3f difference = center - low_guide.at<cv::Vec3f>(qy, qx);
+						const float spatial = std::exp(-0.5f * ((qx - lx) * (qx - lx) + (qy - ly) * (qy - ly)) / radius);
+						const float weight = spatial * std::exp(-difference.dot(difference) * range_param);
+
+						sum += low.at<cv::Vec3f>(qy, qx) * weight;
+						normalization += weight;
+					}
+				}
+
+				dst.at<cv::Vec3f>(y, x) = (normalization > 0.0f) ?
+					sum * (1.0f / normalization) :
+					low.at<cv::Vec3f>(std::min(std::max(cy, 0), low.rows - 1), std::min(std::max(cx, 0), low.cols - 1));
+			}
+		}
+	}
+
+
+	double psnr(const cv::Mat &a, const cv::Mat &b, double peak)
+	{
+		const double error = cv::norm(a, b, cv::NORM_L2);
+		const double mse = error * error / (static_cast<double>(a.total()) * a.channels());
+		if (mse <= 0.0) {
+			return std::numeric_limits<double>::infinity();
+		}
+		return 10.0 * std::log10(peak * peak / mse);
+	}
+} // end of namespace cv_extend
@@ -0,0 +1,215 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#pragma once
+
+#include <opencv2/core/core.hpp>
+
+#include <array>
+#include <cmath>
+#include <utility>
+#include <vector>
+
+
+namespace cv_extend {
+
+	template<typename T, typename T_, typename T__>
+	inline
+		T clamp(const T_ min, const T__ max, const T x)
+	{
+		return
+			(x < static_cast<T>(min)) ? static_cast<T>(min) :
+			(x < static_cast<T>(max)) ? static_cast<T>(x) :
+			static_cast<T>(max);
+	}
+
+	template<typename T>
+	inline
+		T
+		trilinear_interpolation(const cv::Mat mat,
+			const double y,
+			const double x,
+			const double z)
+	{
+		const size_t height = mat.size[0];
+		const size_t width = mat.size[1];
+		const size_t depth = mat.size[2];
+
+		const size_t y_index = clamp(0, height - 1, static_cast<size_t>(y));
+		const size_t yy_index = clamp(0, height - 1, y_index + 1);
+		const size_t x_index = clamp(0, width - 1, static_cast<size_t>(x));
+		const size_t xx_index = clamp(0, width - 1, x_index + 1);
+		const size_t z_index = clamp(0, depth - 1, static_cast<size_t>(z));
+		const size_t zz_index = clamp(0, depth - 1, z_index + 1);
+		const double y_alpha = y - y_index;
+		const double x_alpha = x - x_index;
+		const double z_alpha = z - z_index;
+
+		return
+			(1.0 - y_alpha) * (1.0 - x_alpha) * (1.0 - z_alpha) * mat.at<T>(y_index, x_index, z_index) +
+			(1.0 - y_alpha) * x_alpha       * (1.0 - z_alpha) * mat.at<T>(y_index, xx_index, z_index) +
+			y_alpha       * (1.0 - x_alpha) * (1.0 - z_alpha) * mat.at<T>(yy_index, x_index, z_index) +
+			y_alpha       * x_alpha       * (1.0 - z_alpha) * mat.at<T>(yy_index, xx_index, z_index) +
+			(1.0 - y_alpha) * (1.0 - x_alpha) * z_alpha       * mat.at<T>(y_index, x_index, zz_index) +
+			(1.0 - y_alpha) * x_alpha       * z_alpha       * mat.at<T>(y_index, xx_index, zz_index) +
+			y_alpha       * (1.0 - x_alpha) * z_alpha       * mat.at<T>(yy_index, x_index, zz_index) +
+			y_alpha       * x_alpha       * z_alpha       * mat.at<T>(yy_index, xx_index, zz_index);
+
+	}
+
+
+	/**
+	* exp() usable in constant expressions - argument halving plus Taylor series.
+	*/
+	constexpr double constexpr_exp_series(const double x, const int n, const double term)
+	{
+		return n > 20 ? term : term + constexpr_exp_series(x, n + 1, term * x / (n + 1));
+	}
+
+	constexpr double square(const double v)
+	{
+		return v * v;
+	}
+
+	// one recursive call per halving - MSVC does not cache constexpr calls, two would double the work each step
+	constexpr double constexpr_exp(const double x)
+	{
+		return (x < -0.5 || x > 0.5) ?
+			square(constexpr_exp(x / 2)) :
+			constexpr_exp_series(x, 0, 1.0);
+	}
+
+	/**
+	* Spatial weights exp(-0.5 * (x^2 + y^2) / radius) of the (2 * Radius + 1)^2 window,
+	* same as bilateralFilter_basic, computed at compile time.
+	*/
+	template<int Radius>
+	struct spatial_weights
+	{
+		static constexpr int size = 2 * Radius + 1;
+
+		static constexpr float weight(const int i)
+		{
+			return static_cast<float>(constexpr_exp(-0.5 *
+				((i % size - Radius) * (i % size - Radius) + (i / size - Radius) * (i / size - Radius)) / Radius));
+		}
+
+		template<int... I>
+		static constexpr std::array<float, size * size> make(std::integer_sequence<int, I...>)
+		{
+			return { { weight(I)... } };
+		}
+
+		static constexpr std::array<float, size * size> values = make(std::make_integer_sequence<int, size * size>());
+	};
+
+	template<int Radius>
+	constexpr std::array<float, spatial_weights<Radius>::size * spatial_weights<Radius>::size> spatial_weights<Radius>::values;
+
+
+	/**
+	* Brute-force bilateral filter with the radius and channel count known at compile time.
+	* src is CV_32FC(Channels), dst is smaller by 2 * Radius (no halo), like bilateralFilter_basic.
+	*/
+	template<int Radius, int Channels>
+	void bilateralFilterBruteForce(const cv::Mat &src, cv::Mat &dst, const float range_param)
+	{
+		const int size = spatial_weights<Radius>::size;
+		const std::array<float, size * size> &spatial = spatial_weights<Radius>::values;
+		const int dst_rows = src.rows - 2 * Radius, dst_cols = src.cols - 2 * Radius;
+		dst.create(dst_rows, dst_cols, CV_MAKETYPE(CV_32F, Channels));
+
+#pragma omp parallel for
+		for (int y = 0; y < dst_rows; ++y) {
+			float *d_ptr = dst.ptr<float>(y);
+			for (int x = 0; x < dst_cols; ++x) {
+				const float *center = src.ptr<float>(y + Radius) + (x + Radius) * Channels;
+				float sum[Channels] = {};
+				float normalization = 0.0f;
+
+				for (int wy = 0; wy < size; ++wy) {
+					const float *s_ptr = src.ptr<float>(y + wy) + x * Channels;
+					for (int wx = 0; wx < size; ++wx, s_ptr += Channels) {
+						float distance = 0.0f;
+						for (int c = 0; c < Channels; ++c) {
+							distance += (center[c] - s_ptr[c]) * (center[c] - s_ptr[c]);
+						}
+						const float weight = spatial[wy * size + wx] * std::exp(-distance * range_param);
+						for (int c = 0; c < Channels; ++c) {
+							sum[c] += s_ptr[c] * weight;
+						}
+						normalization += weight;
+					}
+				}
+
+				for (int c = 0; c < Channels; ++c) {
+					d_ptr[x * Channels + c] = sum[c] / normalization;
+				}
+			}
+		}
+	}
+
+	/**
+	* Brute-force bilateral filter of a CV_32FC1 or CV_32FC3 image, dst is smaller by 2 * radius.
+	* Radii 1, 2, 4, 8 and 16 are dispatched to bilateralFilterBruteForce<Radius, Channels>,
+	* other radii run the generic version with runtime loop bounds.
+	* Returns true when a specialised kernel was used.
+	*/
+	bool bilateralFilterBruteForce(const cv::Mat &src, cv::Mat &dst,
+		int radius, float range_param);
+
+
+	/**
+	* Bilateral grid filter of a single channel image.
+	*
+	* The grid cell is sampling_space pixels and sampling_color intensity levels
+	* (0 = the sigma, the original grid). The blur is sigma / sampling cells wide on each axis,
+	* so a finer grid is more accurate and a coarser one faster for the same filter.
+	*/
+	void bilateralFilter(cv::Mat1f src, cv::Mat1f dst,
+		double sigma_color, double sigma_space,
+		double sampling_color = 0, double sampling_space = 0);
+
+	/**
+	* Normalised weights of the grid blur along one axis, sigma in grid cells.
+	* sigma = 1 is the [1 2 1]/4 kernel applied twice, otherwise a sampled Gaussian
+	* truncated at 2 * sigma (at least one cell).
+	*/
+	std::vector<float> gridBlurWeights(double sigma_cells);
+
+
+	/**
+	* Guided filter (He et al.) of a CIE-Lab CV_32FC3 image, guided by its L channel.
+	*
+	* Box means are computed by running sums, so the cost does not depend on the radius.
+	* The window is clamped at the image border, dst has the same size as src.
+	*/
+	void guidedFilter(const cv::Mat &src, cv::Mat &dst,
+		int radius, float epsilon);
+
+	/**
+	* Maps the range parameter of the bilateral kernels (exp(-d^2 * range_param))
+	* onto the guided filter regularisation epsilon (sigma_r^2).
+	*/
+	float guidedFilterEpsilon(float range_param);
+
+
+	/**
+	* Joint bilateral upsampling (Kopf et al.) of a filtered low resolution CV_32FC3 image.
+	*
+	* Every output pixel averages the (2 * radius + 1)^2 nearest low resolution samples,
+	* weighted by the spatial distance in low resolution pixels and by the range distance
+	* between the full resolution guide and the low resolution guide (the unfiltered
+	* low resolution input). dst has the size of guide.
+	*/
+	void jointBilateralUpsample(const cv::Mat &low, const cv::Mat &low_guide, const cv::Mat &guide, cv::Mat &dst,
+		int radius, float range_param);
+
+	/**
+	* Peak signal-to-noise ratio of two images of the same size and type [dB].
+	*/
+	double psnr(const cv::Mat &a, const cv::Mat &b, double peak);
+} // end of namespace cv_extend
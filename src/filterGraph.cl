@@ -0,0 +1,49 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+/**
+ * Filter graph - helpers of the point-wise operations.
+ *
+ * The operations are fused into the output of the existing filter kernels: the program is built
+ * from a header generated by FilterGraph, this file and bilateralFilter_basic.cl or bilateralGrid.cl.
+ * The header defines:
+ *   GRAPH_OPS(value, source_pix)   - the operations in order; value is the filtered pixel,
+ *                                    source_pix the input pixel, both float3 Lab in [0, 1]
+ *   GRAPH_OPS_L(value, source_pix) - the same for the L channel only (float)
+ *   GRAPH_OUTPUT, GRAPH_STORE      - the output type and the store (packed uchar3 or float4)
+ */
+
+float srgbGamma(float c)
+{
+	c = clamp(c, 0.0f, 1.0f);
+	return (c <= 0.0031308f) ? 12.92f * c : 1.055f * pow(c, 1.0f / 2.4f) - 0.055f;
+}
+
+float labInverse(float t)
+{
+	return (t > 6.0f / 29.0f) ? t * t * t : 3.0f * (6.0f / 29.0f) * (6.0f / 29.0f) * (t - 4.0f / 29.0f);
+}
+
+/**
+ * Lab in the OpenCV 8-bit encoding scaled to [0, 1] -> BGR in [0, 1] (D65, sRGB, as cv::cvtColor).
+ */
+float3 labToBGR(float3 lab)
+{
+	float l = lab.x * 100.0f;
+	float a = lab.y * 255.0f - 128.0f;
+	float b = lab.z * 255.0f - 128.0f;
+
+	float fy = (l + 16.0f) / 116.0f;
+	float3 xyz = (float3)(
+		0.950456f * labInverse(fy + a / 500.0f),
+		labInverse(fy),
+		1.088754f * labInverse(fy - b / 200.0f));
+
+	return (float3)(
+		srgbGamma(dot((float3)(0.055648f, -0.204043f, 1.057311f), xyz)),
+		srgbGamma(dot((float3)(-0.969256f, 1.875991f, 0.041556f), xyz)),
+		srgbGamma(dot((float3)(3.240479f, -1.53715f, -0.498535f), xyz)));
+}
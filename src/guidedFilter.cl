@@ -0,0 +1,195 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+/**
+ * Guided filter (He et al.) - guide I = L, filtered p = (L, a, b).
+ *
+ * Box sums are built from a parallel prefix sum along rows (one work-group per row)
+ * followed by running sums along columns (one work-item per column, coalesced).
+ * The cost per pixel does not depend on the radius.
+ */
+
+float windowSize(int x, int y, int width, int height, int radius)
+{
+	return (float)((min(x + radius, width - 1) - max(x - radius, 0) + 1) *
+		(min(y + radius, height - 1) - max(y - radius, 0) + 1));
+}
+
+/**
+ * @brief Per-pixel moments of the guide and the filtered channels.
+ *
+ * @param Vstupní obrazová data. Barevný formát CIE-LAB.
+ * @param Výstup (I, I*I, a, b).
+ * @param Výstup (I*a, I*b, 0, 0).
+ */
+__kernel void guidedFilter_prepare(
+	__global float3 *source,
+	__global float4 *moments,
+	__global float4 *cross,
+	const int width,
+	const int height)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+		float3 pix = source[index];
+
+		moments[index] = (float4)(pix.x, pix.x * pix.x, pix.y, pix.z);
+		cross[index] = (float4)(pix.x * pix.y, pix.x * pix.z, 0.0f, 0.0f);
+	}
+}
+
+/**
+ * @brief Inclusive prefix sum of every row (Hillis-Steele scan in local memory).
+ *
+ * Global size (local_size, height), one work-group per row. The row is processed
+ * in chunks of local_size elements, the total of the previous chunks is carried over.
+ */
+__kernel void guidedFilter_scanRows(
+	__global float4 *source,
+	__global float4 *prefix,
+	const int width,
+	__local float4 *scratch)
+{
+	int global_y = get_global_id(1);
+	int local_x = get_local_id(0);
+	int local_size = get_local_size(0);
+
+	__global float4 *source_row = source + global_y * width;
+	__global float4 *prefix_row = prefix + global_y * width;
+
+	float4 carry = 0.0f;
+	for (int base = 0; base < width; base += local_size)
+	{
+		int x = base + local_x;
+		scratch[local_x] = (x < width) ? source_row[x] : (float4)(0.0f);
+		barrier(CLK_LOCAL_MEM_FENCE);
+
+		for (int offset = 1; offset < local_size; offset <<= 1)
+		{
+			float4 value = (local_x >= offset) ? scratch[local_x - offset] : (float4)(0.0f);
+			barrier(CLK_LOCAL_MEM_FENCE);
+			scratch[local_x] += value;
+			barrier(CLK_LOCAL_MEM_FENCE);
+		}
+
+		if (x < width)
+		{
+			prefix_row[x] = carry + scratch[local_x];
+		}
+		carry += scratch[local_size - 1];
+		barrier(CLK_LOCAL_MEM_FENCE);
+	}
+}
+
+float4 rowBox(__global float4 *prefix_row, int x, int width, int radius)
+{
+	int left = x - radius - 1;
+	return prefix_row[min(x + radius, width - 1)] - ((left >= 0) ? prefix_row[left] : (float4)(0.0f));
+}
+
+/**
+ * @brief Box sums from the row prefix sums - running sum along every column.
+ *
+ * Neighbouring work-items handle neighbouring columns, so every row access is coalesced.
+ */
+__kernel void guidedFilter_boxColumns(
+	__global float4 *prefix,
+	__global float4 *box,
+	const int width,
+	const int height,
+	const int radius)
+{
+	int global_x = get_global_id(0);
+
+	if (global_x < width)
+	{
+		float4 sum = 0.0f;
+		for (int y = 0; y < min(radius, height); y++)
+		{
+			sum += rowBox(prefix + y * width, global_x, width, radius);
+		}
+
+		for (int y = 0; y < height; y++)
+		{
+			if (y + radius < height)
+			{
+				sum += rowBox(prefix + (y + radius) * width, global_x, width, radius);
+			}
+			if (y - radius - 1 >= 0)
+			{
+				sum -= rowBox(prefix + (y - radius - 1) * width, global_x, width, radius);
+			}
+			box[y * width + global_x] = sum;
+		}
+	}
+}
+
+/**
+ * @brief Linear coefficients q = A * I + B of every window, computed in place.
+ *
+ * On input the box sums of (I, I*I, a, b) and (I*a, I*b, 0, 0),
+ * on output (A_L, A_a, A_b, 0) and (B_L, B_a, B_b, 0).
+ */
+__kernel void guidedFilter_coefficients(
+	__global float4 *moments,
+	__global float4 *cross,
+	const int width,
+	const int height,
+	const int radius,
+	const float epsilon)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+		float n = windowSize(global_x, global_y, width, height, radius);
+		float4 m = moments[index] / n;
+		float4 c = cross[index] / n;
+
+		float mean_i = m.x;
+		float variance = m.y - mean_i * mean_i;
+		float denominator = variance + epsilon;
+
+		float4 a = (float4)(variance, c.x - mean_i * m.z, c.y - mean_i * m.w, 0.0f) / denominator;
+		float4 b = (float4)(mean_i, m.z, m.w, 0.0f) - a * mean_i;
+
+		moments[index] = a;
+		cross[index] = b;
+	}
+}
+
+/**
+ * @brief Výstup filtru q = mean(A) * I + mean(B).
+ *
+ * @param Vstupní obrazová data. Barevný formát CIE-LAB.
+ * @param Výstupní obrazová data. Barevný formát CIE-LAB. Rozměry jsou stejné jako u vstupu.
+ */
+__kernel void guidedFilter_output(
+	__global float3 *source,
+	__global float3 *destination,
+	__global float4 *a_sum,
+	__global float4 *b_sum,
+	const int width,
+	const int height,
+	const int radius)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		int index = global_y * width + global_x;
+		float n = windowSize(global_x, global_y, width, height, radius);
+
+		destination[index] = (a_sum[index].xyz * source[index].x + b_sum[index].xyz) / n;
+	}
+}
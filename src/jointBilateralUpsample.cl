@@ -0,0 +1,68 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+#define POW2(x) ((x) * (x))
+
+/**
+ * @brief Joint bilateral upsampling - same weights as cv_extend::jointBilateralUpsample.
+ *
+ * Every output pixel averages the (2 * radius + 1)^2 nearest low resolution samples, the range
+ * weight compares the full resolution guide with the unfiltered low resolution input.
+ *
+ * @param Filtrovaný obraz v nízkém rozlišení (low_width x low_height).
+ * @param Nefiltrovaný obraz v nízkém rozlišení.
+ * @param Vodicí obraz v plném rozlišení (width x height).
+ * @param Výstup v plném rozlišení.
+ */
+__kernel void jointBilateralUpsample(
+	__global float3 *low,
+	__global float3 *low_guide,
+	__global float3 *guide,
+	__global float3 *destination,
+	const int width,
+	const int height,
+	const int low_width,
+	const int low_height,
+	const int radius,
+	const float range_param)
+{
+	int global_x = get_global_id(0);
+	int global_y = get_global_id(1);
+
+	if ((global_x < width) && (global_y < height))
+	{
+		const float lx = (global_x + 0.5f) * ((float)low_width / width) - 0.5f;
+		const float ly = (global_y + 0.5f) * ((float)low_height / height) - 0.5f;
+		const int cx = (int)floor(lx + 0.5f);
+		const int cy = (int)floor(ly + 0.5f);
+		float3 center_pix = guide[global_y * width + global_x];
+
+		float3 sum = 0.0f;
+		float normalization_term = 0.0f;
+
+		for (int local_y = -radius; local_y <= radius; local_y++)
+		{
+			int qy = clamp(cy + local_y, 0, low_height - 1);
+
+			for (int local_x = -radius; local_x <= radius; local_x++)
+			{
+				int qx = clamp(cx + local_x, 0, low_width - 1);
+				int index = qy * low_width + qx;
+
+				float3 difference = center_pix - low_guide[index];
+				float spatial_weight = exp(-0.5f * (POW2(qx - lx) + POW2(qy - ly)) / radius);
+				float total_weight = spatial_weight * exp(-dot(difference, difference) * range_param);
+
+				sum += low[index] * total_weight;
+				normalization_term += total_weight;
+			}
+		}
+
+		destination[global_y * width + global_x] = (normalization_term > 0.0f) ?
+			sum / normalization_term :
+			low[clamp(cy, 0, low_height - 1) * low_width + clamp(cx, 0, low_width - 1)];
+	}
+}
@@ -15,6 +15,10 @@
 #include <fstream>
 #include <sstream>
 #include <iomanip>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <algorithm>
 
 #include <CL/cl.hpp>
 #include "oclHelper.h"
@@ -24,6 +28,23 @@
 #include <opencv2/imgproc/imgproc.hpp>
 
 #include "MyMat.hpp"
+#include "cv_extend.hpp"
+#include "GuidedFilterCL.hpp"
+#include "BilateralFilterCL.hpp"
+#include "BilateralGridCL.hpp"
+#include "JointUpsampleCL.hpp"
+#include "Trace.hpp"
+#include "Roofline.hpp"
+#include "MultiDeviceFilter.hpp"
+#include "ProgressiveFilter.hpp"
+#include "VideoFilter.hpp"
+#include "IncrementalFilter.hpp"
+#include "FilterGraph.hpp"
+#include "BatchFilter.hpp"
+#include "BatchPipeline.hpp"
+#include "RawImage.hpp"
+#include "FilterDaemon.hpp"
+#include "DeviceFilter.hpp"
 
 #ifdef _WIN32
 #include <windows.h>
@@ -34,161 +55,1629 @@
 #define SELECTED_DEVICE_TYPE CL_DEVICE_TYPE_GPU
 
 
+void printHelp(void)
+{
+	std::cerr << "Špatné parametry spuštìní programu. Oèekávám" << std::endl <<
+		"program.exe vstupniObraz radius barvy vystupniObraz [-b] [-g] [-c] [-t trace.json] [-r] [-e jadro] [-m [-n opakovani]] [-s] [-k blok] [-w mez] [-l] [-u s] [-p ms] [-d vzorkovani] [-v [-f WxH] [-o prah]] [-i tahy] [-x hodnoty] [--iterations N] [-a operace] [-j nahledy] [-q vlakna] [--daemon socket] [--client socket [--shutdown]] [--chain]" << std::endl <<
+		"   vstupniObraz  Cesta ke vstupnímu obrázku." << std::endl <<
+		"   radius        Parametr filtru - prostorový (radius)." << std::endl <<
+		"   vstupniObraz  Parametr filtru - podobnost barev." << std::endl <<
+		"   vystupniObraz Cesta k vstupnímu obrázku." << std::endl <<
+		"   -b            Benchmark - do názvu výstupu se vloží doba zpracování." << std::endl <<
+		"   -g            Kernel s radiusem za běhu i pro radiusy, pro které se sestavuje varianta." << std::endl <<
+		"   -c            Porovnání s hostitelskou implementací (hrubá síla, OpenMP)." << std::endl <<
+		"   -t soubor     Záznam průběhu (Chrome trace_event JSON, chrome://tracing)." << std::endl <<
+		"   -r            Roofline report - dosažené GB/s a GFLOP/s kernelů proti špičce zařízení." << std::endl <<
+		"   -e jadro      basic (výchozí) - bilaterální filtr," << std::endl <<
+		"                 guided - guided filter, epsilon = 1 / (2 * barvy)," << std::endl <<
+		"                 grid - bilaterální mřížka na šedotónovém obrázku (radius = sigma_space, barvy = sigma_color)." << std::endl <<
+		"   -m            Jádro basic rozdělené po pásech řádků mezi všechna zařízení OpenCL." << std::endl <<
+		"   -n opakovani  Počet opakování s -m, rozdělení se vyvažuje podle změřené propustnosti." << std::endl <<
+		"   -s            S -e grid porovná způsoby splatu mřížky pro několik sigma_space." << std::endl <<
+		"   -k blok       Blok výstupů na pracovní položku jádra basic, např. 2x2, 2x1, 4x1 (1x1 = bez blokování)." << std::endl <<
+		"                 Výchozí tvar se volí podle zařízení." << std::endl <<
+		"   -w mez        Jádro basic navíc s řídkým oknem - váhy s prostorovou vahou alespoň mez (0 < mez <= 1)," << std::endl <<
+		"                 nebo circle pro kruhové okno. Vypíše počet vah a chybu proti plnému oknu." << std::endl <<
+		"   -l            Jen kanál L (jádra basic a grid), a/b zůstanou z původního obrázku." << std::endl <<
+		"   -u s          Jádro basic v rozlišení zmenšeném s-krát a joint bilateral upsampling." << std::endl <<
+		"                 Vypíše zrychlení a chybu pro s = 2, 4, 8, výstup má velikost vstupu." << std::endl <<
+		"   -p ms         Postupný výpočet (hrubá mřížka, mřížka, hrubá síla) s cílovou latencí první úrovně." << std::endl <<
+		"                 Simuluje rychlé změny parametru barvy, zastaralé požadavky se ruší." << std::endl <<
+		"   -d vzorkovani S -e grid velikost buňky mřížky nezávisle na sigma, prostor x barvy, např. 8x16." << std::endl <<
+		"                 S -b vypíše doby, paměť mřížky a PSNR proti hrubé síle pro několik vzorkování." << std::endl <<
+		"   -v            Video - vstup a výstup jsou videa (cv::VideoCapture / cv::VideoWriter, MJPG)," << std::endl <<
+		"                 - místo cesty jsou surové snímky BGR24 na stdin / stdout. Jádra basic a grid (jen L)." << std::endl <<
+		"   -f WxH        Rozměry surových snímků ze stdin." << std::endl <<
+		"   -o prah       S -e grid mřížka zůstává z předchozího snímku, znovu se splatují jen dlaždice" << std::endl <<
+		"                 se změnou L (0-255) větší než prah." << std::endl <<
+		"   -i tahy       Přírůstkový přepočet (jádra basic a grid) - simuluje tahy štětcem, přepočítá" << std::endl <<
+		"                 jen jejich okolí a porovná výsledek s výpočtem celého obrázku." << std::endl <<
+		"   -x hodnoty    Sweep parametru barev, hodnoty oddělené čárkou (basic: barvy, grid: sigma_color)." << std::endl <<
+		"                 Okno / splat se zpracuje jednou pro všechny hodnoty, výstupy se uloží s hodnotou v názvu." << std::endl <<
+		"   --iterations N  Jádro basic N-krát za sebou na zařízení (ping-pong bufferů), okraje se opakují," << std::endl <<
+		"                 výstup má velikost vstupu a čte se jen výsledek poslední iterace." << std::endl <<
+		"   -a operace    Bodové operace po filtru (jádra basic a grid) sloučené do jednoho kernelu, oddělené čárkou:" << std::endl <<
+		"                 detail, boost=k (zesílení detailu), contrast=k (kanál L), bgr (Lab -> BGR), u8 (kvantizace)." << std::endl <<
+		"                 Porovná se samostatnými průchody na hostiteli. Jádro grid filtruje jen kanál L." << std::endl <<
+		"                 S -l (jádro basic) jen kanál L a operace detail, boost, contrast." << std::endl <<
+		"   -j nahledy    Jádro basic pro daný počet náhledů (výřezy 96-128 px) po dávkách - jedno spuštění" << std::endl <<
+		"                 kernelu na dávku proti jednomu na obrázek. Výstupem je mozaika náhledů." << std::endl <<
+		"   -q vlakna     Dávka souborů jádrem basic - vstup je seznam obrázků (cesta na řádek), výstupy" << std::endl <<
+		"                 vystup_00000.png, ... Dekódování a kódování v daném počtu vláken, vypíše vytížení fází." << std::endl <<
+		"   --daemon socket Démon - kontext a buffery zůstávají, úlohy přijímá na Unix socketu, obrazová data" << std::endl <<
+		"                 ve sdílené paměti (POSIX shm). Parametry úlohy posílá klient, obrázky se neukládají." << std::endl <<
+		"   --client socket Klient démona - pošle vstup jádrem basic nebo grid (jen L), -n opakování," << std::endl <<
+		"                 vypíše dobu odezvy a uloží výstup (velikost vstupu)." << std::endl <<
+		"   --shutdown    S --client nakonec ukončí démona (vstup - = jen ukončení)." << std::endl <<
+		"   --chain       Jádro basic přes DeviceFilter (cl_mem / cl_event) - dva průchody zřetězené událostmi" << std::endl <<
+		"                 na zařízení, porovná se s cestou basic. Výstup má velikost vstupu." << std::endl <<
+		"Soubory s příponou .rawf jsou surové Lab float mapované do paměti (RawImage). Pokud jsou vstup" << std::endl <<
+		"i výstup .rawf, jádro basic čte a zapisuje mapování přímo a výstup má velikost vstupu." << std::endl;
+}
+
+/**
+ * Do názvu výstupního souboru vloží dobu zpracování (benchmark).
+ */
+std::string benchmarkFileName(const std::string &outputFileName, double time)
+{
+	// Odhodíme příponu
+	std::string prefix = outputFileName.substr(0, outputFileName.length() - 4);
+
+	std::stringstream ss;
+	ss << prefix << "_t" << (unsigned int)(time * 1000) << ".png";
+	return ss.str();
+}
+
+/**
+ * Šedotónová verze vstupu (float 0-255) pro bilaterální mřížku.
+ */
+cv::Mat grayScale(MyMat &img_source)
+{
+	cv::Mat im_lab_uint8, im_rgb_uint8, im_gs_uint8, im_gs_float;
+
+	double gray_begin = getTime();
+
+	// lab float->lab uint8
+	img_source.getMat().convertTo(im_lab_uint8, CV_8UC3, 255.0);
+
+	// lab uint8 -> rgb uint8
+	cv::cvtColor(im_lab_uint8, im_rgb_uint8, 57 /*cl::COLOR_Lab2RGB*/);
+
+	// rgb uint8 -> gs uint8
+	cv::cvtColor(im_rgb_uint8, im_gs_uint8, 7 /*cl::COLOR_RGB2GRAY*/);
+
+	// gs uint8 -> gs float
+	im_gs_uint8.convertTo(im_gs_float, CV_32FC1);
+	Trace::addSpan("Lab -> gray scale", "host", gray_begin, getTime());
+
+	return im_gs_float;
+}
+
+/**
+ * Guided filter - hostitelská (OpenMP) i OpenCL verze.
+ * Výstup má stejnou velikost jako vstup, uloží se výsledek OpenCL.
+ */
+void runGuided(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	MyMat &img_source, cl_float3 *img_source_fl3, int param_space, float param_range,
+	std::string outputFileName, bool benchmark, bool roofline_report)
+{
+	cl_int err_msg;
+	const float epsilon = cv_extend::guidedFilterEpsilon(param_range);
+	const int rows = img_source.getMat().rows;
+	const int cols = img_source.getMat().cols;
+
+	MyMat img_host(rows, cols);
+	double host_time = getTime();
+	{
+		TRACE_SCOPE("cv_extend::guidedFilter");
+		cv_extend::guidedFilter(img_source.getMat(), img_host.getMat(), param_space, epsilon);
+	}
+	host_time = getTime() - host_time;
+
+	GuidedFilterCL guided(context, device, queue);
+
+	MyMat img_dest(rows, cols);
+	cl_float3 *img_dest_fl3 = img_dest.getData();
+
+	cl::Buffer img_source_dev(context, CL_MEM_READ_ONLY, (size_t)img_source.getDataSize(), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_source");
+	cl::Buffer img_dest_dev(context, CL_MEM_WRITE_ONLY, (size_t)img_dest.getDataSize(), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_dest");
+
+	cl::Event img_source_event, img_dest_event;
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(
+		img_source_dev, CL_FALSE, 0, img_source.getDataSize(), img_source_fl3, NULL, &img_source_event
+	), "clEnqueueWriteBuffer: img_source");
+	Trace::addEvent("write img_source", img_source_event);
+
+	guided.enqueue(img_source_dev, img_dest_dev, cols, rows, param_space, epsilon);
+
+	clPrintErrorExit(queue.enqueueReadBuffer(
+		img_dest_dev, CL_FALSE, 0, img_dest.getDataSize(), img_dest_fl3, NULL, &img_dest_event
+	), "clEnqueueReadBuffer: img_dest");
+	Trace::addEvent("read img_dest", img_dest_event);
+
+	{
+		TRACE_SCOPE("queue.finish");
+		queue.finish();
+	}
+
+	const double copy_time = getEventTime(img_source_event) + getEventTime(img_dest_event);
+	const double kernel_time = guided.getKernelTime();
+
+	printf("Timers: ocl:%.3fms ocl_copy:%.3fms ocl_kernel:%.3fms host:%.3fms\n",
+		(copy_time + kernel_time) * 1000,
+		copy_time * 1000,
+		kernel_time * 1000,
+		host_time * 1000);
+
+	img_dest.setData(img_dest_fl3);
+	printf("Host/OpenCL max difference: %f\n", cv::norm(img_host.getMat(), img_dest.getMat(), cv::NORM_INF));
+
+	if (roofline_report)
+	{
+		Roofline roofline;
+		for (size_t i = 0; i < guided.getKernelEvents().size(); i++)
+		{
+			const std::string &name = guided.getKernelNames()[i];
+			roofline.add(name, guided.getKernelEvents()[i], Roofline::guidedCost(name, cols, rows, guided.getScanLocalSize()));
+		}
+		roofline.print(Roofline::measurePeak(context, device, queue));
+	}
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, kernel_time);
+	}
+
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Porovnání způsobů splatu mřížky pro několik sigma_space. Každá kombinace běží dvakrát,
+ * rozdíl obou výsledků ukazuje (ne)reprodukovatelnost atomického sčítání.
+ */
+void benchmarkSplat(cl::CommandQueue &queue, BilateralGridCL &grid, cl::Buffer &source, cl::Buffer &destination,
+	int width, int height, float source_min, float source_max, float sigma_color)
+{
+	const int sigmas[] = { 2, 4, 8, 16, 32 };
+	const BilateralGridCL::SplatMode modes[] = { BilateralGridCL::SPLAT_GLOBAL, BilateralGridCL::SPLAT_LOCAL, BilateralGridCL::SPLAT_SORTED };
+	const size_t plane_size = sizeof(float) * width * height;
+
+	cv::Mat first(height, width, CV_32FC1), second(height, width, CV_32FC1);
+
+	printf("\nSplat benchmark:\n");
+	printf("%8s %-16s %12s %12s %14s\n", "sigma", "splat", "splat [ms]", "total [ms]", "repeat diff");
+
+	for (size_t i = 0; i < sizeof(sigmas) / sizeof(sigmas[0]); i++)
+	{
+		for (size_t j = 0; j < sizeof(modes) / sizeof(modes[0]); j++)
+		{
+			grid.setSplatMode(modes[j]);
+
+			grid.enqueue(source, destination, width, height, source_min, source_max, (float)sigmas[i], sigma_color);
+			clPrintErrorExit(queue.enqueueReadBuffer(destination, CL_TRUE, 0, plane_size, first.ptr<float>()), "clEnqueueReadBuffer: splat benchmark");
+
+			grid.enqueue(source, destination, width, height, source_min, source_max, (float)sigmas[i], sigma_color);
+			clPrintErrorExit(queue.enqueueReadBuffer(destination, CL_TRUE, 0, plane_size, second.ptr<float>()), "clEnqueueReadBuffer: splat benchmark");
+
+			printf("%8d %-16s %12.3f %12.3f %14g\n",
+				sigmas[i],
+				BilateralGridCL::splatModeName(grid.getSplatPath()),
+				grid.getSplatTime() * 1000,
+				grid.getKernelTime() * 1000,
+				cv::norm(first, second, cv::NORM_INF));
+		}
+	}
+
+	grid.setSplatMode(BilateralGridCL::SPLAT_LOCAL);
+}
+
+/**
+ * Vzorkování mřížky nezávislé na sigma - doba běhu (OpenCL i hostitel), velikost mřížky
+ * a PSNR proti hrubé síle (cv::bilateralFilter s oknem 3 sigma) pro několik velikostí buňky.
+ */
+void benchmarkSampling(cl::CommandQueue &queue, BilateralGridCL &grid, cl::Buffer &source, cl::Buffer &destination,
+	const cv::Mat &im_gs_float, float source_min, float source_max, float sigma_space, float sigma_color)
+{
+	const float factors[] = { 0.5f, 1.0f, 2.0f };
+	const int width = im_gs_float.cols, height = im_gs_float.rows;
+	const size_t plane_size = sizeof(float) * width * height;
+
+	cv::Mat reference;
+	{
+		TRACE_SCOPE("cv::bilateralFilter");
+		const int diameter = 2 * (int)std::ceil(3 * sigma_space) + 1;
+		cv::bilateralFilter(im_gs_float, reference, diameter, sigma_color, sigma_space, cv::BORDER_REPLICATE);
+	}
+
+	cv::Mat result(height, width, CV_32FC1), host_result(height, width, CV_32FC1);
+
+	printf("\nSampling sweep (sigma_space %.1f, sigma_color %.1f):\n", sigma_space, sigma_color);
+	printf("%10s %10s %16s %12s %12s %12s %10s %10s\n",
+		"s_space", "s_color", "grid", "memory [kB]", "ocl [ms]", "host [ms]", "PSNR ocl", "PSNR host");
+
+	for (float space_factor : factors)
+	{
+		for (float color_factor : factors)
+		{
+			const float sampling_space = sigma_space * space_factor;
+			const float sampling_color = sigma_color * color_factor;
+
+			grid.enqueue(source, destination, width, height, source_min, source_max, sigma_space, sigma_color, sampling_space, sampling_color);
+			clPrintErrorExit(queue.enqueueReadBuffer(destination, CL_TRUE, 0, plane_size, result.ptr<float>()), "clEnqueueReadBuffer: sampling sweep");
+
+			double host_time = getTime();
+			cv_extend::bilateralFilter(im_gs_float, host_result, sigma_color, sigma_space, sampling_color, sampling_space);
+			host_time = getTime() - host_time;
+
+			char dims[32];
+			sprintf(dims, "%dx%dx%d", grid.getSmallHeight(), grid.getSmallWidth(), grid.getSmallDepth());
+
+			printf("%10.2f %10.2f %16s %12.1f %12.3f %12.3f %10.2f %10.2f\n",
+				sampling_space,
+				sampling_color,
+				dims,
+				grid.getGridBytes() / 1024.0,
+				grid.getKernelTime() * 1000,
+				host_time * 1000,
+				cv_extend::psnr(result, reference, 255.0),
+				cv_extend::psnr(host_result, reference, 255.0));
+		}
+	}
+}
+
+/**
+ * Bilaterální mřížka na šedotónovém obrázku - hostitelská verze (cv_extend::bilateralFilter)
+ * i OpenCL (BilateralGridCL). Uloží se šedotónový výsledek OpenCL.
+ * sampling_space a sampling_color je velikost buňky mřížky (0 = sigma).
+ */
+void runGrid(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	MyMat &img_source, int param_space, float param_range, float sampling_space, float sampling_color,
+	std::string outputFileName, bool benchmark, bool roofline_report, bool splat_benchmark, bool lightness_only)
+{
+	cl_int err_msg;
+
+	// L-only: kanál L ve stejném rozsahu jako šedotónový obraz (0-255), a/b zůstanou původní
+	cv::Mat im_gs_float = lightness_only ? cv::Mat(img_source.getLightness() * 255.0) : grayScale(img_source);
+	const int rows = im_gs_float.rows;
+	const int cols = im_gs_float.cols;
+	const size_t plane_size = sizeof(float) * rows * cols;
+
+	double src_min, src_max;
+	cv::minMaxLoc(im_gs_float, &src_min, &src_max);
+
+	cv::Mat img_host(im_gs_float.size(), CV_32FC1);
+	double host_time = getTime();
+	{
+		TRACE_SCOPE("cv_extend::bilateralFilter");
+		cv_extend::bilateralFilter(im_gs_float, img_host, param_range, param_space, sampling_color, sampling_space);
+	}
+	host_time = getTime() - host_time;
+
+	BilateralGridCL grid(context, device, queue);
+
+	cv::Mat img_dest(im_gs_float.size(), CV_32FC1);
+
+	cl::Buffer img_source_dev(context, CL_MEM_READ_ONLY, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_source");
+	cl::Buffer img_dest_dev(context, CL_MEM_WRITE_ONLY, plane_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_dest");
+
+	cl::Event img_source_event, img_dest_event;
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(
+		img_source_dev, CL_FALSE, 0, plane_size, im_gs_float.ptr<float>(), NULL, &img_source_event
+	), "clEnqueueWriteBuffer: img_source");
+	Trace::addEvent("write img_source", img_source_event);
+
+	grid.enqueue(img_source_dev, img_dest_dev, cols, rows, (float)src_min, (float)src_max, (float)param_space, param_range,
+		sampling_space, sampling_color);
+
+	clPrintErrorExit(queue.enqueueReadBuffer(
+		img_dest_dev, CL_FALSE, 0, plane_size, img_dest.ptr<float>(), NULL, &img_dest_event
+	), "clEnqueueReadBuffer: img_dest");
+	Trace::addEvent("read img_dest", img_dest_event);
+
+	{
+		TRACE_SCOPE("queue.finish");
+		queue.finish();
+	}
+
+	const double copy_time = getEventTime(img_source_event) + getEventTime(img_dest_event);
+	const double kernel_time = grid.getKernelTime();
+
+	printf("Grid: %dx%dx%d, splat: %s, slice: %s\n", grid.getSmallHeight(), grid.getSmallWidth(), grid.getSmallDepth(),
+		BilateralGridCL::splatModeName(grid.getSplatPath()),
+		BilateralGridCL::slicePathName(grid.getSlicePath()));
+	printf("Timers: ocl:%.3fms ocl_copy:%.3fms ocl_kernel:%.3fms host:%.3fms\n",
+		(copy_time + kernel_time) * 1000,
+		copy_time * 1000,
+		kernel_time * 1000,
+		host_time * 1000);
+	printf("Host/OpenCL max difference: %f\n", cv::norm(img_host, img_dest, cv::NORM_INF));
+
+	if (roofline_report)
+	{
+		Roofline roofline;
+		for (size_t i = 0; i < grid.getKernelEvents().size(); i++)
+		{
+			const std::string &name = grid.getKernelNames()[i];
+			roofline.add(name, grid.getKernelEvents()[i],
+				Roofline::gridKernelCost(name, cols, rows, grid.getSmallHeight(), grid.getSmallWidth(), grid.getSmallDepth()));
+		}
+		roofline.print(Roofline::measurePeak(context, device, queue));
+	}
+
+	if (splat_benchmark)
+	{
+		benchmarkSplat(queue, grid, img_source_dev, img_dest_dev, cols, rows, (float)src_min, (float)src_max, param_range);
+	}
+
+	if (benchmark)
+	{
+		benchmarkSampling(queue, grid, img_source_dev, img_dest_dev, im_gs_float, (float)src_min, (float)src_max, (float)param_space, param_range);
+		outputFileName = benchmarkFileName(outputFileName, kernel_time);
+	}
+
+	if (lightness_only)
+	{
+		img_source.saveImageToFile(outputFileName, cv::Mat(img_dest / 255.0));
+		return;
+	}
+
+	TRACE_SCOPE("imwrite");
+	cv::imwrite(outputFileName, img_dest);
+}
+
+/**
+ * Bilaterální filtr (basic) jen na kanálu L - nahraje se jen rovina L (float místo cl_float3),
+ * a/b se při uložení vezmou z původního obrázku.
+ */
+void runLightness(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	MyMat &img_source, int param_space, float param_range, bool generic_kernel, bool host_compare,
+	std::string outputFileName, bool benchmark)
+{
+	cl_int err_msg;
+	cv::Mat lightness = img_source.getLightness();
+	const int dest_rows = lightness.rows - param_space * 2;
+	const int dest_cols = lightness.cols - param_space * 2;
+	const size_t source_size = sizeof(float) * lightness.rows * lightness.cols;
+	const size_t dest_size = sizeof(float) * dest_rows * dest_cols;
+
+	BilateralFilterCL filter(context, device, queue, !generic_kernel);
+	filter.setChannels(1);
+	printf("Basic kernel: %s (L only)\n", filter.getKernelName(param_space).c_str());
+
+	cv::Mat img_dest(dest_rows, dest_cols, CV_32FC1);
+
+	cl::Buffer img_source_dev(context, CL_MEM_READ_ONLY, source_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_source L");
+	cl::Buffer img_dest_dev(context, CL_MEM_WRITE_ONLY, dest_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: img_dest L");
+
+	cl::Event img_source_event, img_dest_event;
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(
+		img_source_dev, CL_FALSE, 0, source_size, lightness.ptr<float>(), NULL, &img_source_event
+	), "clEnqueueWriteBuffer: img_source L");
+	Trace::addEvent("write img_source L", img_source_event);
+
+	cl::Event kernel_event = filter.enqueue(img_source_dev, img_dest_dev, dest_cols, dest_rows, param_space, param_range);
+
+	clPrintErrorExit(queue.enqueueReadBuffer(
+		img_dest_dev, CL_FALSE, 0, dest_size, img_dest.ptr<float>(), NULL, &img_dest_event
+	), "clEnqueueReadBuffer: img_dest L");
+	Trace::addEvent("read img_dest L", img_dest_event);
+
+	{
+		TRACE_SCOPE("queue.finish");
+		queue.finish();
+	}
+
+	printf("Upload: %.1f kB (Lab %.1f kB)\n", source_size / 1024.0, img_source.getDataSize() / 1024.0);
+	printf("Timers: ocl:%.3fms ocl_copy:%.3fms ocl_kernel:%.3fms\n",
+		(getEventTime(img_source_event) + getEventTime(img_dest_event) + getEventTime(kernel_event)) * 1000,
+		(getEventTime(img_source_event) + getEventTime(img_dest_event)) * 1000,
+		getEventTime(kernel_event) * 1000);
+
+	if (host_compare)
+	{
+		cv::Mat img_host;
+		double host_time = getTime();
+		{
+			TRACE_SCOPE("cv_extend::bilateralFilterBruteForce");
+			cv_extend::bilateralFilterBruteForce(lightness, img_host, param_space, param_range);
+		}
+		host_time = getTime() - host_time;
+
+		printf("Host: %.3fms max difference: %f\n", host_time * 1000, cv::norm(img_host, img_dest, cv::NORM_INF));
+	}
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, getEventTime(kernel_event));
+	}
+
+	img_source.saveImageToFile(outputFileName, img_dest);
+}
+
+/**
+ * CV_32FC3 -> CV_32FC4, stejné rozložení v paměti jako pole cl_float3.
+ */
+cv::Mat toFloat4(const cv::Mat &mat)
+{
+	cv::Mat mat4;
+	cv::cvtColor(mat, mat4, cv::COLOR_BGR2BGRA);
+	return mat4;
+}
+
+/**
+ * Joint bilateral upsampling - filtr basic v rozlišení zmenšeném factor-krát a převod
+ * zpět do plného rozlišení podle původního obrázku. Pro s = 2, 4, 8 (a factor) vypíše
+ * čas hostitele i OpenCL, zrychlení a chybu proti filtru v plném rozlišení,
+ * uloží se výsledek pro factor. Výstup má stejnou velikost jako vstup.
+ */
+void runUpsample(cl::Context &context, cl::Device &device, cl::CommandQueue &queue,
+	MyMat &img_source, int param_space, float param_range, int factor, bool generic_kernel,
+	std::string outputFileName, bool benchmark)
+{
+	cl_int err_msg;
+	const cv::Mat &source = img_source.getMat();
+	const int rows = source.rows;
+	const int cols = source.cols;
+
+	BilateralFilterCL filter(context, device, queue, !generic_kernel);
+	JointUpsampleCL upsample(context, device, queue);
+
+	// plné rozlišení - reference
+	cv::Mat source4 = toFloat4(source);
+	cv::Mat reference4(rows - 2 * param_space, cols - 2 * param_space, CV_32FC4);
+
+	cl::Buffer guide_dev(context, CL_MEM_READ_ONLY, source4.total() * sizeof(cl_float3), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: guide");
+	cl::Buffer dest_dev(context, CL_MEM_READ_WRITE, source4.total() * sizeof(cl_float3), NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: upsample dest");
+
+	clPrintErrorExit(queue.enqueueWriteBuffer(guide_dev, CL_TRUE, 0, source4.total() * sizeof(cl_float3), source4.ptr<float>()),
+		"clEnqueueWriteBuffer: guide");
+
+	cl::Event reference_event = filter.enqueue(guide_dev, dest_dev, reference4.cols, reference4.rows, param_space, param_range);
+	clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, reference4.total() * sizeof(cl_float3), reference4.ptr<float>()),
+		"clEnqueueReadBuffer: reference");
+	const double reference_time = getEventTime(reference_event);
+
+	cv::Mat reference;
+	cv::cvtColor(reference4, reference, cv::COLOR_BGRA2BGR);
+	const cv::Rect center(param_space, param_space, reference.cols, reference.rows);
+
+	printf("\nJoint bilateral upsampling (full resolution %.3fms):\n", reference_time * 1000);
+	printf("%4s %11s %7s %12s %14s %12s %9s %12s %10s %12s %12s\n",
+		"s", "low-res", "radius", "filter [ms]", "upsample [ms]", "total [ms]", "speedup", "max diff", "PSNR [dB]", "host [ms]", "host diff");
+
+	std::vector<int> factors;
+	factors.push_back(2);
+	factors.push_back(4);
+	factors.push_back(8);
+	if (factor != 2 && factor != 4 && factor != 8)
+	{
+		factors.push_back(factor);
+	}
+
+	for (size_t i = 0; i < factors.size(); i++)
+	{
+		const int s = factors[i];
+		const int low_radius = std::max(1, (param_space + s / 2) / s);
+
+		cv::Mat low, low_padded;
+		{
+			TRACE_SCOPE("downsample");
+			cv::resize(source, low, cv::Size((cols + s - 1) / s, (rows + s - 1) / s), 0, 0, cv::INTER_AREA);
+			cv::copyMakeBorder(low, low_padded, low_radius, low_radius, low_radius, low_radius, cv::BORDER_REPLICATE);
+		}
+
+		cv::Mat low4 = toFloat4(low), low_padded4 = toFloat4(low_padded);
+		const size_t low_size = low4.total() * sizeof(cl_float3);
+
+		cl::Buffer low_padded_dev(context, CL_MEM_READ_ONLY, low_padded4.total() * sizeof(cl_float3), NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: low padded");
+		cl::Buffer low_guide_dev(context, CL_MEM_READ_ONLY, low_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: low guide");
+		cl::Buffer low_filtered_dev(context, CL_MEM_READ_WRITE, low_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: low filtered");
+
+		clPrintErrorExit(queue.enqueueWriteBuffer(low_padded_dev, CL_FALSE, 0, low_padded4.total() * sizeof(cl_float3), low_padded4.ptr<float>()),
+			"clEnqueueWriteBuffer: low padded");
+		clPrintErrorExit(queue.enqueueWriteBuffer(low_guide_dev, CL_FALSE, 0, low_size, low4.ptr<float>()),
+			"clEnqueueWriteBuffer: low guide");
+
+		cl::Event filter_event = filter.enqueue(low_padded_dev, low_filtered_dev, low.cols, low.rows, low_radius, param_range);
+		cl::Event upsample_event = upsample.enqueue(low_filtered_dev, low_guide_dev, guide_dev, dest_dev, cols, rows, low.cols, low.rows, param_range);
+
+		cv::Mat result4(rows, cols, CV_32FC4), result;
+		clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, result4.total() * sizeof(cl_float3), result4.ptr<float>()),
+			"clEnqueueReadBuffer: upsample dest");
+		cv::cvtColor(result4, result, cv::COLOR_BGRA2BGR);
+
+		// hostitelská verze
+		cv::Mat low_filtered, host_result;
+		double host_time = getTime();
+		{
+			TRACE_SCOPE("host joint bilateral upsampling");
+			cv_extend::bilateralFilterBruteForce(low_padded, low_filtered, low_radius, param_range);
+			cv_extend::jointBilateralUpsample(low_filtered, low, source, host_result, JointUpsampleCL::RADIUS, param_range);
+		}
+		host_time = getTime() - host_time;
+
+		const double total_time = getEventTime(filter_event) + getEventTime(upsample_event);
+
+		printf("%4d %5dx%-5d %7d %12.3f %14.3f %12.3f %8.1fx %12f %10.2f %12.3f %12f\n",
+			s,
+			low.cols,
+			low.rows,
+			low_radius,
+			getEventTime(filter_event) * 1000,
+			getEventTime(upsample_event) * 1000,
+			total_time * 1000,
+			reference_time / total_time,
+			cv::norm(result(center), reference, cv::NORM_INF),
+			cv_extend::psnr(result(center), reference, 1.0),
+			host_time * 1000,
+			cv::norm(result, host_result, cv::NORM_INF));
+
+		if (s == factor)
+		{
+			if (benchmark)
+			{
+				outputFileName = benchmarkFileName(outputFileName, total_time);
+			}
+
+			MyMat img_dest(rows, cols);
+			result.copyTo(img_dest.getMat());
+			img_dest.saveImageToFile(outputFileName);
+		}
+	}
+}
+
+/**
+ * Bilaterální filtr (basic) rozdělený mezi všechna zařízení OpenCL.
+ * Obrázek se zpracuje repeat-krát, každé opakování použije propustnosti změřené v předchozím.
+ */
+void runMultiDevice(MyMat &img_source, cl_float3 *img_source_fl3, int param_space, float param_range,
+	int repeat, bool generic_kernel, std::string outputFileName, bool benchmark)
+{
+	MultiDeviceFilter filter(!generic_kernel);
+	printf("\nMulti-device: %d devices\n", (int)filter.getDeviceCount());
+
+	int dest_rows = img_source.getMat().rows - param_space * 2;
+	int dest_cols = img_source.getMat().cols - param_space * 2;
+
+	MyMat img_dest(dest_rows, dest_cols);
+	cl_float3 *img_dest_fl3 = img_dest.getData();
+
+	double time = 0.0;
+	for (int i = 0; i < repeat; i++)
+	{
+		double begin = getTime();
+		filter.run(img_source_fl3, img_dest_fl3, img_source.getMat().cols, img_source.getMat().rows, param_space, param_range);
+		time = getTime() - begin;
+		Trace::addSpan("multi-device run", "host", begin, begin + time);
+
+		printf("Run %d: %.3fms\n", i, time * 1000);
+		filter.printBalance();
+	}
+
+	img_dest.setData(img_dest_fl3);
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, time);
+	}
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Postupný výpočet - simulace interaktivního nástroje. Parametr barvy se rychle mění
+ * (jako při tažení posuvníku), každá úroveň se vypíše s latencí od zadání požadavku.
+ * Uloží se poslední úroveň posledního požadavku.
+ */
+void runProgressive(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	int param_space, float param_range, double latency_target, std::string outputFileName, bool benchmark)
+{
+	ProgressiveFilter progressive(context, device, queue, latency_target);
+	progressive.setImage(img_source.getMat());
+
+	printf("\nProgressive: latency target %.1fms\n", latency_target * 1000);
+	printf("%8s %10s %-18s %12s\n", "request", "range", "level", "latency [ms]");
+
+	std::mutex result_mutex;
+	cv::Mat final_result;
+	double final_latency = 0.0;
+
+	const float steps[] = { 0.25f, 0.5f, 0.75f, 1.0f };
+	for (float step : steps)
+	{
+		const float range = param_range * step;
+		progressive.submit(param_space, range, [&, range](unsigned int request, int level, const cv::Mat &result, double latency)
+		{
+			std::lock_guard<std::mutex> lock(result_mutex);
+			printf("%8u %10.3f %-18s %12.3f\n", request, range, ProgressiveFilter::levelName(level), latency * 1000);
+
+			if (level == ProgressiveFilter::LEVEL_COUNT - 1)
+			{
+				final_result = result;
+				final_latency = latency;
+			}
+		});
+
+		// posuvník se pohne dřív, než se stihnou spočítat všechny úrovně
+		std::this_thread::sleep_for(std::chrono::milliseconds(5));
+	}
+
+	progressive.wait();
+	printf("Coarse factor: %d\n", progressive.getCoarseFactor());
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, final_latency);
+	}
+
+	MyMat img_dest(final_result.rows, final_result.cols);
+	final_result.copyTo(img_dest.getMat());
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Přírůstkové filtrování - simulace retušovacího štětce. Každý tah zesvětlí čtverec 32x32
+ * na náhodném místě a přepočítá se jen jeho okolí. Nakonec se výsledek porovná s výpočtem
+ * celého obrázku.
+ */
+void runIncremental(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	bool grid_engine, int param_space, float param_range, int strokes, std::string outputFileName, bool benchmark)
+{
+	IncrementalFilter incremental(context, device, queue, grid_engine, param_space, param_range);
+	cv::Mat image = img_source.getMat().clone();
+
+	double full_time = getTime();
+	incremental.reset(image);
+	full_time = getTime() - full_time;
+
+	printf("\nIncremental: full image %.3fms\n", full_time * 1000);
+	printf("%6s %20s %14s %14s %12s\n", "stroke", "rect", "uploaded [kB]", "recomputed", "time [ms]");
+
+	cv::RNG rng(12345);
+	const int size = std::min(32, std::min(image.cols, image.rows));
+	double update_time = 0.0;
+
+	for (int i = 0; i < strokes; i++)
+	{
+		cv::Rect rect(rng.uniform(0, image.cols - size + 1), rng.uniform(0, image.rows - size + 1), size, size);
+		cv::Mat stroke = image(rect);
+		stroke += cv::Scalar(0.1, 0.0, 0.0);
+
+		double time = getTime();
+		incremental.update(image, std::vector<cv::Rect>(1, rect));
+		time = getTime() - time;
+		update_time += time;
+
+		char rect_text[64];
+		sprintf(rect_text, "%dx%d+%d+%d", rect.width, rect.height, rect.x, rect.y);
+		printf("%6d %20s %14.1f %14u %12.3f\n", i, rect_text, incremental.getUploadedBytes() / 1024.0,
+			(unsigned int)incremental.getRecomputedPixels(), time * 1000);
+	}
+
+	cv::Mat result = incremental.update(image, std::vector<cv::Rect>()).clone();
+
+	IncrementalFilter reference(context, device, queue, grid_engine, param_space, param_range);
+	printf("Average update: %.3fms, max difference to full recompute: %f\n",
+		strokes > 0 ? update_time / strokes * 1000 : 0.0, cv::norm(result, reference.reset(image), cv::NORM_INF));
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, strokes > 0 ? update_time / strokes : full_time);
+	}
+
+	MyMat img_dest(result.rows, result.cols);
+	result.copyTo(img_dest.getMat());
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Opakované filtrování (kreslený styl, silné odšumění) - data zůstávají na zařízení,
+ * halo zóny se v každé iteraci doplní opakováním okrajů a výstup má velikost vstupu.
+ * Na hostitele se čte jen výsledek poslední iterace.
+ */
+void runIterations(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	int param_space, float param_range, int iterations, bool generic_kernel, int block_x, int block_y,
+	std::string outputFileName, bool benchmark)
+{
+	cl_int err_msg;
+	const int rows = img_source.getMat().rows;
+	const int cols = img_source.getMat().cols;
+	const size_t image_size = sizeof(cl_float3) * rows * cols;
+	const size_t padded_size = sizeof(cl_float3) * (rows + param_space * 2) * (cols + param_space * 2);
+
+	BilateralFilterCL filter(context, device, queue, !generic_kernel);
+	if (block_x > 0)
+	{
+		filter.setBlock(block_x, block_y);
+	}
+
+	cl::Buffer image_dev(context, CL_MEM_READ_WRITE, image_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: image");
+	cl::Buffer padded_dev(context, CL_MEM_READ_WRITE, padded_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: padded");
+
+	// první spuštění sestaví programy
+	filter.enqueueIterations(image_dev, padded_dev, cols, rows, param_space, param_range, 1);
+	queue.finish();
+
+	// převody Lab <-> cl_float3 na hostiteli mimo měřený úsek
+	cl_float3 *img_source_fl3 = img_source.getData();
+	MyMat img_dest(rows, cols);
+	cl_float3 *img_dest_fl3 = img_dest.getData();
+
+	double begin = getTime();
+
+	cl::Event write_event;
+	clPrintErrorExit(queue.enqueueWriteBuffer(image_dev, CL_FALSE, 0, image_size, img_source_fl3, NULL, &write_event),
+		"clEnqueueWriteBuffer: image");
+	Trace::addEvent("write image", write_event);
+
+	cl::Event kernel_event = filter.enqueueIterations(image_dev, padded_dev, cols, rows, param_space, param_range, iterations);
+
+	cl::Event read_event;
+	clPrintErrorExit(queue.enqueueReadBuffer(image_dev, CL_TRUE, 0, image_size, img_dest_fl3, NULL, &read_event),
+		"clEnqueueReadBuffer: image");
+	Trace::addEvent("read image", read_event);
+
+	double total_time = getTime() - begin;
+
+	img_dest.setData(img_dest_fl3);
+
+	// in-order fronta - iterace běží od konce zápisu do konce posledního kernelu
+	double kernel_time = (kernel_event.getProfilingInfo<CL_PROFILING_COMMAND_END>() -
+		write_event.getProfilingInfo<CL_PROFILING_COMMAND_END>()) / 1000000000.0;
+
+	printf("\nIterations: %d, kernels %.3fms (%.3fms per iteration), total with transfers %.3fms, transferred %.1f kB\n",
+		iterations, kernel_time * 1000, kernel_time / iterations * 1000, total_time * 1000, 2.0 * image_size / 1024.0);
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, kernel_time);
+	}
+
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Rozhraní DeviceFilter s cl_mem / cl_event - dva průchody jádrem basic zřetězené jen přes události
+ * mezi buffery na zařízení, bez čtení na hostiteli. Výsledek se porovná s cestou basic (halo zóny
+ * doplněné na hostiteli, BilateralFilterCL, čtení po každém průchodu). Výstup má velikost vstupu.
+ */
+void runChain(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	int param_space, float param_range, std::string outputFileName)
+{
+	cl_int err_msg;
+	const int rows = img_source.getMat().rows;
+	const int cols = img_source.getMat().cols;
+	const size_t image_size = sizeof(cl_float3) * rows * cols;
+	const int passes = 2;
+
+	cl::Buffer image_dev[passes + 1];
+	for (int i = 0; i <= passes; i++)
+	{
+		image_dev[i] = cl::Buffer(context, CL_MEM_READ_WRITE, image_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: chain image");
+	}
+
+	DeviceFilter *chain = DeviceFilter::create(context(), queue(), &err_msg);
+	clPrintErrorExit(err_msg, "DeviceFilter::create");
+
+	cl::Event write_event;
+	clPrintErrorExit(queue.enqueueWriteBuffer(image_dev[0], CL_FALSE, 0, image_size, img_source.getData(), NULL, &write_event),
+		"clEnqueueWriteBuffer: chain image");
+
+	// každý průchod čeká jen na událost předchozího
+	cl_event pass_events[passes + 1];
+	pass_events[0] = write_event();
+	clPrintErrorExit(clRetainEvent(pass_events[0]), "clRetainEvent");
+	for (int i = 0; i < passes; i++)
+	{
+		clPrintErrorExit(chain->enqueue(image_dev[i](), image_dev[i + 1](), cols, rows, param_space, param_range,
+			1, &pass_events[i], &pass_events[i + 1]), "DeviceFilter::enqueue");
+	}
+
+	clPrintErrorExit(clWaitForEvents(1, &pass_events[passes]), "clWaitForEvents: chain");
+	for (int i = 0; i <= passes; i++)
+	{
+		clReleaseEvent(pass_events[i]);
+	}
+	delete chain;
+
+	MyMat img_dest(rows, cols);
+	cl_float3 *img_dest_fl3 = img_dest.getData();
+	clPrintErrorExit(queue.enqueueReadBuffer(image_dev[passes], CL_TRUE, 0, image_size, img_dest_fl3), "clEnqueueReadBuffer: chain image");
+	img_dest.setData(img_dest_fl3);
+
+	// cesta basic - halo zóny na hostiteli, každý průchod zvlášť
+	BilateralFilterCL filter(context, device, queue);
+	cv::Mat reference = img_source.getMat().clone();
+	for (int i = 0; i < passes; i++)
+	{
+		MyMat padded(rows + param_space * 2, cols + param_space * 2);
+		cv::copyMakeBorder(reference, padded.getMat(), param_space, param_space, param_space, param_space, cv::BORDER_REPLICATE);
+
+		cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (size_t)padded.getDataSize(), padded.getData(), &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: reference");
+		filter.enqueue(source_dev, image_dev[0], cols, rows, param_space, param_range);
+
+		MyMat pass(rows, cols);
+		cl_float3 *pass_fl3 = pass.getData();
+		clPrintErrorExit(queue.enqueueReadBuffer(image_dev[0], CL_TRUE, 0, image_size, pass_fl3), "clEnqueueReadBuffer: reference");
+		pass.setData(pass_fl3);
+		reference = pass.getMat().clone();
+	}
+
+	printf("\nDevice chain: %d passes, max difference against basic path: %f\n",
+		passes, cv::norm(img_dest.getMat(), reference, cv::NORM_INF));
+
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Operace grafu jen nad kanálem L (-a s -l) - kernel _lightness / _radius s operacemi při zápisu
+ * výstupu proti samostatnému filtru a operacím na hostiteli. a/b zůstanou z původního obrázku.
+ */
+void runGraphLightness(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, FilterGraph &graph, MyMat &img_source,
+	int param_space, float param_range, const std::string &graph_operations, bool generic_kernel, std::string outputFileName, bool benchmark)
+{
+	cl_int err_msg;
+	cv::Mat lightness = img_source.getLightness();
+	const int rows = lightness.rows - param_space * 2;
+	const int cols = lightness.cols - param_space * 2;
+	const size_t output_size = sizeof(float) * rows * cols;
+
+	cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, sizeof(float) * lightness.rows * lightness.cols,
+		lightness.ptr<float>(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: graph lightness");
+	cl::Buffer output_dev(context, CL_MEM_READ_WRITE, output_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: graph output");
+
+	// první spuštění sestaví program
+	graph.enqueueLightness(source_dev, output_dev, cols, rows, param_space, param_range);
+	queue.finish();
+
+	double begin = getTime();
+	graph.enqueueLightness(source_dev, output_dev, cols, rows, param_space, param_range);
+	cv::Mat result(rows, cols, CV_32F);
+	clPrintErrorExit(queue.enqueueReadBuffer(output_dev, CL_TRUE, 0, output_size, result.data), "clEnqueueReadBuffer: graph output");
+	double fused_time = getTime() - begin;
+
+	// samostatný filtr L na zařízení, operace na hostiteli (a/b nulové, operace L je nečtou)
+	begin = getTime();
+	BilateralFilterCL filter(context, device, queue, !generic_kernel);
+	filter.setChannels(1);
+	filter.enqueue(source_dev, output_dev, cols, rows, param_space, param_range);
+	cv::Mat filtered(rows, cols, CV_32F);
+	clPrintErrorExit(queue.enqueueReadBuffer(output_dev, CL_TRUE, 0, output_size, filtered.data), "clEnqueueReadBuffer: graph filtered");
+
+	cv::Mat zeros(rows, cols, CV_32F, cv::Scalar(0));
+	cv::Mat source_planes[3] = { lightness(cv::Rect(param_space, param_space, cols, rows)), zeros, zeros };
+	cv::Mat filtered_planes[3] = { filtered, zeros, zeros };
+	cv::Mat source_lab, filtered_lab, reference;
+	cv::merge(source_planes, 3, source_lab);
+	cv::merge(filtered_planes, 3, filtered_lab);
+	cv::extractChannel(graph.applyHost(source_lab, filtered_lab), reference, 0);
+	double separate_time = getTime() - begin;
+
+	printf("\nFilter graph %s (L only): fused %.3fms, separate passes %.3fms, max difference %f\n",
+		graph_operations.c_str(), fused_time * 1000, separate_time * 1000, cv::norm(result, reference, cv::NORM_INF));
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, fused_time);
+	}
+	img_source.saveImageToFile(outputFileName, result);
+}
+
+/**
+ * Filtr následovaný bodovými operacemi grafu (-a) - operace sloučené do kernelu proti
+ * samostatným průchodům na hostiteli. Vypíše doby a největší rozdíl výsledků.
+ */
+void runGraph(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	bool grid_engine, bool lightness_only, int param_space, float param_range, const std::string &graph_operations,
+	bool generic_kernel, int block_x, int block_y, std::string outputFileName, bool benchmark)
+{
+	FilterGraph graph(context, device, queue, !generic_kernel);
+	if (!graph.parse(graph_operations) || (lightness_only && !graph.isLightnessOnly()))
+	{
+		std::cerr << "Invalid filter graph: " << graph_operations << std::endl;
+		exit(1);
+	}
+	if (block_x > 0)
+	{
+		graph.getFilter().setBlock(block_x, block_y);
+	}
+
+	if (lightness_only)
+	{
+		runGraphLightness(context, device, queue, graph, img_source, param_space, param_range, graph_operations, generic_kernel,
+			outputFileName, benchmark);
+		return;
+	}
+
+	cl_int err_msg;
+	const cv::Mat &source = img_source.getMat();
+	const int rows = grid_engine ? source.rows : source.rows - param_space * 2;
+	const int cols = grid_engine ? source.cols : source.cols - param_space * 2;
+	const size_t output_size = graph.getPixelSize() * rows * cols;
+
+	cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (size_t)img_source.getDataSize(), img_source.getData(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: graph source");
+	cl::Buffer output_dev(context, CL_MEM_WRITE_ONLY, output_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: graph output");
+
+	cv::Mat lightness = img_source.getLightness() * 255.0;
+	cl::Buffer lightness_dev(context, CL_MEM_READ_WRITE | CL_MEM_COPY_HOST_PTR, sizeof(float) * source.rows * source.cols,
+		lightness.ptr<float>(), &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: graph lightness");
+
+	// první spuštění sestaví programy
+	for (int pass = 0; pass < 2; pass++)
+	{
+		grid_engine ? graph.enqueueGrid(source_dev, lightness_dev, output_dev, cols, rows, (float)param_space, param_range) :
+			graph.enqueueBasic(source_dev, output_dev, cols, rows, param_space, param_range);
+		queue.finish();
+	}
+
+	double begin = getTime();
+	grid_engine ? graph.enqueueGrid(source_dev, lightness_dev, output_dev, cols, rows, (float)param_space, param_range) :
+		graph.enqueueBasic(source_dev, output_dev, cols, rows, param_space, param_range);
+
+	cv::Mat result(rows, cols, graph.isQuantised() ? CV_8UC3 : CV_32FC4);
+	clPrintErrorExit(queue.enqueueReadBuffer(output_dev, CL_TRUE, 0, output_size, result.data), "clEnqueueReadBuffer: graph output");
+	double fused_time = getTime() - begin;
+
+	if (!graph.isQuantised())
+	{
+		cv::cvtColor(result, result, cv::COLOR_BGRA2BGR);
+	}
+
+	// stejný řetězec po samostatných průchodech - filtr na zařízení, operace na hostiteli
+	begin = getTime();
+	cv::Mat filtered;
+	cv::Mat source_region = grid_engine ? source : source(cv::Rect(param_space, param_space, cols, rows));
+	if (grid_engine)
+	{
+		BilateralGridCL grid(context, device, queue, false);
+		grid.enqueue(lightness_dev, lightness_dev, cols, rows, 0.0f, 255.0f, (float)param_space, param_range);
+
+		std::vector<cv::Mat> channels;
+		cv::split(source, channels);
+		clPrintErrorExit(queue.enqueueReadBuffer(lightness_dev, CL_TRUE, 0, sizeof(float) * rows * cols, channels[0].ptr<float>()),
+			"clEnqueueReadBuffer: graph lightness");
+		channels[0].convertTo(channels[0], -1, 1.0 / 255);
+		cv::merge(channels, filtered);
+	}
+	else
+	{
+		BilateralFilterCL filter(context, device, queue, !generic_kernel);
+		if (block_x > 0)
+		{
+			filter.setBlock(block_x, block_y);
+		}
+		cl::Buffer filtered_dev(context, CL_MEM_WRITE_ONLY, sizeof(cl_float3) * rows * cols, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: graph filtered");
+		filter.enqueue(source_dev, filtered_dev, cols, rows, param_space, param_range);
+
+		MyMat img_filtered(rows, cols);
+		cl_float3 *img_filtered_fl3 = img_filtered.getData();
+		clPrintErrorExit(queue.enqueueReadBuffer(filtered_dev, CL_TRUE, 0, sizeof(cl_float3) * rows * cols, img_filtered_fl3),
+			"clEnqueueReadBuffer: graph filtered");
+		img_filtered.setData(img_filtered_fl3);
+		filtered = img_filtered.getMat().clone();
+	}
+	cv::Mat reference = graph.applyHost(source_region, filtered);
+	double separate_time = getTime() - begin;
+
+	cv::Mat result_float, reference_float;
+	result.convertTo(result_float, CV_32FC3, graph.isQuantised() ? 1.0 / 255 : 1.0);
+	reference.convertTo(reference_float, CV_32FC3, graph.isQuantised() ? 1.0 / 255 : 1.0);
+
+	printf("\nFilter graph %s: fused %.3fms, separate passes %.3fms, max difference %f\n",
+		graph_operations.c_str(), fused_time * 1000, separate_time * 1000, cv::norm(result_float, reference_float, cv::NORM_INF));
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, fused_time);
+	}
+
+	if (graph.isBGR())
+	{
+		cv::Mat bgr_uint8;
+		result.convertTo(bgr_uint8, CV_8UC3, graph.isQuantised() ? 1.0 : 255.0);
+		cv::imwrite(outputFileName, bgr_uint8);
+	}
+	else
+	{
+		MyMat img_dest(rows, cols);
+		result_float.copyTo(img_dest.getMat());
+		img_dest.saveImageToFile(outputFileName);
+	}
+}
+
+/**
+ * Dávka náhledů (-j) - výřezy 96x96 až 128x128 ze vstupu filtrované po dávkách jedním spuštěním
+ * kernelu proti jednomu spuštění na obrázek. Výstupem je mozaika prvních náhledů.
+ */
+void runBatch(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	int param_space, float param_range, int thumbnails, std::string outputFileName, bool benchmark)
+{
+	const cv::Mat &source = img_source.getMat();
+	const int max_size = std::min(128, std::min(source.cols, source.rows));
+	const int min_size = std::max(1, max_size * 3 / 4);
+
+	cv::RNG rng(12345);
+	std::vector<cv::Mat> images;
+	for (int i = 0; i < thumbnails; i++)
+	{
+		int width = rng.uniform(min_size, max_size + 1);
+		int height = rng.uniform(min_size, max_size + 1);
+		images.push_back(source(cv::Rect(rng.uniform(0, source.cols - width + 1), rng.uniform(0, source.rows - height + 1), width, height)).clone());
+	}
+
+	BatchFilter batch(context, device, queue);
+	batch.run(images, param_space, param_range); // sestavení programu
+
+	double batch_time = getTime();
+	std::vector<cv::Mat> results = batch.run(images, param_space, param_range);
+	batch_time = getTime() - batch_time;
+
+	// jedno spuštění na obrázek
+	cl_int err_msg;
+	BilateralFilterCL filter(context, device, queue);
+	double single_time = getTime(), difference = 0.0;
+	for (int i = 0; i < thumbnails; i++)
+	{
+		MyMat padded(images[i].rows + param_space * 2, images[i].cols + param_space * 2);
+		cv::copyMakeBorder(images[i], padded.getMat(), param_space, param_space, param_space, param_space, cv::BORDER_REPLICATE);
+
+		cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (size_t)padded.getDataSize(), padded.getData(), &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: thumbnail");
+		cl::Buffer dest_dev(context, CL_MEM_WRITE_ONLY, sizeof(cl_float3) * images[i].rows * images[i].cols, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: thumbnail dest");
+		filter.enqueue(source_dev, dest_dev, images[i].cols, images[i].rows, param_space, param_range);
+
+		MyMat img_dest(images[i].rows, images[i].cols);
+		cl_float3 *img_dest_fl3 = img_dest.getData();
+		clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, img_dest.getDataSize(), img_dest_fl3), "clEnqueueReadBuffer: thumbnail");
+		img_dest.setData(img_dest_fl3);
+
+		difference = std::max(difference, cv::norm(img_dest.getMat(), results[i], cv::NORM_INF));
+	}
+	single_time = getTime() - single_time;
+
+	printf("\nBatch: %d images, %d launches (batch size %d), batched %.3fms (kernels %.3fms), one launch per image %.3fms, max difference %f\n",
+		thumbnails, batch.getLaunches(), BatchFilter::batchSize(device, max_size, max_size, param_space),
+		batch_time * 1000, batch.getKernelTime() * 1000, single_time * 1000, difference);
+
+	if (benchmark)
+	{
+		outputFileName = benchmarkFileName(outputFileName, batch_time);
+	}
 
-namespace cv_extend {
+	// mozaika nejvýše 8x8 náhledů
+	const int columns = std::min(8, thumbnails);
+	const int mosaic_rows = (std::min(64, thumbnails) + columns - 1) / columns;
+	MyMat img_dest(mosaic_rows * max_size, columns * max_size);
+	img_dest.getMat().setTo(cv::Scalar(0.0, 0.5, 0.5));
+	for (int i = 0; i < std::min(64, thumbnails); i++)
+	{
+		cv::Mat cell = img_dest.getMat()(cv::Rect((i % columns) * max_size, (i / columns) * max_size, results[i].cols, results[i].rows));
+		results[i].copyTo(cell);
+	}
+	img_dest.saveImageToFile(outputFileName);
+}
+
+/**
+ * Dávka souborů (-q) - vstup je seznam obrázků (jedna cesta na řádek), výstupy se pojmenují
+ * podle výstupního souboru s pořadím obrázku. Dekódování a kódování běží ve vláknech BatchPipeline.
+ */
+void runFileBatch(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, const std::string &listFileName,
+	int param_space, float param_range, int io_threads, std::string outputFileName)
+{
+	std::vector<std::string> inputs = BatchPipeline::readList(listFileName);
+	std::vector<std::string> outputs;
 
-	template<typename T, typename T_, typename T__>
-	inline
-		T clamp(const T_ min, const T__ max, const T x)
+	std::string prefix = outputFileName.substr(0, outputFileName.length() - 4);
+	for (size_t i = 0; i < inputs.size(); i++)
 	{
-		return
-			(x < static_cast<T>(min)) ? static_cast<T>(min) :
-			(x < static_cast<T>(max)) ? static_cast<T>(x) :
-			static_cast<T>(max);
+		std::stringstream ss;
+		ss << prefix << "_" << std::setw(5) << std::setfill('0') << i << ".png";
+		outputs.push_back(ss.str());
 	}
 
-	template<typename T>
-	inline
-		T
-		trilinear_interpolation(const cv::Mat mat,
-			const double y,
-			const double x,
-			const double z)
+	// buffery zůstávají pro obrázky stejné velikosti
+	BilateralFilterCL filter(context, device, queue);
+	cl::Buffer source_dev, dest_dev;
+	cv::Size allocated;
+
+	BatchPipeline pipeline(io_threads);
+	pipeline.run(inputs, outputs, param_space, [&](const cv::Mat &lab)
 	{
-		const size_t height = mat.size[0];
-		const size_t width = mat.size[1];
-		const size_t depth = mat.size[2];
+		const int rows = lab.rows - param_space * 2;
+		const int cols = lab.cols - param_space * 2;
+		cl_int err_msg;
 
-		const size_t y_index = clamp(0, height - 1, static_cast<size_t>(y));
-		const size_t yy_index = clamp(0, height - 1, y_index + 1);
-		const size_t x_index = clamp(0, width - 1, static_cast<size_t>(x));
-		const size_t xx_index = clamp(0, width - 1, x_index + 1);
-		const size_t z_index = clamp(0, depth - 1, static_cast<size_t>(z));
-		const size_t zz_index = clamp(0, depth - 1, z_index + 1);
-		const double y_alpha = y - y_index;
-		const double x_alpha = x - x_index;
-		const double z_alpha = z - z_index;
+		if (allocated != lab.size())
+		{
+			source_dev = cl::Buffer(context, CL_MEM_READ_ONLY, sizeof(cl_float3) * lab.rows * lab.cols, NULL, &err_msg);
+			clPrintErrorExit(err_msg, "clCreateBuffer: batch source");
+			dest_dev = cl::Buffer(context, CL_MEM_WRITE_ONLY, sizeof(cl_float3) * rows * cols, NULL, &err_msg);
+			clPrintErrorExit(err_msg, "clCreateBuffer: batch dest");
+			allocated = lab.size();
+		}
+
+		cv::Mat source_fl4, result_fl4(rows, cols, CV_32FC4), result;
+		cv::cvtColor(lab, source_fl4, cv::COLOR_BGR2BGRA);
+		clPrintErrorExit(queue.enqueueWriteBuffer(source_dev, CL_FALSE, 0, sizeof(cl_float3) * lab.rows * lab.cols, source_fl4.data),
+			"clEnqueueWriteBuffer: batch source");
+		filter.enqueue(source_dev, dest_dev, cols, rows, param_space, param_range);
+		clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, sizeof(cl_float3) * rows * cols, result_fl4.data),
+			"clEnqueueReadBuffer: batch dest");
+
+		cv::cvtColor(result_fl4, result, cv::COLOR_BGRA2BGR);
+		return result;
+	});
+	pipeline.printStats();
+}
+
+/**
+ * Surový vstup i výstup (.rawf) jádrem basic - data jdou z mapovaného souboru přímo na zařízení
+ * (layout LAYOUT_ALIGNED4) a výsledek se čte přímo do mapování výstupu. Výstup má velikost vstupu.
+ */
+void runRaw(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, const std::string &inputFileName,
+	int param_space, float param_range, bool generic_kernel, int block_x, int block_y, std::string outputFileName)
+{
+	RawImage input;
+	if (!input.open(inputFileName))
+	{
+		std::cerr << "Input image could not be loaded." << std::endl;
+		exit(1);
+	}
 
-		return
-			(1.0 - y_alpha) * (1.0 - x_alpha) * (1.0 - z_alpha) * mat.at<T>(y_index, x_index, z_index) +
-			(1.0 - y_alpha) * x_alpha       * (1.0 - z_alpha) * mat.at<T>(y_index, xx_index, z_index) +
-			y_alpha       * (1.0 - x_alpha) * (1.0 - z_alpha) * mat.at<T>(yy_index, x_index, z_index) +
-			y_alpha       * x_alpha       * (1.0 - z_alpha) * mat.at<T>(yy_index, xx_index, z_index) +
-			(1.0 - y_alpha) * (1.0 - x_alpha) * z_alpha       * mat.at<T>(y_index, x_index, zz_index) +
-			(1.0 - y_alpha) * x_alpha       * z_alpha       * mat.at<T>(y_index, xx_index, zz_index) +
-			y_alpha       * (1.0 - x_alpha) * z_alpha       * mat.at<T>(yy_index, x_index, zz_index) +
-			y_alpha       * x_alpha       * z_alpha       * mat.at<T>(yy_index, xx_index, zz_index);
+	const RawImage::Header &header = input.getHeader();
+	// rozměry omezuje open(), velikosti v size_t
+	const int rows = (int)header.height;
+	const int cols = (int)header.width;
+	const size_t image_size = sizeof(cl_float3) * (size_t)rows * (size_t)cols;
+	const size_t padded_size = sizeof(cl_float3) * ((size_t)rows + 2 * (size_t)param_space) * ((size_t)cols + 2 * (size_t)param_space);
+
+	// layout pro zařízení jde z mapování bez kopie na hostiteli, ostatní se jednou převedou
+	const bool direct = header.dtype == RawImage::DTYPE_FLOAT32 && header.layout == RawImage::LAYOUT_ALIGNED4 && header.channels == 3;
+	cv::Mat staged;
+	if (!direct)
+	{
+		cv::cvtColor(input.toLab(), staged, cv::COLOR_BGR2BGRA);
+	}
 
+	BilateralFilterCL filter(context, device, queue, !generic_kernel);
+	if (block_x > 0)
+	{
+		filter.setBlock(block_x, block_y);
 	}
 
+	cl_int err_msg;
+	cl::Buffer image_dev(context, CL_MEM_READ_WRITE, image_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: raw image");
+	cl::Buffer padded_dev(context, CL_MEM_READ_WRITE, padded_size, NULL, &err_msg);
+	clPrintErrorExit(err_msg, "clCreateBuffer: raw padded");
 
-	/**
-	* Implementation
-	*/
-	void bilateralFilter(cv::Mat1f src, cv::Mat1f dst,
-		double sigma_color, double sigma_space)
+	RawImage output;
+	if (!output.create(outputFileName, cols, rows, 3))
 	{
-		const size_t height = src.rows, width = src.cols;
-		const size_t padding_xy = 2, padding_z = 2;
-		double src_min, src_max;
-		cv::minMaxLoc(src, &src_min, &src_max);
-
-		const size_t small_height = static_cast<size_t>((height - 1) / sigma_space) + 1 + 2 * padding_xy;
-		const size_t small_width = static_cast<size_t>((width - 1) / sigma_space) + 1 + 2 * padding_xy;
-		const size_t small_depth = static_cast<size_t>((src_max - src_min) / sigma_color) + 1 + 2 * padding_xy;
-
-		int data_size[] = { small_height, small_width, small_depth };
-		cv::Mat data(3, data_size, CV_32FC2);
-		data.setTo(0);
-
-		// down sample
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				const size_t small_x = static_cast<size_t>(x / sigma_space + 0.5) + padding_xy;
-				const size_t small_y = static_cast<size_t>(y / sigma_space + 0.5) + padding_xy;
-				const float z = src.at<float>(y, x) - src_min;
-				const size_t small_z = static_cast<size_t>(z / sigma_color + 0.5) + padding_z;
-
-				cv::Vec2f v = data.at<cv::Vec2f>(small_y, small_x, small_z);
-				v[0] += src.at<float>(y, x);
-				v[1] += 1.0;
-				data.at<cv::Vec2f>(small_y, small_x, small_z) = v;
-			}
+		std::cerr << "Output image could not be created." << std::endl;
+		exit(1);
+	}
+
+	double begin = getTime();
+
+	cl::Event write_event, read_event;
+	clPrintErrorExit(queue.enqueueWriteBuffer(image_dev, CL_FALSE, 0, image_size, direct ? input.getData() : staged.data, NULL, &write_event),
+		"clEnqueueWriteBuffer: raw image");
+	Trace::addEvent("write raw image", write_event);
+
+	filter.enqueueIterations(image_dev, padded_dev, cols, rows, param_space, param_range, 1);
+
+	clPrintErrorExit(queue.enqueueReadBuffer(image_dev, CL_TRUE, 0, image_size, output.getData(), NULL, &read_event),
+		"clEnqueueReadBuffer: raw image");
+	Trace::addEvent("read raw image", read_event);
+
+	printf("\nRaw: %dx%d %s, %.3fms from mapped input to mapped output\n",
+		cols, rows, direct ? "direct upload" : "converted on host", (getTime() - begin) * 1000);
+}
+
+/**
+ * Klient démona (--client) - pošle vstup démonovi přes sdílenou paměť a uloží výsledek
+ * (velikost vstupu). S shutdown nakonec démona ukončí, vstup - znamená jen ukončení.
+ */
+void runClient(const std::string &socket_path, MyMat &img_source, bool grid_engine, int param_space, float param_range,
+	int repeat, bool shutdown, std::string outputFileName)
+{
+	if (!shutdown || !img_source.getMat().empty())
+	{
+		cv::Mat result = FilterDaemon::request(socket_path, img_source.getMat(),
+			grid_engine ? FilterDaemon::ENGINE_GRID : FilterDaemon::ENGINE_BASIC, param_space, param_range, repeat);
+		if (result.empty())
+		{
+			exit(1);
 		}
 
-		// convolution
-		cv::Mat buffer(3, data_size, CV_32FC2);
-		buffer.setTo(0);
-		int offset[3];
-		offset[0] = &(data.at<cv::Vec2f>(1, 0, 0)) - &(data.at<cv::Vec2f>(0, 0, 0));
-		offset[1] = &(data.at<cv::Vec2f>(0, 1, 0)) - &(data.at<cv::Vec2f>(0, 0, 0));
-		offset[2] = &(data.at<cv::Vec2f>(0, 0, 1)) - &(data.at<cv::Vec2f>(0, 0, 0));
+		MyMat img_dest(result.rows, result.cols);
+		result.copyTo(img_dest.getMat());
+		img_dest.saveImageToFile(outputFileName);
+	}
+
+	if (shutdown)
+	{
+		FilterDaemon::shutdown(socket_path);
+	}
+}
+
+/**
+ * Název výstupu jednoho parametru sweepu - do názvu se vloží hodnota parametru.
+ */
+std::string sweepFileName(const std::string &outputFileName, float value)
+{
+	std::string prefix = outputFileName.substr(0, outputFileName.length() - 4);
+
+	std::stringstream ss;
+	ss << prefix << "_r" << value << ".png";
+	return ss.str();
+}
 
-		for (int dim = 0; dim < 3; ++dim) { // dim = 3 stands for x, y, and depth
-			const int off = offset[dim];
-			for (int ittr = 0; ittr < 2; ++ittr) {
-				cv::swap(data, buffer);
+/**
+ * Sweep parametru barev - jádro basic (range_param) nebo grid (sigma_color) pro všechny hodnoty
+ * jedním průchodem, porovnání s jednotlivými voláními. Každý výstup se uloží zvlášť.
+ */
+void runSweep(cl::Context &context, cl::Device &device, cl::CommandQueue &queue, MyMat &img_source,
+	bool grid_engine, int param_space, const std::vector<float> &values, bool generic_kernel, std::string outputFileName)
+{
+	cl_int err_msg;
+	const int count = (int)values.size();
+	double sweep_time = 0.0, single_time = 0.0, difference = 0.0;
+	std::vector<cv::Mat> results;
 
-				for (int y = 1; y < small_height - 1; ++y) {
-					for (int x = 1; x < small_width - 1; ++x) {
-						cv::Vec2f *d_ptr = &(data.at<cv::Vec2f>(y, x, 1));
-						cv::Vec2f *b_ptr = &(buffer.at<cv::Vec2f>(y, x, 1));
-						for (int z = 1; z < small_depth - 1; ++z, ++d_ptr, ++b_ptr) {
-							cv::Vec2f b_prev = *(b_ptr - off), b_curr = *b_ptr, b_next = *(b_ptr + off);
-							*d_ptr = (b_prev + b_next + 2.0 * b_curr) / 4.0;
-						} // z
-					} // x
-				} // y
+	if (grid_engine)
+	{
+		cv::Mat im_gs_float = grayScale(img_source);
+		const int rows = im_gs_float.rows, cols = im_gs_float.cols;
+		const size_t plane_size = sizeof(float) * rows * cols;
 
-			} // ittr
-		} // dim
+		double src_min, src_max;
+		cv::minMaxLoc(im_gs_float, &src_min, &src_max);
 
-		  // upsample
+		BilateralGridCL grid(context, device, queue);
 
-		for (cv::MatIterator_<cv::Vec2f> d = data.begin<cv::Vec2f>(); d != data.end<cv::Vec2f>(); ++d)
+		cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, plane_size, im_gs_float.ptr<float>(), &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: sweep source");
+		std::vector<cl::Buffer> dest_dev;
+		for (int i = 0; i < count; i++)
 		{
-			(*d)[0] /= (*d)[1] != 0 ? (*d)[1] : 1;
+			dest_dev.push_back(cl::Buffer(context, CL_MEM_WRITE_ONLY, plane_size, NULL, &err_msg));
+			clPrintErrorExit(err_msg, "clCreateBuffer: sweep dest");
 		}
 
-		for (int y = 0; y < height; ++y) {
-			for (int x = 0; x < width; ++x) {
-				const float z = src.at<float>(y, x) - src_min;
-				const float px = static_cast<float>(x) / sigma_space + padding_xy;
-				const float py = static_cast<float>(y) / sigma_space + padding_xy;
-				const float pz = static_cast<float>(z) / sigma_color + padding_z;
-				dst.at<float>(y, x) = trilinear_interpolation<cv::Vec2f>(data, py, px, pz)[0];
-			}
+		grid.enqueueSweep(source_dev, dest_dev, cols, rows, (float)src_min, (float)src_max, (float)param_space, values);
+		queue.finish();
+		sweep_time = grid.getKernelTime();
+
+		for (int i = 0; i < count; i++)
+		{
+			results.push_back(cv::Mat(rows, cols, CV_32FC1));
+			clPrintErrorExit(queue.enqueueReadBuffer(dest_dev[i], CL_TRUE, 0, plane_size, results[i].ptr<float>()), "clEnqueueReadBuffer: sweep");
+		}
+
+		// jednotlivá volání se stejným vzorkováním barev jako sweep
+		const float sampling_color = *std::min_element(values.begin(), values.end());
+		cv::Mat single(rows, cols, CV_32FC1);
+		for (int i = 0; i < count; i++)
+		{
+			grid.enqueue(source_dev, dest_dev[0], cols, rows, (float)src_min, (float)src_max, (float)param_space, values[i], 0.0f, sampling_color);
+			clPrintErrorExit(queue.enqueueReadBuffer(dest_dev[0], CL_TRUE, 0, plane_size, single.ptr<float>()), "clEnqueueReadBuffer: sweep single");
+			single_time += grid.getKernelTime();
+			difference = std::max(difference, cv::norm(single, results[i], cv::NORM_INF));
+		}
+	}
+	else
+	{
+		const int rows = img_source.getMat().rows - param_space * 2;
+		const int cols = img_source.getMat().cols - param_space * 2;
+		const size_t plane_size = sizeof(cl_float3) * rows * cols;
+
+		BilateralFilterCL filter(context, device, queue, !generic_kernel);
+		filter.setBlock(1, 1);
+
+		cl::Buffer source_dev(context, CL_MEM_READ_ONLY | CL_MEM_COPY_HOST_PTR, (size_t)img_source.getDataSize(), img_source.getData(), &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: sweep source");
+		cl::Buffer dest_dev(context, CL_MEM_READ_WRITE, plane_size * count, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: sweep dest");
+		cl::Buffer single_dev(context, CL_MEM_READ_WRITE, plane_size, NULL, &err_msg);
+		clPrintErrorExit(err_msg, "clCreateBuffer: sweep single");
+
+		// první spuštění sestaví programy
+		filter.enqueueSweep(source_dev, dest_dev, cols, rows, param_space, values);
+		filter.enqueue(source_dev, single_dev, cols, rows, param_space, values[0]);
+		queue.finish();
+
+		double begin = getTime();
+		filter.enqueueSweep(source_dev, dest_dev, cols, rows, param_space, values);
+		queue.finish();
+		sweep_time = getTime() - begin;
+
+		cv::Mat all(rows * count, cols, CV_32FC4), single(rows, cols, CV_32FC4);
+		clPrintErrorExit(queue.enqueueReadBuffer(dest_dev, CL_TRUE, 0, plane_size * count, all.ptr<float>()), "clEnqueueReadBuffer: sweep");
+
+		for (int i = 0; i < count; i++)
+		{
+			cv::Mat result;
+			cv::cvtColor(all.rowRange(i * rows, (i + 1) * rows), result, cv::COLOR_BGRA2BGR);
+			results.push_back(result);
+
+			begin = getTime();
+			filter.enqueue(source_dev, single_dev, cols, rows, param_space, values[i]);
+			queue.finish();
+			single_time += getTime() - begin;
+
+			clPrintErrorExit(queue.enqueueReadBuffer(single_dev, CL_TRUE, 0, plane_size, single.ptr<float>()), "clEnqueueReadBuffer: sweep single");
+			cv::Mat single3;
+			cv::cvtColor(single, single3, cv::COLOR_BGRA2BGR);
+			difference = std::max(difference, cv::norm(single3, result, cv::NORM_INF));
 		}
 	}
-} // end of namespace cv_extend
 
+	printf("\nSweep: %d values, sweep %.3fms, separate runs %.3fms (%.2fx), max difference %f\n",
+		count, sweep_time * 1000, single_time * 1000, single_time / sweep_time, difference);
 
-void printHelp(void)
-{
-	std::cerr << "Špatné parametry spuštìní programu. Oèekávám" << std::endl <<
-		"program.exe vstupniObraz radius barvy vystupniObraz" << std::endl <<
-		"   vstupniObraz  Cesta ke vstupnímu obrázku." << std::endl <<
-		"   radius        Parametr filtru - prostorový (radius)." << std::endl <<
-		"   vstupniObraz  Parametr filtru - podobnost barev." << std::endl <<
-		"   vystupniObraz Cesta k vstupnímu obrázku." << std::endl;
+	for (int i = 0; i < count; i++)
+	{
+		if (grid_engine)
+		{
+			cv::imwrite(sweepFileName(outputFileName, values[i]), results[i]);
+		}
+		else
+		{
+			MyMat img_dest(results[i].rows, results[i].cols);
+			results[i].copyTo(img_dest.getMat());
+			img_dest.saveImageToFile(sweepFileName(outputFileName, values[i]));
+		}
+	}
 }
 
 int main(int argc, char* argv[])
 {
 	bool benchmark = false;
+	std::string engine = "basic";
+	bool generic_kernel = false;
+	bool host_compare = false;
+	bool roofline_report = false;
+	bool multi_device = false;
+	int repeat = 1;
+	bool splat_benchmark = false;
+	int block_x = 0, block_y = 0; // 0 = podle zařízení
+	std::string tap_mode;
+	bool lightness_only = false;
+	int upsample_factor = 0;
+	double latency_target = 0.0; // 0 = bez postupného výpočtu
+	float sampling_space = 0.0f, sampling_color = 0.0f; // 0 = sigma
+	bool video_mode = false;
+	int raw_width = 0, raw_height = 0;
+	float static_threshold = -1.0f; // < 0 = bez časového režimu
+	int strokes = -1; // < 0 = bez přírůstkového přepočtu
+	std::vector<float> sweep_values;
+	int iterations = 0; // 0 = jedno filtrování s výstupem menším o 2x radius
+	std::string graph_operations;
+	int thumbnails = 0; // 0 = bez dávky náhledů
+	int io_threads = 0; // 0 = bez dávky souborů
+	std::string daemon_socket, client_socket;
+	bool daemon_shutdown = false;
+	bool device_chain = false;
 
 	/*
 	 * Naètení parametrù programu.
 	 */
-	if (argc != 5)
+	if (argc < 5)
+	{
+		printHelp();
+		exit(1);
+	}
+
+	for (int i = 5; i < argc; i++)
 	{
+		std::string option(argv[i]);
+
 		// Benchmark
 		// - Do názvu souboru se vloží doba zpracování.
 		// - Použije se výkonná GK.
-		if (argc == 6 && std::string(argv[5]) == "-b")
+		if (option == "-b")
 		{
 			benchmark = true;
 		}
+		else if (option == "-g")
+		{
+			generic_kernel = true;
+		}
+		else if (option == "-c")
+		{
+			host_compare = true;
+		}
+		else if (option == "-t" && i + 1 < argc)
+		{
+			Trace::enable(argv[++i]);
+		}
+		else if (option == "-r")
+		{
+			roofline_report = true;
+		}
+		else if (option == "-m")
+		{
+			multi_device = true;
+		}
+		else if (option == "-k" && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%dx%d", &block_x, &block_y) != 2 || block_x < 1 || block_y < 1)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-w" && i + 1 < argc)
+		{
+			// středový bod má váhu 1 - s mezí mimo (0, 1] by seznam vah byl prázdný
+			tap_mode = argv[++i];
+			char *end;
+			double epsilon = strtod(tap_mode.c_str(), &end);
+			if (tap_mode != "circle" && (end == tap_mode.c_str() || *end != '\0' || !(epsilon > 0.0 && epsilon <= 1.0)))
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-u" && i + 1 < argc)
+		{
+			upsample_factor = atoi(argv[++i]);
+			if (upsample_factor < 2)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-p" && i + 1 < argc)
+		{
+			latency_target = atof(argv[++i]) / 1000.0;
+			if (latency_target <= 0.0)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-d" && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%fx%f", &sampling_space, &sampling_color) != 2 || sampling_space <= 0.0f || sampling_color <= 0.0f)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-v")
+		{
+			video_mode = true;
+		}
+		else if (option == "-f" && i + 1 < argc)
+		{
+			if (sscanf(argv[++i], "%dx%d", &raw_width, &raw_height) != 2 || raw_width < 1 || raw_height < 1)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-o" && i + 1 < argc)
+		{
+			static_threshold = (float)atof(argv[++i]);
+			if (static_threshold < 0.0f)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-i" && i + 1 < argc)
+		{
+			strokes = atoi(argv[++i]);
+			if (strokes < 0)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-x" && i + 1 < argc)
+		{
+			std::stringstream values(argv[++i]);
+			std::string value;
+			while (std::getline(values, value, ','))
+			{
+				sweep_values.push_back((float)atof(value.c_str()));
+				if (sweep_values.back() <= 0.0f)
+				{
+					printHelp();
+					exit(1);
+				}
+			}
+		}
+		else if (option == "--iterations" && i + 1 < argc)
+		{
+			iterations = atoi(argv[++i]);
+			if (iterations < 1)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-a" && i + 1 < argc)
+		{
+			graph_operations = argv[++i];
+		}
+		else if (option == "-j" && i + 1 < argc)
+		{
+			thumbnails = atoi(argv[++i]);
+			if (thumbnails < 1)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "-q" && i + 1 < argc)
+		{
+			io_threads = atoi(argv[++i]);
+			if (io_threads < 1)
+			{
+				printHelp();
+				exit(1);
+			}
+		}
+		else if (option == "--daemon" && i + 1 < argc)
+		{
+			daemon_socket = argv[++i];
+		}
+		else if (option == "--client" && i + 1 < argc)
+		{
+			client_socket = argv[++i];
+		}
+		else if (option == "--shutdown")
+		{
+			daemon_shutdown = true;
+		}
+		else if (option == "--chain")
+		{
+			device_chain = true;
+		}
+		else if (option == "-l")
+		{
+			lightness_only = true;
+		}
+		else if (option == "-s")
+		{
+			splat_benchmark = true;
+		}
+		else if (option == "-n" && i + 1 < argc)
+		{
+			repeat = atoi(argv[++i]);
+		}
+		else if (option == "-e" && i + 1 < argc)
+		{
+			engine = argv[++i];
+		}
 		else
 		{
 			printHelp();
@@ -202,18 +1691,55 @@ int main(int argc, char* argv[])
 	const int param_space = atoi(argv[2]);
 	const float param_range = (float)atof(argv[3]);
 
-	if (inputFileName == "" || outputFileName == "" || param_space < 0 || param_range < 0)
+	// režimy se navzájem vylučují - nejvýše jeden, nový režim se přidá sem a do kontroly svých parametrů
+	const bool exclusive_modes[] = { multi_device, upsample_factor > 1, latency_target > 0.0, video_mode, strokes >= 0,
+		!sweep_values.empty(), iterations > 0, !graph_operations.empty(), thumbnails > 0, io_threads > 0,
+		!daemon_socket.empty(), !client_socket.empty(), device_chain };
+	const int active_modes = (int)std::count(std::begin(exclusive_modes), std::end(exclusive_modes), true);
+
+	if (inputFileName == "" || outputFileName == "" || param_space < 0 || param_range < 0 || repeat < 1 || active_modes > 1 ||
+		(engine != "basic" && engine != "guided" && engine != "grid") ||
+		(engine == "grid" && (param_space == 0 || param_range == 0)) ||
+		// jen kanál L - samostatně, nebo s operacemi grafu jádrem basic
+		(lightness_only && (engine == "guided" || (active_modes > 0 && (graph_operations.empty() || engine != "basic")))) ||
+		(sampling_space > 0.0f && (engine != "grid" || active_modes > 0)) ||
+		(static_threshold >= 0.0f && (!video_mode || engine != "grid")) ||
+		(daemon_shutdown && client_socket.empty()) ||
+		// jádro a parametry jednotlivých režimů
+		(multi_device && engine != "basic") ||
+		(upsample_factor > 1 && engine != "basic") ||
+		(latency_target > 0.0 && (engine != "basic" || param_space == 0 || param_range == 0)) ||
+		(video_mode && (engine == "guided" || (inputFileName == "-" && raw_width == 0))) ||
+		(strokes >= 0 && engine == "guided") ||
+		(!sweep_values.empty() && (engine == "guided" || param_space == 0)) ||
+		(iterations > 0 && (engine != "basic" || param_space == 0)) ||
+		(!graph_operations.empty() && (engine == "guided" || param_space == 0 || param_range == 0)) ||
+		(thumbnails > 0 && (engine != "basic" || param_space == 0)) ||
+		(io_threads > 0 && (engine != "basic" || param_space == 0)) ||
+		((!daemon_socket.empty() || !client_socket.empty()) && engine == "guided") ||
+		(device_chain && (engine != "basic" || param_space == 0 || param_range == 0)))
 	{
 		printHelp();
 		exit(1);
 	}
 
+	// surový vstup i výstup bez dalšího režimu - přímo z mapování na zařízení
+	const bool raw_io = RawImage::isRawFile(inputFileName) && RawImage::isRawFile(outputFileName) && engine == "basic" &&
+		param_space > 0 && !lightness_only && active_modes == 0;
+
+	// surové snímky na stdout - výpisy půjdou na stderr
+	if (video_mode && outputFileName == "-")
+	{
+		VideoFilter::reserveStdout();
+	}
+
 	std::cout <<
 		"===============================" << std::endl <<
 		"=== GMU - bilaterální filtr ===" << std::endl <<
 		"===============================" << std::endl <<
 		"Prostorový parametr (radius): " << param_space << std::endl <<
-		"Barevný parametr (podobnost barev): " << param_range << std::endl;
+		"Barevný parametr (podobnost barev): " << param_range << std::endl <<
+		"Jádro: " << engine << std::endl;
 
 
 	/*
@@ -221,7 +1747,11 @@ int main(int argc, char* argv[])
 	 */
 	MyMat img_source;
 	try {
-		img_source.loadImageFromFile(inputFileName);
+		// video se čte až ve VideoFilter, dávka souborů v BatchPipeline, démon dostává obrázky od klienta
+		if (!video_mode && io_threads == 0 && !raw_io && daemon_socket.empty() && !(daemon_shutdown && inputFileName == "-"))
+		{
+			img_source.loadImageFromFile(inputFileName);
+		}
 	}
 	catch (...)
 	{
@@ -235,8 +1765,9 @@ int main(int argc, char* argv[])
 	/*
 	 * Pøíprava výstupního obrázku.
 	 */
-	int dest_rows = img_source.getMat().rows - param_space * 2;
-	int dest_cols = img_source.getMat().cols - param_space * 2;
+	const bool no_dest = video_mode || io_threads > 0 || raw_io || !daemon_socket.empty() || !client_socket.empty();
+	int dest_rows = no_dest ? 0 : img_source.getMat().rows - param_space * 2;
+	int dest_cols = no_dest ? 0 : img_source.getMat().cols - param_space * 2;
 
 	MyMat img_dest1(dest_rows, dest_cols);
 	cl_float3 * img_dest1_fl3 = img_dest1.getData();
@@ -244,13 +1775,22 @@ int main(int argc, char* argv[])
 	MyMat img_dest_opt(dest_rows, dest_cols);
 	cl_float3 * img_dest_opt_fl3 = img_dest_opt.getData();
 
+	// klient démona OpenCL nepotřebuje
+	if (!client_socket.empty())
+	{
+		runClient(client_socket, img_source, engine == "grid", param_space, param_range, repeat, daemon_shutdown, outputFileName);
+		exit(0);
+	}
+
 	/*
 	 * Výbìr výpoèetní platformy.
 	 */
 	std::vector<cl::Platform> platforms;
 	std::vector<cl::Device> platform_devices;
 
-	cl_int err_msg, err_msg2;
+	cl_int err_msg;
+
+	double platform_begin = getTime();
 
 	// Get Platforms count
 	clPrintErrorExit(cl::Platform::get(&platforms), "cl::Platform::get");
@@ -275,6 +1815,19 @@ int main(int argc, char* argv[])
 		platform_devices.clear();
 	}
 
+	if (multi_device)
+	{
+		Trace::addSpan("platform enumeration", "host", platform_begin, getTime());
+		runMultiDevice(img_source, img_source_fl3, param_space, param_range, repeat, generic_kernel, outputFileName, benchmark);
+		Trace::write();
+
+		if (!benchmark)
+		{
+			getchar();
+		}
+		exit(0);
+	}
+
 	cl::Device selected_device;
 	bool device_found = false;
 	for (unsigned int i = 0; i < platforms.size(); i++)
@@ -314,7 +1867,9 @@ int main(int argc, char* argv[])
 	printf("Selected device name: %s.\n", selected_device.getInfo<CL_DEVICE_NAME>().c_str());
 
 	platforms.clear();
+	Trace::addSpan("platform enumeration", "host", platform_begin, getTime());
 
+	double context_begin = getTime();
 	cl::Context context(selected_device, NULL, NULL, NULL, &err_msg);
 	clPrintErrorExit(err_msg, "cl::Context");
 
@@ -324,30 +1879,87 @@ int main(int argc, char* argv[])
 	 */
 	cl::CommandQueue queue(context, selected_device, CL_QUEUE_PROFILING_ENABLE, &err_msg);
 	clPrintErrorExit(err_msg, "cl::CommandQueue");
+	Trace::addSpan("context creation", "host", context_begin, getTime());
 
-	char *program_source;
-	cl::Program::Sources sources;
-
-	program_source = readFile("bilateralFilter_test.cl");
-	sources.push_back(std::pair<const char *, size_t>(program_source, 0));
-
-	program_source = readFile("bilateralFilter_basic.cl");
-	sources.push_back(std::pair<const char *, size_t>(program_source, 0));
-
-	program_source = readFile("bilateralFilter_optimized1.cl");
-	sources.push_back(std::pair<const char *, size_t>(program_source, 0));
-
-	cl::Program program(context, sources, &err_msg);
-	clPrintErrorExit(err_msg, "clCreateProgramWithSource");
-
-	// build program
-	if ((err_msg = program.build(std::vector<cl::Device>(1, selected_device), "", NULL, NULL)) == CL_BUILD_PROGRAM_FAILURE)
+	if (engine == "guided" || engine == "grid" || lightness_only || upsample_factor > 1 || latency_target > 0.0 || video_mode || strokes >= 0 || !sweep_values.empty() || iterations > 0 || !graph_operations.empty() || thumbnails > 0 || io_threads > 0 || raw_io || !daemon_socket.empty() || device_chain)
 	{
-		printf("Build log:\n %s", program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(selected_device, &err_msg2).c_str());
-		clPrintErrorExit(err_msg2, "cl::Program::getBuildInfo<CL_PROGRAM_BUILD_LOG>");
+		if (!daemon_socket.empty())
+		{
+			FilterDaemon daemon(context, selected_device, queue);
+			daemon.run(daemon_socket);
+			daemon.printStats();
+		}
+		else if (io_threads > 0)
+		{
+			runFileBatch(context, selected_device, queue, inputFileName, param_space, param_range, io_threads, outputFileName);
+		}
+		else if (thumbnails > 0)
+		{
+			runBatch(context, selected_device, queue, img_source, param_space, param_range, thumbnails, outputFileName, benchmark);
+		}
+		else if (!graph_operations.empty())
+		{
+			runGraph(context, selected_device, queue, img_source, engine == "grid", lightness_only, param_space, param_range,
+				graph_operations, generic_kernel, block_x, block_y, outputFileName, benchmark);
+		}
+		else if (device_chain)
+		{
+			runChain(context, selected_device, queue, img_source, param_space, param_range, outputFileName);
+		}
+		else if (iterations > 0)
+		{
+			runIterations(context, selected_device, queue, img_source, param_space, param_range, iterations, generic_kernel,
+				block_x, block_y, outputFileName, benchmark);
+		}
+		else if (!sweep_values.empty())
+		{
+			runSweep(context, selected_device, queue, img_source, engine == "grid", param_space, sweep_values, generic_kernel, outputFileName);
+		}
+		else if (strokes >= 0)
+		{
+			runIncremental(context, selected_device, queue, img_source, engine == "grid", param_space, param_range, strokes, outputFileName, benchmark);
+		}
+		else if (video_mode)
+		{
+			VideoFilter video(context, selected_device, queue, engine == "grid", param_space, param_range, static_threshold);
+			video.run(inputFileName, outputFileName, raw_width, raw_height);
+			video.printStats();
+		}
+		else if (latency_target > 0.0)
+		{
+			runProgressive(context, selected_device, queue, img_source, param_space, param_range, latency_target, outputFileName, benchmark);
+		}
+		else if (upsample_factor > 1)
+		{
+			runUpsample(context, selected_device, queue, img_source, param_space, param_range, upsample_factor, generic_kernel, outputFileName, benchmark);
+		}
+		else if (raw_io)
+		{
+			runRaw(context, selected_device, queue, inputFileName, param_space, param_range, generic_kernel, block_x, block_y, outputFileName);
+		}
+		else if (engine == "basic")
+		{
+			runLightness(context, selected_device, queue, img_source, param_space, param_range, generic_kernel, host_compare, outputFileName, benchmark);
+		}
+		else if (engine == "guided")
+		{
+			runGuided(context, selected_device, queue, img_source, img_source_fl3, param_space, param_range, outputFileName, benchmark, roofline_report);
+		}
+		else
+		{
+			runGrid(context, selected_device, queue, img_source, param_space, param_range, sampling_space, sampling_color, outputFileName, benchmark, roofline_report, splat_benchmark, lightness_only);
+		}
+		Trace::write();
+
+		if (!benchmark)
+		{
+			getchar();
+		}
+		exit(0);
 	}
 
-	clPrintErrorExit(err_msg, "clBuildProgram");
+	const char *program_files[] = { "bilateralFilter_test.cl", "bilateralFilter_basic.cl", "bilateralFilter_optimized1.cl" };
+	cl::Program program = buildProgram(context, selected_device, std::vector<std::string>(program_files, program_files + 3));
 
 	// create kernel functors
 	auto bilateralFilter_test = cl::make_kernel<
@@ -360,15 +1972,17 @@ int main(int argc, char* argv[])
 	>(program, "bilateralFilter_test", &err_msg);
 	clPrintErrorExit(err_msg, "_test");
 
-	auto bilateralFilter_basic = cl::make_kernel<
-		cl::Buffer&, 
-		cl::Buffer&, 
-		const cl_int&, 
-		const cl_int&,
-		const cl_int&, 
-		const cl_float&
-	>(program, "bilateralFilter_basic", &err_msg);
-	clPrintErrorExit(err_msg, "_basic");
+	// bilateralFilter_basic - varianta pro radius (-D RADIUS) nebo s radiusem za běhu
+	BilateralFilterCL bilateralFilter_basic(context, selected_device, queue, !generic_kernel);
+	if (block_x > 0)
+	{
+		bilateralFilter_basic.setBlock(block_x, block_y);
+	}
+	printf("Basic kernel: %s (%s, block %dx%d)\n",
+		bilateralFilter_basic.getKernelName(param_space).c_str(),
+		bilateralFilter_basic.isSpecialised(param_space) ? "RADIUS specialised" : "runtime radius",
+		bilateralFilter_basic.getBlockX(),
+		bilateralFilter_basic.getBlockY());
 
 	auto bilateralFilter_optimized = cl::make_kernel<
 		cl::Buffer&,
@@ -384,22 +1998,17 @@ int main(int argc, char* argv[])
 	>(program, "bilateralFilter_optimized", &err_msg);
 	clPrintErrorExit(err_msg, "_optimized");
 
-	cv::Mat im_processed(img_source.getMat().size(), CV_32FC1), im_lab_uint8, im_rgb_uint8, im_gs_uint8, im_gs_float;
-	
-	// lab float->lab uint8
-	img_source.getMat().convertTo(im_lab_uint8, CV_8UC3, 255.0);
-
-	// lab uint8 -> rgb uint8
-	cv::cvtColor(im_lab_uint8, im_rgb_uint8, 57 /*cl::COLOR_Lab2RGB*/);
-
-	// rgb uint8 -> gs uint8
-	cv::cvtColor(im_rgb_uint8, im_gs_uint8, 7 /*cl::COLOR_RGB2GRAY*/);
-
-	// gs uint8 -> gs float
-	im_gs_uint8.convertTo(im_gs_float, CV_32FC1);
+	cv::Mat im_processed(img_source.getMat().size(), CV_32FC1);
+	cv::Mat im_gs_float = grayScale(img_source);
 
-	cv_extend::bilateralFilter(im_gs_float, im_processed, param_range, param_space);
-	cv::imwrite("origin_gray_scale_filtered_optimized.png", im_processed);
+	{
+		TRACE_SCOPE("cv_extend::bilateralFilter");
+		cv_extend::bilateralFilter(im_gs_float, im_processed, param_range, param_space);
+	}
+	{
+		TRACE_SCOPE("imwrite");
+		cv::imwrite("origin_gray_scale_filtered_optimized.png", im_processed);
+	}
 
 	/*
 	 * Spuštìní kernelu.
@@ -421,12 +2030,6 @@ int main(int argc, char* argv[])
 	cl::UserEvent img_dest_opt_event(context, &err_msg);
 	clPrintErrorExit(err_msg, "clCreateUserEvent img_dest_opt");
 
-	cl::NDRange local(16, 16);
-	cl::NDRange global(
-		alignTo(img_dest1.getMat().cols, local[0]),
-		alignTo(img_dest1.getMat().rows, local[1])
-	);
-
 	clPrintErrorExit(queue.enqueueWriteBuffer(
 		img_source_dev,
 		CL_FALSE, 
@@ -436,9 +2039,9 @@ int main(int argc, char* argv[])
 		NULL, 
 		&img_source_event
 	), "clEnqueueWriteBuffer: img_source");
+	Trace::addEvent("write img_source", img_source_event);
 
-	cl::Event kernel_test_event = bilateralFilter_basic(
-		cl::EnqueueArgs(queue, global, local),
+	cl::Event kernel_test_event = bilateralFilter_basic.enqueue(
 		img_source_dev,
 		img_dest1_dev,
 		img_dest1.getMat().cols,
@@ -456,6 +2059,7 @@ int main(int argc, char* argv[])
 		NULL,
 		&img_dest1_event
 	), "clEnqueueReadBuffer: img_dest1");
+	Trace::addEvent("read img_dest1", img_dest1_event);
 
 	auto index_3d = [](int x, int y, int z, int width, int height) -> int
 	{
@@ -468,14 +2072,18 @@ int main(int argc, char* argv[])
 	};
 
 	float* inData = (float*)malloc(im_gs_float.cols * im_gs_float.rows * sizeof(float));
-	for (int i = 0; i < im_gs_float.cols; ++i)
 	{
-		for (int j = 0; j < im_gs_float.rows; ++j)
+		TRACE_SCOPE("inData transpose");
+		for (int i = 0; i < im_gs_float.cols; ++i)
 		{
-			inData[index_2d(j, i, im_gs_float.rows)] = im_gs_float.at<float>(j, i);
+			for (int j = 0; j < im_gs_float.rows; ++j)
+			{
+				inData[index_2d(j, i, im_gs_float.rows)] = im_gs_float.at<float>(j, i);
+			}
 		}
 	}
 
+	cl::Event img_src_opt_event;
 	clPrintErrorExit(queue.enqueueWriteBuffer(
 		img_src_opt_dev,
 		CL_FALSE,
@@ -483,8 +2091,9 @@ int main(int argc, char* argv[])
 		im_gs_float.cols * im_gs_float.rows * sizeof(float),
 		inData,
 		NULL,
-		&img_source_event
+		&img_src_opt_event
 	), "clEnqueueWriteBuffer: img_source");
+	Trace::addEvent("write img_src_opt", img_src_opt_event);
 
 	double src_min, src_max;
 	cv::minMaxLoc(im_gs_float, &src_min, &src_max);
@@ -505,21 +2114,28 @@ int main(int argc, char* argv[])
 	cl::Buffer data_2_buffer(context, CL_MEM_READ_WRITE, float_data_size, NULL, &err_msg);
 	clPrintErrorExit(err_msg, "clCreateBuffer: img_src_opt");
 
+	cl::Event data_1_event, data_2_event;
 	clPrintErrorExit(queue.enqueueWriteBuffer(
 		data_1_buffer,
 		CL_FALSE,
 		0,
 		float_data_size,
-		data_1
+		data_1,
+		NULL,
+		&data_1_event
 	), "clEnqueueWriteBuffer: data_1");
+	Trace::addEvent("write data_1", data_1_event);
 
 	clPrintErrorExit(queue.enqueueWriteBuffer(
 		data_2_buffer,
 		CL_FALSE,
 		0,
 		float_data_size,
-		data_2
+		data_2,
+		NULL,
+		&data_2_event
 	), "clEnqueueWriteBuffer: data_2");
+	Trace::addEvent("write data_2", data_2_event);
 
 
 	cl::Event kernel_optimized_event = bilateralFilter_optimized(
@@ -535,6 +2151,7 @@ int main(int argc, char* argv[])
 		param_space,
 		param_range
 	);
+	Trace::addEvent("bilateralFilter_optimized", kernel_optimized_event);
 
 	cv::Mat output = im_gs_float;
 	float* outData = (float*)malloc(output.cols * output.rows * sizeof(float));
@@ -547,7 +2164,9 @@ int main(int argc, char* argv[])
 		NULL,
 		&img_dest_opt_event
 	), "clEnqueueReadBuffer: img_dest_opt_dev");
+	Trace::addEvent("read img_dest_opt", img_dest_opt_event);
 
+	cl::Event data_2_read_event;
 	clPrintErrorExit(queue.enqueueReadBuffer(
 		data_2_buffer,
 		CL_FALSE,
@@ -555,26 +2174,46 @@ int main(int argc, char* argv[])
 		float_data_size,
 		data_2,
 		NULL,
-		&img_dest_opt_event
+		&data_2_read_event
 	), "clEnqueueReadBuffer: img_dest_opt_dev");
+	Trace::addEvent("read data_2", data_2_read_event);
 
-	queue.finish();
+	{
+		TRACE_SCOPE("queue.finish");
+		queue.finish();
+	}
 
 	float* out_data_it = outData;
-	for (int i = 0; i < output.cols; ++i)
 	{
-		for (int j = 0; j < output.rows; ++j)
+		TRACE_SCOPE("outData transpose");
+		for (int i = 0; i < output.cols; ++i)
 		{
-			output.at<float>(j, i) = *out_data_it;
-			out_data_it++;
+			for (int j = 0; j < output.rows; ++j)
+			{
+				output.at<float>(j, i) = *out_data_it;
+				out_data_it++;
+			}
 		}
 	}
 
- 	imwrite("opt.png", output);
+	{
+		TRACE_SCOPE("imwrite");
+		imwrite("opt.png", output);
+	}
 	free(outData);
 	/*
 	 * Statistika.
 	 */
+	if (roofline_report)
+	{
+		Roofline roofline;
+		roofline.add(bilateralFilter_basic.getKernelName(param_space), kernel_test_event,
+			Roofline::basicCost(dest_cols, dest_rows, param_space, bilateralFilter_basic.isSpecialised(param_space)));
+		roofline.add("bilateralFilter_optimized", kernel_optimized_event,
+			Roofline::gridCost(im_gs_float.cols, im_gs_float.rows, small_height, small_width, small_depth));
+		roofline.print(Roofline::measurePeak(context, selected_device, queue));
+	}
+
 	printf("Timers: ocl:%.3fms ocl_copy:%.3fms ocl_kernel:%.3fms\n",
 		(getEventTime(img_source_event) + getEventTime(img_dest1_event) + getEventTime(kernel_test_event)) * 1000,
 		(getEventTime(img_source_event) + getEventTime(img_dest1_event)) * 1000,
@@ -585,23 +2224,80 @@ int main(int argc, char* argv[])
 	*/
 	if (benchmark)
 	{
-		// Odhodíme pøíponu
-		std::string prefix = outputFileName.substr(0, outputFileName.length() - 4);
-		
-		unsigned int time = (unsigned int)(getEventTime(kernel_test_event) * 1000);
-		
-		std::stringstream ss;
-		ss << prefix << "_t" << time << ".png";
-		outputFileName = ss.str();
+		outputFileName = benchmarkFileName(outputFileName, getEventTime(kernel_test_event));
 	}
 
 	img_dest1.setData(img_dest1_fl3);
+
+	// Porovnání s hostitelskou implementací hrubou silou.
+	if (host_compare)
+	{
+		cv::Mat img_host;
+		double host_time = getTime();
+		bool specialised;
+		{
+			TRACE_SCOPE("cv_extend::bilateralFilterBruteForce");
+			specialised = cv_extend::bilateralFilterBruteForce(img_source.getMat(), img_host, param_space, param_range);
+		}
+		host_time = getTime() - host_time;
+
+		printf("Host: %.3fms (%s) max difference: %f\n",
+			host_time * 1000,
+			specialised ? "template<Radius, Channels>" : "runtime radius",
+			cv::norm(img_host, img_dest1.getMat(), cv::NORM_INF));
+	}
+
+	// Řídký seznam vah - počet vah a chyba proti plnému oknu.
+	if (tap_mode != "")
+	{
+		bool circular = (tap_mode == "circle");
+		int taps = bilateralFilter_basic.setTaps(param_space, circular ? 0.0f : (float)atof(tap_mode.c_str()), circular);
+
+		MyMat img_taps(dest_rows, dest_cols);
+		cl_float3 *img_taps_fl3 = img_taps.getData();
+
+		cl::Event taps_read_event;
+		cl::Event taps_event = bilateralFilter_basic.enqueueTaps(img_source_dev, img_dest1_dev, dest_cols, dest_rows, param_range);
+		clPrintErrorExit(queue.enqueueReadBuffer(
+			img_dest1_dev, CL_TRUE, 0, img_taps.getDataSize(), img_taps_fl3, NULL, &taps_read_event
+		), "clEnqueueReadBuffer: img_taps");
+		Trace::addEvent("read img_taps", taps_read_event);
+		img_taps.setData(img_taps_fl3);
+
+		// plné okno se stejným tvarem práce jako _taps (jeden výstup na položku, radius za běhu),
+		// výchozí kernel může být blokovaný nebo specializovaný
+		BilateralFilterCL full_window(context, selected_device, queue, false);
+		full_window.setBlock(1, 1);
+		full_window.enqueue(img_source_dev, img_dest1_dev, dest_cols, dest_rows, param_space, param_range);
+		queue.finish();
+		cl::Event full_event = full_window.enqueue(img_source_dev, img_dest1_dev, dest_cols, dest_rows, param_space, param_range);
+		queue.finish();
+
+		cv::Mat difference;
+		cv::absdiff(img_taps.getMat(), img_dest1.getMat(), difference);
+		cv::Scalar mean_difference = cv::mean(difference);
+
+		printf("Taps: %d/%d (%s), %.3fms (full window %.3fms), max difference: %f, mean difference: %f\n",
+			taps,
+			(2 * param_space + 1) * (2 * param_space + 1),
+			circular ? "circle" : tap_mode.c_str(),
+			getEventTime(taps_event) * 1000,
+			getEventTime(full_event) * 1000,
+			cv::norm(img_taps.getMat(), img_dest1.getMat(), cv::NORM_INF),
+			(mean_difference[0] + mean_difference[1] + mean_difference[2]) / 3);
+	}
+
 	img_dest1.saveImageToFile(outputFileName);
 
 	free(data_2);
 	free(data_1);
 	free(inData);
 
+	if (!Trace::write())
+	{
+		std::cerr << "Trace could not be written." << std::endl;
+	}
+
 	if (!benchmark)
 	{
 		getchar();
@@ -0,0 +1,53 @@
+/*
+ * GMU projekt - Bilaterální filtr
+ *
+ * Autoři: Tomáš Pelka (xpelka01), Karol Troška (xtrosk00).
+ */
+
+/**
+ * Mikrobenchmarky pro odhad špičkového výkonu zařízení (roofline).
+ */
+
+#ifndef FMA_ITERATIONS
+#define FMA_ITERATIONS 256
+#endif
+
+/**
+ * @brief Kopie float4 - propustnost paměti (STREAM copy).
+ */
+__kernel void microbenchmark_copy(
+	__global float4 *source,
+	__global float4 *destination)
+{
+	int i = get_global_id(0);
+	destination[i] = source[i];
+}
+
+/**
+ * @brief Řetězce mad nad float4 v registrech - výpočetní výkon.
+ *
+ * Osm nezávislých řetězců, každá iterace je 8 * 4 * 2 = 64 FLOP na pracovní položku.
+ */
+__kernel void microbenchmark_fma(
+	__global float4 *destination,
+	const float multiplier,
+	const float addend)
+{
+	float4 a0 = (float4)(get_global_id(0), 1.0f, 2.0f, 3.0f) * 1e-6f;
+	float4 a1 = a0 + 0.1f, a2 = a0 + 0.2f, a3 = a0 + 0.3f;
+	float4 a4 = a0 + 0.4f, a5 = a0 + 0.5f, a6 = a0 + 0.6f, a7 = a0 + 0.7f;
+
+	for (int i = 0; i < FMA_ITERATIONS; i++)
+	{
+		a0 = mad(a0, multiplier, addend);
+		a1 = mad(a1, multiplier, addend);
+		a2 = mad(a2, multiplier, addend);
+		a3 = mad(a3, multiplier, addend);
+		a4 = mad(a4, multiplier, addend);
+		a5 = mad(a5, multiplier, addend);
+		a6 = mad(a6, multiplier, addend);
+		a7 = mad(a7, multiplier, addend);
+	}
+
+	destination[get_global_id(0)] = a0 + a1 + a2 + a3 + a4 + a5 + a6 + a7;
+}
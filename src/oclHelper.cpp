@@ -1,4 +1,5 @@
 #include "oclHelper.h"
+#include "Trace.hpp"
 #pragma comment( lib, "OpenCL" )
 
 const char *getCLError(cl_int err_id) {
@@ -146,6 +147,48 @@ char* readFile(const char* filename)
     return file_content;
 }
 
+cl::Program buildProgram(cl::Context &context, cl::Device &device, const std::vector<std::string> &files, const std::string &options,
+	const std::string &header)
+{
+    cl_int err_msg, err_msg2;
+    cl::Program::Sources sources;
+
+    std::string trace_name = "program build";
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        trace_name += " " + files[i];
+    }
+    TRACE_SCOPE(trace_name + " " + options);
+
+    if (!header.empty())
+    {
+        sources.push_back(std::pair<const char *, size_t>(header.c_str(), header.length()));
+    }
+
+    for (size_t i = 0; i < files.size(); i++)
+    {
+        char *program_source = readFile(files[i].c_str());
+        if (program_source == NULL)
+        {
+            printf("ERROR: kernel file %s could not be read\n", files[i].c_str());
+            exit(1);
+        }
+        sources.push_back(std::pair<const char *, size_t>(program_source, 0));
+    }
+
+    cl::Program program(context, sources, &err_msg);
+    clPrintErrorExit(err_msg, "clCreateProgramWithSource");
+
+    if ((err_msg = program.build(std::vector<cl::Device>(1, device), options.c_str(), NULL, NULL)) == CL_BUILD_PROGRAM_FAILURE)
+    {
+        printf("Build log:\n %s", program.getBuildInfo<CL_PROGRAM_BUILD_LOG>(device, &err_msg2).c_str());
+        clPrintErrorExit(err_msg2, "cl::Program::getBuildInfo<CL_PROGRAM_BUILD_LOG>");
+    }
+    clPrintErrorExit(err_msg, "clBuildProgram");
+
+    return program;
+}
+
 unsigned int alignTo(unsigned int data, unsigned int align_size)
 {
 	return ((data - 1 + align_size) / align_size) * align_size;
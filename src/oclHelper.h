@@ -9,6 +9,9 @@
 
 #include <CL/cl.hpp>
 
+#include <string>
+#include <vector>
+
 // convert opencl error code to string
 const char *getCLError(cl_int err_id);
 
@@ -21,6 +24,11 @@ void clPrintErrorExit(cl_int err_id, const char *msg);
 // Read file to string
 char* readFile(const char* filename);
 
+// Read kernel files, build them for the device and exit on failure (build log is printed)
+// header is source placed before the files (generated code)
+cl::Program buildProgram(cl::Context &context, cl::Device &device, const std::vector<std::string> &files, const std::string &options = "",
+	const std::string &header = "");
+
 // align data_size size to align_size
 unsigned int alignTo(unsigned int data_size, unsigned int align_size);
 